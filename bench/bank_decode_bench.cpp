@@ -0,0 +1,219 @@
+// Bank decoding into float analysis arrays: the TMEvent path against
+// BankSchema.
+//
+// Each iteration decodes a digitizer bank out of a synthetic event that also
+// carries a few other banks ahead of it. Methods:
+//   tmevent          TMEvent copy + FindAllBanks + FindBank, then a hand-written
+//                    loop reinterpreting the bytes, as analyzers do it today
+//   view_loop        EventView::findBank(const char*) with the same loop,
+//                    to separate lookup cost from conversion cost
+//   schema_scalar    BankSchema lookup with the scalar kernel
+//   schema           BankSchema lookup with the dispatched (SIMD) kernel
+// for a uint16 bank converted in stored order, the same bank deinterleaved
+// into per-channel arrays, and a 12-bit packed bank.
+//
+// Every method's output is compared against the tmevent one; a mismatch is
+// reported and fails the run.
+//
+// Usage: bank_decode_bench [samples per channel] [iterations]
+#include "BankSchema.h"
+#include "EventView.h"
+
+#include "midasio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static constexpr size_t kChannels = 4;
+
+using Adc = BankSchema<bankName("ADC0"), uint16_t, kChannels>;
+using Raw = BankSchema<bankName("ADC0"), uint16_t>;
+using Packed = BankSchema<bankName("P120"), Packed12>;
+
+struct BankContent {
+    const char* name;
+    uint32_t type;
+    std::vector<char> bytes;
+};
+
+static std::vector<char> makeEvent(const std::vector<BankContent>& banks) {
+    size_t payload = 0;
+    for (const auto& bank : banks) {
+        payload += sizeof(BANK32) + ((bank.bytes.size() + 7) & ~size_t(7));
+    }
+    std::vector<char> event(sizeof(EVENT_HEADER) + sizeof(BANK_HEADER) + payload, 0);
+
+    auto* header = reinterpret_cast<EVENT_HEADER*>(event.data());
+    header->event_id = 1;
+    header->trigger_mask = 1;
+    header->data_size = static_cast<DWORD>(event.size() - sizeof(EVENT_HEADER));
+
+    auto* bankHeader = reinterpret_cast<BANK_HEADER*>(header + 1);
+    bankHeader->data_size = static_cast<DWORD>(payload);
+    bankHeader->flags = BANK_FORMAT_VERSION | BANK_FORMAT_32BIT;
+
+    char* p = reinterpret_cast<char*>(bankHeader + 1);
+    for (const auto& content : banks) {
+        auto* bank = reinterpret_cast<BANK32*>(p);
+        std::memcpy(bank->name, content.name, 4);
+        bank->type = content.type;
+        bank->data_size = static_cast<DWORD>(content.bytes.size());
+        std::memcpy(bank + 1, content.bytes.data(), content.bytes.size());
+        p += sizeof(BANK32) + ((content.bytes.size() + 7) & ~size_t(7));
+    }
+    return event;
+}
+
+static uint16_t adcValue(size_t sample, size_t channel) {
+    return static_cast<uint16_t>((sample * 7919 + channel * 104729) & 0x3fff);
+}
+
+// ns per decoded event
+static double timeIt(size_t iterations, const std::function<void()>& decode) {
+    for (size_t i = 0; i < iterations / 10 + 1; ++i) {
+        decode();
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        decode();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           static_cast<double>(iterations);
+}
+
+static bool failed = false;
+
+static void report(const std::string& test, const std::string& method, double ns, size_t samples,
+                   const std::vector<float>& out, const std::vector<float>& reference) {
+    bool same = out.size() == reference.size() &&
+                std::memcmp(out.data(), reference.data(), out.size() * sizeof(float)) == 0;
+    failed |= !same;
+    std::printf("%s,%s,%.0f,%.0f,%s\n", test.c_str(), method.c_str(), ns, samples / ns * 1e3,
+                same ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char** argv) {
+    const size_t samples = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t channels = kChannels;
+    const size_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+    const size_t total = samples * channels;
+
+    std::vector<BankContent> banks;
+    for (const char* name : {"HEAD", "TRIG", "SCAL"}) {
+        banks.push_back({name, TID_UINT32, std::vector<char>(64, 1)});
+    }
+    BankContent adc{"ADC0", TID_UINT16, std::vector<char>(total * sizeof(uint16_t))};
+    for (size_t s = 0; s < samples; ++s) {
+        for (size_t c = 0; c < channels; ++c) {
+            uint16_t value = adcValue(s, c);
+            std::memcpy(adc.bytes.data() + (s * channels + c) * sizeof(uint16_t), &value, sizeof(value));
+        }
+    }
+    banks.push_back(adc);
+    BankContent packed{"P120", TID_UINT8, std::vector<char>(total / 2 * 3)};
+    for (size_t i = 0; i + 1 < total; i += 2) {
+        uint32_t bits = (adcValue(i, 0) & 0xfff) | uint32_t(adcValue(i + 1, 1) & 0xfff) << 12;
+        std::memcpy(packed.bytes.data() + i / 2 * 3, &bits, 3);
+    }
+    banks.push_back(packed);
+    const std::vector<char> raw = makeEvent(banks);
+    const EventView view(raw.data(), raw.size());
+
+    std::printf("samples_per_channel=%zu channels=%zu event_bytes=%zu avx2=%d ssse3=%d\n", samples, channels,
+                raw.size(),
+#ifdef BANK_SCHEMA_X86
+                BankConvert::hasAvx2() ? 1 : 0, BankConvert::hasSsse3() ? 1 : 0
+#else
+                0, 0
+#endif
+    );
+    std::printf("test,method,ns_per_event,msamples_per_s,check\n");
+
+    std::vector<float> reference(total), out(total);
+
+    // ---- uint16, stored order ----
+    auto tmeventRaw = [&] {
+        TMEvent event(raw.data(), raw.size());
+        event.FindAllBanks();
+        const TMBank* bank = event.FindBank("ADC0");
+        const char* data = event.GetBankData(bank);
+        size_t count = bank->data_size / sizeof(uint16_t);
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t value;
+            std::memcpy(&value, data + i * sizeof(value), sizeof(value));
+            reference[i] = static_cast<float>(value);
+        }
+    };
+    report("uint16", "tmevent", timeIt(iterations, tmeventRaw), total, reference, reference);
+    report("uint16", "view_loop", timeIt(iterations, [&] {
+        BankSpan bank = view.findBank("ADC0");
+        size_t count = bank.size / sizeof(uint16_t);
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t value;
+            std::memcpy(&value, bank.data + i * sizeof(value), sizeof(value));
+            out[i] = static_cast<float>(value);
+        }
+    }), total, out, reference);
+    report("uint16", "schema_scalar", timeIt(iterations, [&] {
+        BankSpan bank = Raw::find(view);
+        BankConvert::scalar<uint16_t>(bank.data, Raw::elements(bank), out.data());
+    }), total, out, reference);
+    report("uint16", "schema", timeIt(iterations, [&] {
+        Raw::toFloat(Raw::find(view), out.data(), out.size());
+    }), total, out, reference);
+
+    // ---- uint16, deinterleaved into one array per channel ----
+    auto tmeventChannels = [&] {
+        TMEvent event(raw.data(), raw.size());
+        event.FindAllBanks();
+        const TMBank* bank = event.FindBank("ADC0");
+        const char* data = event.GetBankData(bank);
+        size_t perChannel = bank->data_size / sizeof(uint16_t) / channels;
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t s = 0; s < perChannel; ++s) {
+                uint16_t value;
+                std::memcpy(&value, data + (s * channels + c) * sizeof(value), sizeof(value));
+                reference[c * perChannel + s] = static_cast<float>(value);
+            }
+        }
+    };
+    report("uint16_channels", "tmevent", timeIt(iterations, tmeventChannels), total, reference, reference);
+    report("uint16_channels", "schema", timeIt(iterations, [&] {
+        Adc::deinterleave(Adc::find(view), out.data());
+    }), total, out, reference);
+
+    // ---- 12-bit packed ----
+    const size_t packedCount = total & ~size_t(1);
+    reference.resize(packedCount);
+    out.resize(packedCount);
+    auto tmeventPacked = [&] {
+        TMEvent event(raw.data(), raw.size());
+        event.FindAllBanks();
+        const TMBank* bank = event.FindBank("P120");
+        const auto* data = reinterpret_cast<const unsigned char*>(event.GetBankData(bank));
+        size_t count = bank->data_size / 3 * 2;
+        for (size_t i = 0; i < count; i += 2) {
+            uint32_t bits = data[i / 2 * 3] | uint32_t(data[i / 2 * 3 + 1]) << 8 | uint32_t(data[i / 2 * 3 + 2]) << 16;
+            reference[i] = static_cast<float>(bits & 0xfff);
+            reference[i + 1] = static_cast<float>(bits >> 12);
+        }
+    };
+    report("packed12", "tmevent", timeIt(iterations, tmeventPacked), packedCount, reference, reference);
+    report("packed12", "schema_scalar", timeIt(iterations, [&] {
+        BankSpan bank = Packed::find(view);
+        BankConvert::packed12Scalar(bank.data, Packed::elements(bank), out.data());
+    }), packedCount, out, reference);
+    report("packed12", "schema", timeIt(iterations, [&] {
+        Packed::toFloat(Packed::find(view), out.data(), out.size());
+    }), packedCount, out, reference);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// What the compressed cold tier buys and costs.
+//
+// Synthetic digitizer events (a slowly varying 16-bit waveform with a little
+// noise, which is what most detector payloads look like) are handed to a
+// ColdStore the way MidasReceiver evicts them. Reported:
+//   - compression throughput of the background thread, in MB/s of raw events
+//   - the retention multiplier: hot footprint per event over cold bytes per
+//     event, i.e. how much more history fits in the same memory
+//   - p50/p99 latency of reading one random event from the hot ring and from
+//     the cold tier (which inflates a whole block unless it is cached)
+//   - overload: the same events handed over as fast as the publisher can,
+//     which outpaces one compressor; the peak of uncompressed pending bytes
+//     must stay within maxPendingBytes, with the excess dropped and counted
+//
+// Usage: cold_tier_bench [events] [samples per event] [zlib level]
+#include "ColdStore.h"
+#include "EventPool.h"
+#include "ReceiverStats.h"
+#include "SequencedRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+static std::shared_ptr<TimedEvent> makeEvent(const std::shared_ptr<EventPool>& pool, uint64_t sequence,
+                                             size_t samples, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, 2.0);
+    auto event = std::allocate_shared<TimedEvent>(PoolAllocator<TimedEvent>(pool));
+    event->timestamp = std::chrono::system_clock::now();
+    event->sequence = sequence;
+    event->raw = pool->acquire(sizeof(EVENT_HEADER) + samples * sizeof(int16_t));
+
+    EVENT_HEADER header{};
+    header.event_id = 1;
+    header.serial_number = static_cast<DWORD>(sequence);
+    header.data_size = static_cast<DWORD>(samples * sizeof(int16_t));
+    std::memcpy(event->raw.data(), &header, sizeof(header));
+
+    auto* wave = reinterpret_cast<int16_t*>(static_cast<char*>(event->raw.data()) + sizeof(header));
+    double phase = static_cast<double>(sequence % 97);
+    for (size_t i = 0; i < samples; ++i) {
+        double pulse = 800.0 * std::exp(-std::pow((static_cast<double>(i) - 40.0 - phase) / 12.0, 2));
+        wave[i] = static_cast<int16_t>(1000.0 + pulse + noise(rng));
+    }
+    return event;
+}
+
+int main(int argc, char** argv) {
+    const size_t events = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    const size_t samples = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 512;
+    const int level = argc > 3 ? std::atoi(argv[3]) : 1;
+    const size_t reads = 20000;
+
+    auto pool = std::make_shared<EventPool>(10 * 1024 * 1024, 256 * 1024 * 1024);
+    std::mt19937 rng(42);
+
+    std::vector<std::shared_ptr<TimedEvent>> hot;
+    hot.reserve(events);
+    size_t hotFootprint = 0;
+    size_t rawBytes = 0;
+    for (uint64_t i = 0; i < events; ++i) {
+        hot.push_back(makeEvent(pool, i, samples, rng));
+        hotFootprint += hot.back()->footprint();
+        rawBytes += hot.back()->size();
+    }
+
+    ColdTierPolicy policy;
+    policy.after = std::chrono::milliseconds(1);
+    policy.maxBytes = SIZE_MAX;
+    policy.maxPendingBytes = SIZE_MAX; // This phase times the compressor, so nothing is dropped
+    policy.compressionLevel = level;
+    ColdStore cold(policy, std::chrono::milliseconds(0), pool, nullptr);
+
+    // The publisher outruns one compressor, so this times the compressor
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& event : hot) {
+        cold.add(event);
+    }
+    while (cold.usage().pendingEvents > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ColdStore::Usage usage = cold.usage();
+
+    // Hot reads come from a ring holding the same events
+    SequencedRing<std::shared_ptr<TimedEvent>> ring(events);
+    for (const auto& event : hot) {
+        ring.push(event);
+    }
+    hot.clear();
+
+    std::uniform_int_distribution<uint64_t> pick(0, events - 1);
+    LatencyHistogram hotReads, coldReads;
+    volatile size_t sink = 0;
+    for (size_t i = 0; i < reads; ++i) {
+        uint64_t sequence = pick(rng);
+        auto begin = std::chrono::steady_clock::now();
+        auto got = ring.copyRange(sequence, sequence + 1);
+        auto end = std::chrono::steady_clock::now();
+        sink = sink + got.size();
+        hotReads.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+
+        sequence = pick(rng);
+        begin = std::chrono::steady_clock::now();
+        auto fromCold = cold.read(sequence, sequence + 1, 1);
+        end = std::chrono::steady_clock::now();
+        sink = sink + fromCold.size();
+        coldReads.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    }
+
+    double hotPerEvent = static_cast<double>(hotFootprint) / events;
+    double coldPerEvent = static_cast<double>(usage.compressedBytes) / usage.events;
+    LatencySummary hotSummary = hotReads.summary();
+    LatencySummary coldSummary = coldReads.summary();
+
+    std::cout << "events " << events << ", " << sizeof(EVENT_HEADER) + samples * sizeof(int16_t)
+              << " bytes each, zlib level " << level << ", " << usage.blocks << " blocks\n";
+    std::cout << "compression_mb_per_s " << rawBytes / seconds / 1e6 << "\n";
+    std::cout << "compression_ratio " << static_cast<double>(usage.rawBytes) / usage.compressedBytes << "\n";
+    std::cout << "hot_bytes_per_event " << hotPerEvent << "\n";
+    std::cout << "cold_bytes_per_event " << coldPerEvent << "\n";
+    std::cout << "retention_multiplier " << hotPerEvent / coldPerEvent << "\n";
+    std::cout << "hot_read_p50_ns " << hotSummary.p50Ns << " p99_ns " << hotSummary.p99Ns << "\n";
+    std::cout << "cold_read_p50_ns " << coldSummary.p50Ns << " p99_ns " << coldSummary.p99Ns << "\n";
+
+    // Overload: input faster than compression, against a small pending cap
+    std::vector<std::shared_ptr<TimedEvent>> burst;
+    burst.reserve(events);
+    for (uint64_t i = 0; i < events; ++i) {
+        burst.push_back(makeEvent(pool, i, samples, rng));
+    }
+    ColdTierPolicy overloadPolicy = policy;
+    overloadPolicy.maxPendingBytes = 16 * 1024 * 1024;
+    ColdStore overloaded(overloadPolicy, std::chrono::milliseconds(0), pool, nullptr);
+    size_t peakPending = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < events; ++i) {
+        overloaded.add(std::move(burst[i]));
+        if (i % 64 == 0) {
+            peakPending = std::max(peakPending, overloaded.usage().pendingBytes);
+        }
+    }
+    double inputSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    burst.clear();
+    while (overloaded.usage().pendingEvents > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    ColdStore::Usage overload = overloaded.usage();
+    bool bounded = peakPending <= overloadPolicy.maxPendingBytes;
+    std::cout << "overload_input_mb_per_s " << rawBytes / inputSeconds / 1e6 << " peak_pending_mb "
+              << peakPending / 1e6 << " cap_mb " << overloadPolicy.maxPendingBytes / 1e6 << " compressed_events "
+              << overload.events << " dropped_events " << overload.droppedEvents << "\n";
+    std::cout << (bounded ? "PASS" : "FAIL") << ": pending bytes stay within maxPendingBytes under overload\n";
+    return bounded ? 0 : 1;
+}
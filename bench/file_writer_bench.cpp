@@ -0,0 +1,210 @@
+// What writing every event to MIDAS files costs the ingest thread.
+//
+// A PacedSource delivers synthetic digitizer events (a 16-bit waveform with a
+// little noise, so compression has something realistic to work on) at a fixed
+// rate, or as fast as the receiver takes them, for a given time. Each rate and
+// size is run with the file writer off and then writing .mid, .mid.gz and
+// .mid.lz4 files to a scratch directory. Reported per scenario:
+//   - events/s and MB/s actually delivered
+//   - sampled callback time p50/p99/p99.9 (getStats().callbackTime), which is
+//     what the writer must leave alone
+//   - the writer's per-buffer write time and event-to-file latency p50/p99
+//   - events written and dropped, buffer waits, and bytes on disk
+//
+// The suffix picks the midasio writer; where midasio is built without LZ4 the
+// .lz4 files come out uncompressed.
+//
+// Usage: file_writer_bench [directory] [duration-ms] [rates, e.g. 1000,10000,100000,0] [sizes, e.g. 1024,16384]
+// A rate of 0 means unpaced.
+#include "EventSource.h"
+#include "MidasReceiver.h"
+#include "ReceiverStats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+class PacedSource : public EventSource {
+public:
+    PacedSource(std::vector<char> event, uint64_t rate, std::chrono::milliseconds duration)
+        : event(std::move(event)), rate(rate), duration(duration) {}
+    ~PacedSource() override { stop(); }
+
+    INT start(EventSink& sink) override {
+        stopping = false;
+        worker = std::thread([this, &sink] {
+            char error[256] = "";
+            sink.deliverTransition(TR_START, 1, error);
+            auto* header = reinterpret_cast<EVENT_HEADER*>(event.data());
+            auto begin = std::chrono::steady_clock::now();
+            auto end = begin + duration;
+            uint64_t i = 0;
+            while (!stopping.load(std::memory_order_relaxed)) {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= end) {
+                    break;
+                }
+                if (rate > 0) {
+                    // Catch up to the schedule, then wait for the next slot
+                    uint64_t due = static_cast<uint64_t>(std::chrono::duration<double>(now - begin).count() * rate);
+                    if (i >= due) {
+                        sink.sourceIdle(SUCCESS);
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                        continue;
+                    }
+                }
+                header->serial_number = static_cast<DWORD>(i);
+                sink.deliverEvent(header);
+                if (++i % 4096 == 0) {
+                    sink.sourceIdle(SUCCESS);
+                }
+            }
+            sink.deliverTransition(TR_STOP, 1, error);
+            delivered = i;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            finished = true;
+        });
+        return SUCCESS;
+    }
+
+    void stop() override {
+        stopping = true;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    std::string describe() const override { return "paced"; }
+
+    std::atomic<bool> finished{false};
+    uint64_t delivered = 0;
+    double seconds = 0;
+
+private:
+    std::vector<char> event;
+    uint64_t rate;
+    std::chrono::milliseconds duration;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
+
+static std::vector<char> makeEvent(size_t bytes) {
+    size_t samples = bytes > sizeof(EVENT_HEADER) ? (bytes - sizeof(EVENT_HEADER)) / sizeof(int16_t) : 1;
+    std::vector<char> event(sizeof(EVENT_HEADER) + samples * sizeof(int16_t));
+    auto* header = reinterpret_cast<EVENT_HEADER*>(event.data());
+    header->event_id = 1;
+    header->trigger_mask = 1;
+    header->data_size = static_cast<DWORD>(samples * sizeof(int16_t));
+
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0.0, 2.0);
+    auto* wave = reinterpret_cast<int16_t*>(event.data() + sizeof(EVENT_HEADER));
+    for (size_t i = 0; i < samples; ++i) {
+        double pulse = 800.0 * std::exp(-std::pow((static_cast<double>(i % 512) - 40.0) / 12.0, 2));
+        wave[i] = static_cast<int16_t>(1000.0 + pulse + noise(rng));
+    }
+    return event;
+}
+
+static std::vector<uint64_t> parseList(const char* text) {
+    std::vector<uint64_t> out;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        out.push_back(std::strtoull(item.c_str(), nullptr, 10));
+    }
+    return out;
+}
+
+// Remove the files of the previous scenario and return the bytes they held
+static uint64_t clearDirectory(const std::string& directory) {
+    uint64_t bytes = 0;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return 0;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = directory + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            bytes += st.st_size;
+        }
+        std::remove(path.c_str());
+    }
+    closedir(dir);
+    return bytes;
+}
+
+int main(int argc, char** argv) {
+    const std::string directory = argc > 1 ? argv[1] : "/tmp/file_writer_bench";
+    const std::chrono::milliseconds duration(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000);
+    const std::vector<uint64_t> rates = parseList(argc > 3 ? argv[3] : "1000,10000,100000,0");
+    const std::vector<uint64_t> sizes = parseList(argc > 4 ? argv[4] : "1024,16384");
+    const char* formats[] = {"off", ".mid", ".mid.gz", ".mid.lz4"};
+
+    mkdir(directory.c_str(), 0755);
+    clearDirectory(directory);
+
+    std::printf("%-7s %6s %-8s %9s %7s %8s %8s %9s %9s %9s %11s %11s %9s %6s %6s %7s\n", "rate", "bytes", "format",
+                "events/s", "MB/s", "cb_p50", "cb_p99", "cb_p999", "write_p50", "write_p99", "to_file_p50",
+                "to_file_p99", "written", "drops", "waits", "disk_MB");
+    for (uint64_t size : sizes) {
+        for (uint64_t rate : rates) {
+            for (const char* format : formats) {
+                bool writing = std::strcmp(format, "off") != 0;
+                auto source = std::make_shared<PacedSource>(makeEvent(size), rate, duration);
+
+                MidasReceiverConfig config;
+                config.eventSource = source;
+                config.maxBufferSize = 100000;
+                if (writing) {
+                    config.fileWriter.directory = directory;
+                    config.fileWriter.pattern = std::string("run%05d_%03d") + format;
+                }
+                MidasReceiver receiver(config);
+                receiver.start();
+                while (!source->finished.load()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                receiver.stop();
+
+                ReceiverStats stats = receiver.getStats();
+                EventFileStats files = receiver.getFileWriterStats();
+                uint64_t disk = clearDirectory(directory);
+                double eventsPerSecond = source->delivered / source->seconds;
+                std::printf("%-7s %6llu %-8s %9.0f %7.1f %8llu %8llu %9llu %9llu %9llu %11llu %11llu %9llu %6llu %6llu "
+                            "%7.1f\n",
+                            rate > 0 ? std::to_string(rate).c_str() : "max", static_cast<unsigned long long>(size),
+                            format, eventsPerSecond, eventsPerSecond * size / 1e6,
+                            static_cast<unsigned long long>(stats.callbackTime.p50Ns),
+                            static_cast<unsigned long long>(stats.callbackTime.p99Ns),
+                            static_cast<unsigned long long>(stats.callbackTime.p999Ns),
+                            static_cast<unsigned long long>(files.writeTime.p50Ns),
+                            static_cast<unsigned long long>(files.writeTime.p99Ns),
+                            static_cast<unsigned long long>(files.eventToFile.p50Ns),
+                            static_cast<unsigned long long>(files.eventToFile.p99Ns),
+                            static_cast<unsigned long long>(files.writtenEvents),
+                            static_cast<unsigned long long>(files.droppedEvents),
+                            static_cast<unsigned long long>(files.bufferWaits), disk / 1e6);
+                std::fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}
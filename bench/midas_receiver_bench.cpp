@@ -0,0 +1,415 @@
+// End-to-end throughput and latency of MidasReceiver under synthetic load.
+//
+// A SyntheticSource stands in for the buffer manager: it delivers a
+// prebuilt event (with a fresh serial number each time) to the receiver as
+// fast as the receiver accepts it, on its own ingest thread, exactly as the
+// MIDAS callback would. Reader threads consume concurrently with one of the
+// query patterns below and decode the bank index of every event they see.
+//
+// For every combination of event size, bank count, reader count and pattern
+// it reports sustained events/s and bytes/s, the ingest-to-read latency
+// percentiles seen by the readers, and heap allocations per event, overall
+// and on the ingest thread alone.
+//
+// Patterns:
+//   cursor     waitForEvents() from a cursor (blocking, like a streaming consumer)
+//   latest     getLatestEvents(n) polled every millisecond (dashboards)
+//   since      getLatestEvents(since) polled every millisecond
+//   subscribe  a DropOldest subscription's wait()
+//
+// Usage: midas_receiver_bench [--sizes=64,1024,16384] [--banks=1,8] [--readers=0,1,4]
+//                             [--patterns=cursor,latest,since,subscribe] [--duration-ms=500]
+//                             [--json]
+// With --json every scenario is printed as one JSON object per line.
+#include "EventSource.h"
+#include "MidasReceiver.h"
+#include "ReceiverStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Allocation counting: every operator new in the process, and separately
+// those made on the ingest thread
+static std::atomic<bool> countAllocations{false};
+static std::atomic<uint64_t> allAllocations{0};
+static std::atomic<uint64_t> ingestAllocations{0};
+static thread_local bool onIngestThread = false;
+
+void* operator new(size_t size) {
+    if (countAllocations.load(std::memory_order_relaxed)) {
+        allAllocations.fetch_add(1, std::memory_order_relaxed);
+        if (onIngestThread) {
+            ingestAllocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// One raw MIDAS event of about `bytes` bytes, split into `banks` FLT banks
+static std::vector<char> makeEvent(size_t bytes, int banks) {
+    size_t floats = std::max<size_t>(1, bytes / (banks * sizeof(float)));
+    size_t bankBytes = sizeof(BANK32) + ((floats * sizeof(float) + 7) & ~size_t(7));
+    std::vector<char> event(sizeof(EVENT_HEADER) + sizeof(BANK_HEADER) + banks * bankBytes, 0);
+
+    auto* header = reinterpret_cast<EVENT_HEADER*>(event.data());
+    header->event_id = 1;
+    header->trigger_mask = 1;
+    header->data_size = static_cast<DWORD>(event.size() - sizeof(EVENT_HEADER));
+
+    auto* bankHeader = reinterpret_cast<BANK_HEADER*>(header + 1);
+    bankHeader->data_size = static_cast<DWORD>(banks * bankBytes);
+    bankHeader->flags = BANK_FORMAT_VERSION | BANK_FORMAT_32BIT;
+
+    char* p = reinterpret_cast<char*>(bankHeader + 1);
+    for (int b = 0; b < banks; ++b) {
+        auto* bank = reinterpret_cast<BANK32*>(p);
+        char name[5];
+        std::snprintf(name, sizeof(name), "B%03d", b % 1000); // Bank names are four characters
+        std::memcpy(bank->name, name, 4);
+        bank->type = TID_FLOAT;
+        bank->data_size = static_cast<DWORD>(floats * sizeof(float));
+        p += bankBytes;
+    }
+    return event;
+}
+
+// Delivers one template event over and over, as fast as the sink takes it
+class SyntheticSource : public EventSource {
+public:
+    explicit SyntheticSource(std::vector<char> event) : event(std::move(event)) {}
+    ~SyntheticSource() override { stop(); }
+
+    INT start(EventSink& sink) override {
+        stopping = false;
+        worker = std::thread([this, &sink] {
+            onIngestThread = true;
+            auto* header = reinterpret_cast<EVENT_HEADER*>(event.data());
+            for (uint64_t i = 0; !stopping.load(std::memory_order_relaxed); ++i) {
+                header->serial_number = static_cast<DWORD>(i);
+                sink.deliverEvent(header);
+                if (i % 4096 == 0) {
+                    sink.sourceIdle(SUCCESS);
+                }
+            }
+        });
+        return SUCCESS;
+    }
+
+    void stop() override {
+        stopping = true;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    std::string describe() const override { return "synthetic"; }
+
+private:
+    std::vector<char> event;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
+
+enum class Pattern { Cursor, Latest, Since, Subscribe };
+
+static const char* patternName(Pattern pattern) {
+    switch (pattern) {
+    case Pattern::Cursor:
+        return "cursor";
+    case Pattern::Latest:
+        return "latest";
+    case Pattern::Since:
+        return "since";
+    case Pattern::Subscribe:
+        return "subscribe";
+    }
+    return "?";
+}
+
+struct Scenario {
+    size_t eventBytes;
+    int banks;
+    int readers;
+    Pattern pattern;
+};
+
+struct Result {
+    size_t rawEventBytes = 0;
+    double eventsPerSecond = 0;
+    double bytesPerSecond = 0;
+    double readsPerSecond = 0;
+    LatencySummary latency;
+    double allocationsPerEvent = 0;
+    double ingestAllocationsPerEvent = 0;
+};
+
+// Shared by the readers of one scenario
+struct ReadStats {
+    std::atomic<bool> measuring{false};
+    std::atomic<uint64_t> read{0};
+    LatencyHistogram latency;
+
+    void consume(const std::vector<std::shared_ptr<TimedEvent>>& events) {
+        if (events.empty()) {
+            return;
+        }
+        auto now = std::chrono::system_clock::now();
+        size_t banks = 0;
+        for (const auto& event : events) {
+            banks += event->view().banks().size();
+            if (measuring.load(std::memory_order_relaxed)) {
+                auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(now - event->timestamp).count();
+                latency.record(waited > 0 ? static_cast<uint64_t>(waited) : 0);
+            }
+        }
+        volatile size_t sink = banks;
+        (void)sink;
+        if (measuring.load(std::memory_order_relaxed)) {
+            read.fetch_add(events.size(), std::memory_order_relaxed);
+        }
+    }
+};
+
+static void readLoop(MidasReceiver& receiver, Pattern pattern, ReadStats& stats, const std::atomic<bool>& done) {
+    const auto pollInterval = std::chrono::milliseconds(1);
+    uint64_t cursor = receiver.getEventCursor();
+    std::chrono::system_clock::time_point since = std::chrono::system_clock::now();
+    std::shared_ptr<Subscription> subscription;
+    if (pattern == Pattern::Subscribe) {
+        subscription = receiver.subscribe(SubscriptionFilter{}, BackpressurePolicy::DropOldest, 4096);
+    }
+
+    while (!done.load(std::memory_order_relaxed)) {
+        switch (pattern) {
+        case Pattern::Cursor: {
+            auto batch = receiver.waitForEvents(cursor, 1, std::chrono::milliseconds(100), 256);
+            cursor = batch.nextCursor;
+            stats.consume(batch.records);
+            break;
+        }
+        case Pattern::Latest: {
+            auto events = receiver.getLatestEvents(256);
+            std::vector<std::shared_ptr<TimedEvent>> fresh;
+            for (auto& event : events) {
+                if (event->sequence >= cursor) {
+                    fresh.push_back(std::move(event));
+                }
+            }
+            if (!fresh.empty()) {
+                cursor = fresh.back()->sequence + 1;
+            }
+            stats.consume(fresh);
+            std::this_thread::sleep_for(pollInterval);
+            break;
+        }
+        case Pattern::Since: {
+            auto events = receiver.getLatestEvents(256, since);
+            if (!events.empty()) {
+                since = events.back()->timestamp;
+            }
+            stats.consume(events);
+            std::this_thread::sleep_for(pollInterval);
+            break;
+        }
+        case Pattern::Subscribe:
+            stats.consume(subscription->wait(1, std::chrono::milliseconds(100), 256));
+            break;
+        }
+    }
+    if (subscription) {
+        receiver.unsubscribe(subscription);
+    }
+}
+
+static Result runScenario(const Scenario& scenario, std::chrono::milliseconds duration) {
+    std::vector<char> event = makeEvent(scenario.eventBytes, scenario.banks);
+    Result result;
+    result.rawEventBytes = event.size();
+
+    MidasReceiverConfig config;
+    config.maxBufferSize = 20000;
+    config.eventSource = std::make_shared<SyntheticSource>(std::move(event));
+    MidasReceiver receiver(config);
+
+    ReadStats stats;
+    std::atomic<bool> done{false};
+    receiver.start();
+    std::vector<std::thread> readers;
+    for (int i = 0; i < scenario.readers; ++i) {
+        readers.emplace_back(readLoop, std::ref(receiver), scenario.pattern, std::ref(stats), std::cref(done));
+    }
+
+    // Warm up the pool and the readers before measuring
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto before = receiver.getBufferUsage();
+    allAllocations = 0;
+    ingestAllocations = 0;
+    countAllocations = true;
+    stats.measuring = true;
+    auto start = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(duration);
+
+    auto after = receiver.getBufferUsage();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    countAllocations = false;
+    stats.measuring = false;
+    uint64_t allocations = allAllocations.load();
+    uint64_t ingest = ingestAllocations.load();
+
+    done = true;
+    receiver.stop(); // Wakes blocked readers
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    uint64_t events = after.receivedEvents - before.receivedEvents;
+    result.eventsPerSecond = events / seconds;
+    result.bytesPerSecond = (after.receivedBytes - before.receivedBytes) / seconds;
+    result.readsPerSecond = stats.read.load() / seconds;
+    result.latency = stats.latency.summary();
+    result.allocationsPerEvent = events > 0 ? static_cast<double>(allocations) / events : 0;
+    result.ingestAllocationsPerEvent = events > 0 ? static_cast<double>(ingest) / events : 0;
+    return result;
+}
+
+template <typename T>
+static std::vector<T> parseList(const std::string& text, T (*parse)(const std::string&)) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(parse(item));
+        }
+    }
+    return values;
+}
+
+static size_t parseSize(const std::string& s) {
+    return std::strtoull(s.c_str(), nullptr, 10);
+}
+
+static int parseInt(const std::string& s) {
+    return std::atoi(s.c_str());
+}
+
+static Pattern parsePattern(const std::string& s) {
+    if (s == "latest") {
+        return Pattern::Latest;
+    }
+    if (s == "since") {
+        return Pattern::Since;
+    }
+    if (s == "subscribe") {
+        return Pattern::Subscribe;
+    }
+    return Pattern::Cursor;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes{64, 1024, 16384};
+    std::vector<int> banks{1, 8};
+    std::vector<int> readerCounts{0, 1, 4};
+    std::vector<Pattern> patterns{Pattern::Cursor, Pattern::Latest, Pattern::Since, Pattern::Subscribe};
+    std::chrono::milliseconds duration(500);
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+        if (arg.rfind("--sizes=", 0) == 0) {
+            sizes = parseList(value, parseSize);
+        } else if (arg.rfind("--banks=", 0) == 0) {
+            banks = parseList(value, parseInt);
+        } else if (arg.rfind("--readers=", 0) == 0) {
+            readerCounts = parseList(value, parseInt);
+        } else if (arg.rfind("--patterns=", 0) == 0) {
+            patterns = parseList(value, parsePattern);
+        } else if (arg.rfind("--duration-ms=", 0) == 0) {
+            duration = std::chrono::milliseconds(std::atoi(value.c_str()));
+        } else if (arg == "--json") {
+            json = true;
+        } else {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (!json) {
+        std::printf("%8s %5s %7s %-9s %12s %10s %10s %10s %10s %10s %8s %8s\n", "bytes", "banks", "readers",
+                    "pattern", "events/s", "MB/s", "reads/s", "p50_ns", "p99_ns", "p999_ns", "alloc/ev",
+                    "ingest");
+    }
+    for (size_t size : sizes) {
+        for (int bankCount : banks) {
+            for (int readers : readerCounts) {
+                for (Pattern pattern : patterns) {
+                    Scenario scenario{size, bankCount, readers, pattern};
+                    Result r = runScenario(scenario, duration);
+                    const char* name = readers > 0 ? patternName(pattern) : "none";
+                    if (json) {
+                        std::printf("{\"event_bytes\":%zu,\"banks\":%d,\"readers\":%d,\"pattern\":\"%s\","
+                                    "\"events_per_s\":%.0f,\"bytes_per_s\":%.0f,\"reads_per_s\":%.0f,"
+                                    "\"latency_ns\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu},"
+                                    "\"allocs_per_event\":%.3f,\"ingest_allocs_per_event\":%.3f}\n",
+                                    r.rawEventBytes, bankCount, readers, name, r.eventsPerSecond,
+                                    r.bytesPerSecond, r.readsPerSecond,
+                                    static_cast<unsigned long long>(r.latency.p50Ns),
+                                    static_cast<unsigned long long>(r.latency.p99Ns),
+                                    static_cast<unsigned long long>(r.latency.p999Ns),
+                                    static_cast<unsigned long long>(r.latency.maxNs), r.allocationsPerEvent,
+                                    r.ingestAllocationsPerEvent);
+                    } else {
+                        std::printf("%8zu %5d %7d %-9s %12.0f %10.1f %10.0f %10llu %10llu %10llu %8.3f %8.3f\n",
+                                    r.rawEventBytes, bankCount, readers, name, r.eventsPerSecond,
+                                    r.bytesPerSecond / 1e6, r.readsPerSecond,
+                                    static_cast<unsigned long long>(r.latency.p50Ns),
+                                    static_cast<unsigned long long>(r.latency.p99Ns),
+                                    static_cast<unsigned long long>(r.latency.p999Ns), r.allocationsPerEvent,
+                                    r.ingestAllocationsPerEvent);
+                    }
+                    std::fflush(stdout);
+                    if (readers == 0) {
+                        break; // The pattern makes no difference without readers
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
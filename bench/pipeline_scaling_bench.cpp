@@ -0,0 +1,156 @@
+// Throughput of inline decoding versus the EventPipeline with 1..N workers.
+//
+// The ingest thread does exactly what the MIDAS callback does: take a pooled
+// block, copy the raw event into it and hand it on. Each event carries a few
+// float banks and the handler sums them, standing in for per-event decoding.
+// Published events go into a SequencedRing; the publisher also checks that
+// they arrive in ingest order.
+//
+// Events go to worker event_id % workers, so a stream with k distinct event
+// IDs keeps at most k workers busy. Each worker count is run with 1, 2 and 8
+// IDs to show that limit.
+#include "EventPipeline.h"
+#include "SequencedRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const size_t kMaxEventSize = 10 * 1024 * 1024;
+
+// One raw MIDAS event with `banks` FLT banks of `floats` values each
+static std::vector<char> makeEvent(uint16_t eventId, int banks, int floats) {
+    size_t bankBytes = sizeof(BANK32) + ((floats * sizeof(float) + 7) & ~size_t(7));
+    std::vector<char> bytes(sizeof(EVENT_HEADER) + sizeof(BANK_HEADER) + banks * bankBytes, 0);
+
+    auto* event = reinterpret_cast<EVENT_HEADER*>(bytes.data());
+    event->event_id = eventId;
+    event->trigger_mask = 1;
+    event->data_size = static_cast<DWORD>(bytes.size() - sizeof(EVENT_HEADER));
+
+    auto* bankHeader = reinterpret_cast<BANK_HEADER*>(event + 1);
+    bankHeader->data_size = static_cast<DWORD>(banks * bankBytes);
+    bankHeader->flags = BANK_FORMAT_VERSION | BANK_FORMAT_32BIT;
+
+    char* p = reinterpret_cast<char*>(bankHeader + 1);
+    for (int b = 0; b < banks; ++b) {
+        auto* bank = reinterpret_cast<BANK32*>(p);
+        char name[5];
+        std::snprintf(name, sizeof(name), "B%03d", b % 1000); // Bank names are four characters
+        std::memcpy(bank->name, name, 4);
+        bank->type = TID_FLOAT;
+        bank->data_size = static_cast<DWORD>(floats * sizeof(float));
+        auto* values = reinterpret_cast<float*>(bank + 1);
+        for (int i = 0; i < floats; ++i) {
+            values[i] = static_cast<float>(i);
+        }
+        p += bankBytes;
+    }
+    return bytes;
+}
+
+// Stand-in for real decoding: touch every value of every bank
+static void decode(const TimedEvent& event) {
+    float sum = 0;
+    event.view().forEachBank([&sum](const BankSpan& bank) {
+        const float* values = bank.as<float>();
+        for (size_t i = 0, n = bank.count<float>(); i < n; ++i) {
+            sum += values[i];
+        }
+        return true;
+    });
+    volatile float sink = sum;
+    (void)sink;
+}
+
+struct Result {
+    double eventsPerSecond;
+    uint64_t stalls;
+    bool ordered;
+};
+
+// workers == 0 decodes on the ingest thread, like the receiver's default mode
+static Result runOnce(size_t workers, const std::vector<std::vector<char>>& templates, uint64_t events) {
+    auto pool = std::make_shared<EventPool>(kMaxEventSize, 64 * 1024 * 1024);
+    SequencedRing<std::shared_ptr<TimedEvent>> ring(1000);
+
+    std::chrono::system_clock::time_point last{};
+    bool ordered = true;
+    auto publish = [&](std::shared_ptr<TimedEvent>&& event) {
+        if (event->timestamp < last) {
+            ordered = false;
+        }
+        last = event->timestamp;
+        event->sequence = ring.head();
+        ring.push(std::move(event));
+    };
+
+    std::unique_ptr<EventPipeline> pipeline;
+    if (workers > 0) {
+        pipeline = std::make_unique<EventPipeline>(workers, 4096, std::vector<EventPipeline::Handler>{decode},
+                                                   publish);
+        pipeline->start();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < events; ++i) {
+        const auto& bytes = templates[i % templates.size()];
+        auto event = std::allocate_shared<TimedEvent>(PoolAllocator<TimedEvent>(pool));
+        // Strictly increasing stand-in timestamps make reordering visible
+        event->timestamp = std::chrono::system_clock::time_point(std::chrono::nanoseconds(i));
+        event->raw = pool->acquire(bytes.size());
+        std::memcpy(event->raw.data(), bytes.data(), bytes.size());
+        if (pipeline) {
+            pipeline->submit(std::move(event));
+        } else {
+            decode(*event);
+            publish(std::move(event));
+        }
+    }
+    uint64_t stalls = 0;
+    if (pipeline) {
+        pipeline->stop();
+        stalls = pipeline->stagingStalls();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {events / seconds, stalls, ordered && ring.head() == events};
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t events = 200000;
+    int floats = 1024;
+    size_t maxWorkers = std::thread::hardware_concurrency();
+
+    if (argc > 1) {
+        events = std::strtoull(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        floats = std::atoi(argv[2]);
+    }
+    if (argc > 3) {
+        maxWorkers = std::strtoul(argv[3], nullptr, 10);
+    }
+
+    std::cout << "events=" << events << " floats_per_bank=" << floats
+              << " hardware_threads=" << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "event_ids,workers,events_per_s,staging_stalls,ordered" << std::endl;
+
+    for (uint16_t ids : {1, 2, 8}) {
+        std::vector<std::vector<char>> templates;
+        for (uint16_t id = 0; id < ids; ++id) {
+            templates.push_back(makeEvent(id, 4, floats));
+        }
+        for (size_t workers = 0; workers <= maxWorkers; workers = workers == 0 ? 1 : workers * 2) {
+            Result r = runOnce(workers, templates, events);
+            std::cout << ids << "," << workers << "," << static_cast<uint64_t>(r.eventsPerSecond) << ","
+                      << r.stalls << "," << (r.ordered ? "yes" : "no") << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+// What batched delivery buys over one callback per event.
+//
+// A BatchSource stands in for a pull-mode MidasBufferSource: it fills a
+// preallocated batch with copies of a template event (fresh serial numbers)
+// and hands it to the receiver with deliverEvents(), which publishes the
+// whole batch with one ring commit and one notification. A batch size of 1
+// uses deliverEvent() instead, i.e. callback mode.
+//
+// For every batch size and reader count it reports sustained events/s,
+// sink deliveries per event and, with readers, how many events each
+// waitForEvents() wakeup returned on average.
+//
+// The number of bm_receive_event calls and yields per event against a live
+// buffer is not measured here; MidasBufferSource::readStats() reports it.
+//
+// Usage: pull_batch_bench [--batches=1,16,64,256,1024] [--size=256] [--readers=0,1]
+//                         [--duration-ms=500]
+#include "EventSource.h"
+#include "MidasReceiver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class BatchSource : public EventSource {
+public:
+    BatchSource(size_t eventBytes, size_t batchEvents) : batchEvents(batchEvents) {
+        stride = (sizeof(EVENT_HEADER) + eventBytes + 7) & ~size_t(7);
+        storage.assign(stride * batchEvents / sizeof(uint64_t), 0);
+        for (size_t i = 0; i < batchEvents; ++i) {
+            auto* header = reinterpret_cast<EVENT_HEADER*>(reinterpret_cast<char*>(storage.data()) + i * stride);
+            header->event_id = 1;
+            header->trigger_mask = 1;
+            header->data_size = static_cast<DWORD>(eventBytes);
+            headers.push_back(header);
+        }
+    }
+    ~BatchSource() override { stop(); }
+
+    INT start(EventSink& sink) override {
+        stopping = false;
+        worker = std::thread([this, &sink] {
+            uint64_t serial = 0;
+            for (uint64_t round = 0; !stopping.load(std::memory_order_relaxed); ++round) {
+                for (auto* header : headers) {
+                    header->serial_number = static_cast<DWORD>(serial++);
+                }
+                if (batchEvents == 1) {
+                    sink.deliverEvent(headers.front());
+                } else {
+                    sink.deliverEvents(headers.data(), headers.size());
+                }
+                deliveries.fetch_add(1, std::memory_order_relaxed);
+                if (round % (4096 / batchEvents + 1) == 0) {
+                    sink.sourceIdle(SUCCESS);
+                }
+            }
+        });
+        return SUCCESS;
+    }
+
+    void stop() override {
+        stopping = true;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    std::string describe() const override { return "batch"; }
+
+    std::atomic<uint64_t> deliveries{0};
+
+private:
+    size_t batchEvents;
+    size_t stride = 0;
+    std::vector<uint64_t> storage;
+    std::vector<EVENT_HEADER*> headers;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
+
+static std::vector<size_t> parseList(const std::string& value) {
+    std::vector<size_t> result;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        result.push_back(std::strtoull(item.c_str(), nullptr, 10));
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> batchSizes = {1, 16, 64, 256, 1024};
+    std::vector<size_t> readerCounts = {0, 1};
+    size_t eventBytes = 256;
+    int durationMs = 500;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix) { return arg.substr(std::strlen(prefix)); };
+        if (arg.rfind("--batches=", 0) == 0) {
+            batchSizes = parseList(value("--batches="));
+        } else if (arg.rfind("--size=", 0) == 0) {
+            eventBytes = std::strtoull(value("--size=").c_str(), nullptr, 10);
+        } else if (arg.rfind("--readers=", 0) == 0) {
+            readerCounts = parseList(value("--readers="));
+        } else if (arg.rfind("--duration-ms=", 0) == 0) {
+            durationMs = std::atoi(value("--duration-ms=").c_str());
+        } else {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    std::printf("%8s %8s %14s %14s %16s\n", "batch", "readers", "events/s", "deliv/event", "events/wakeup");
+    for (size_t readers : readerCounts) {
+        for (size_t batch : batchSizes) {
+            batch = std::max<size_t>(batch, 1);
+            auto source = std::make_shared<BatchSource>(eventBytes, batch);
+            MidasReceiverConfig config;
+            config.maxBufferSize = 65536;
+            config.eventSource = source;
+            MidasReceiver receiver(config);
+
+            std::atomic<bool> done{false};
+            std::atomic<uint64_t> wakeups{0}, read{0};
+            std::vector<std::thread> threads;
+            for (size_t r = 0; r < readers; ++r) {
+                threads.emplace_back([&] {
+                    uint64_t cursor = receiver.getEventCursor();
+                    while (!done.load(std::memory_order_relaxed)) {
+                        auto result = receiver.waitForEvents(cursor, 1, std::chrono::milliseconds(50));
+                        cursor = result.nextCursor;
+                        if (!result.records.empty()) {
+                            wakeups.fetch_add(1, std::memory_order_relaxed);
+                            read.fetch_add(result.records.size(), std::memory_order_relaxed);
+                        }
+                    }
+                });
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            receiver.start();
+            std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+            receiver.stop();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            done = true;
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            uint64_t events = receiver.getBufferUsage().receivedEvents;
+            uint64_t deliveries = source->deliveries.load();
+            std::printf("%8zu %8zu %14.0f %14.4f %16.1f\n", batch, readers, events / seconds,
+                        events ? static_cast<double>(deliveries) / events : 0.0,
+                        wakeups ? static_cast<double>(read) / wakeups : 0.0);
+        }
+    }
+    return 0;
+}
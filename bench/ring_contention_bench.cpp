@@ -0,0 +1,177 @@
+// Ingest rate of the event store with 0, 1 and 8 concurrent readers.
+//
+// A single producer pushes shared_ptr records as fast as it can while reader
+// threads continuously read the whole store, the way dashboard clients poll
+// getWholeBuffer(). Compared: the mutex-guarded std::deque the receiver used
+// first, copies out of the lock-free SequencedRing, and zero-copy ring
+// snapshots (snapshotEvents()), which touch no reference counts.
+#include "SequencedRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Payload {
+    char bytes[64];
+};
+
+using Record = std::shared_ptr<Payload>;
+
+static std::atomic<unsigned> touched{0};
+
+static size_t touch(const std::vector<Record>& records) {
+    unsigned sum = 0;
+    for (const Record& record : records) {
+        sum += static_cast<unsigned char>(record->bytes[0]);
+    }
+    touched.fetch_add(sum, std::memory_order_relaxed);
+    return records.size();
+}
+
+// The store the receiver used before: every push and every snapshot share one mutex
+class MutexDequeStore {
+public:
+    explicit MutexDequeStore(size_t capacity) : capacity(capacity) {}
+
+    void push(Record record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (records.size() >= capacity) {
+            records.pop_front();
+        }
+        records.push_back(std::move(record));
+    }
+
+    // Every reader below touches each record once and returns how many it saw
+    size_t read() {
+        std::vector<Record> copy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            copy.assign(records.begin(), records.end());
+        }
+        return touch(copy);
+    }
+
+private:
+    size_t capacity;
+    std::deque<Record> records;
+    std::mutex mutex;
+};
+
+class RingStore {
+public:
+    explicit RingStore(size_t capacity) : ring(capacity) {}
+
+    void push(Record record) { ring.push(std::move(record)); }
+
+    size_t read() { return touch(ring.copyRange(0, ring.head())); }
+
+private:
+    SequencedRing<Record> ring;
+};
+
+class RingSnapshotStore {
+public:
+    explicit RingSnapshotStore(size_t capacity) : ring(capacity) {}
+
+    void push(Record record) { ring.push(std::move(record)); }
+
+    size_t read() {
+        SequencedRing<Record>::Snapshot snapshot(ring, 0, UINT64_MAX);
+        size_t seen = 0;
+        unsigned sum = 0;
+        for (const Record& record : snapshot) {
+            sum += static_cast<unsigned char>(record->bytes[0]);
+            ++seen;
+        }
+        sink += sum;
+        return seen;
+    }
+
+private:
+    SequencedRing<Record> ring;
+    std::atomic<unsigned> sink{0};
+};
+
+struct Result {
+    double eventsPerSecond;
+    double snapshotsPerSecond;
+};
+
+template <typename Store>
+Result runOnce(size_t capacity, int readers, std::chrono::milliseconds duration) {
+    Store store(capacity);
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> snapshots{0};
+
+    // Pre-built records keep malloc out of the measurement
+    std::vector<Record> records(capacity * 2);
+    for (auto& record : records) {
+        record = std::make_shared<Payload>();
+    }
+
+    std::vector<std::thread> readerThreads;
+    for (int i = 0; i < readers; ++i) {
+        readerThreads.emplace_back([&] {
+            uint64_t local = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                local += store.read() > 0 ? 1 : 0;
+            }
+            snapshots.fetch_add(local);
+        });
+    }
+
+    uint64_t pushed = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + duration;
+    while (true) {
+        for (int i = 0; i < 1024; ++i) {
+            store.push(records[pushed++ % records.size()]);
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    done = true;
+    for (auto& t : readerThreads) {
+        t.join();
+    }
+    return {pushed / seconds, snapshots.load() / seconds};
+}
+
+int main(int argc, char* argv[]) {
+    size_t capacity = 1000;
+    int durationMs = 2000;
+
+    if (argc > 1) {
+        capacity = std::strtoul(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        durationMs = std::atoi(argv[2]);
+    }
+
+    std::cout << "capacity=" << capacity << " duration=" << durationMs << "ms"
+              << " hardware_threads=" << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "store,readers,events_per_s,snapshots_per_s" << std::endl;
+
+    for (int readers : {0, 1, 8}) {
+        auto duration = std::chrono::milliseconds(durationMs);
+        Result ring = runOnce<RingStore>(capacity, readers, duration);
+        Result snapshot = runOnce<RingSnapshotStore>(capacity, readers, duration);
+        Result locked = runOnce<MutexDequeStore>(capacity, readers, duration);
+        std::cout << "ring," << readers << "," << static_cast<uint64_t>(ring.eventsPerSecond) << ","
+                  << static_cast<uint64_t>(ring.snapshotsPerSecond) << std::endl;
+        std::cout << "ring_snapshot," << readers << "," << static_cast<uint64_t>(snapshot.eventsPerSecond) << ","
+                  << static_cast<uint64_t>(snapshot.snapshotsPerSecond) << std::endl;
+        std::cout << "mutex_deque," << readers << "," << static_cast<uint64_t>(locked.eventsPerSecond) << ","
+                  << static_cast<uint64_t>(locked.snapshotsPerSecond) << std::endl;
+    }
+    return 0;
+}
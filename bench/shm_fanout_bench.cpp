@@ -0,0 +1,160 @@
+// Fan-out through the shared-memory event ring.
+//
+// The parent process writes synthetic events into a ShmRingWriter as fast as
+// it can, the way a receiver's commitStaged() does, while N forked reader
+// processes map the ring with ShmRingReader and walk every event in place.
+// Reported per reader count:
+//   - writer throughput, which should not depend on the number of readers
+//   - the slowest reader's throughput and how many events readers lost by
+//     being lapped
+//   - torn: events whose bytes did not match their sequence although the
+//     reader found them intact; anything but 0 is a bug
+//
+// Usage: shm_fanout_bench [events] [event bytes] [ring MiB] [max readers]
+#include "ShmRing.h"
+#include "ShmRingWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct ReaderResult {
+    uint64_t events = 0;
+    uint64_t missed = 0;
+    uint64_t torn = 0;
+    double seconds = 0;
+};
+
+static const char* kRingName = "/midas_shm_fanout_bench";
+
+// Child process: read until the writer closes, then report through the pipe
+static void runReader(int readyFd, int resultFd) {
+    ShmRingReader reader;
+    ReaderResult result;
+    if (reader.open(kRingName, true)) {
+        char ready = 1;
+        (void)!write(readyFd, &ready, 1);
+
+        uint64_t sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        bool started = false;
+        auto visit = [&](const ShmRingReader::Record& record) {
+            uint64_t stamp;
+            std::memcpy(&stamp, record.data, sizeof(stamp));
+            sum += stamp;
+            if (stamp != record.sequence && record.intact()) {
+                ++result.torn;
+            }
+        };
+        for (;;) {
+            size_t n = reader.poll(visit);
+            if (n > 0 && !started) {
+                start = std::chrono::steady_clock::now();
+                started = true;
+            }
+            result.events += n;
+            if (n == 0 && !reader.wait(std::chrono::milliseconds(100)) && reader.writerClosed()) {
+                // The writer may have published more just before closing
+                n = reader.poll(visit);
+                result.events += n;
+                if (n == 0) {
+                    break;
+                }
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.missed = reader.missed();
+        volatile uint64_t sink = sum; // Keeps the reads from being optimised away
+        (void)sink;
+    } else {
+        std::cerr << reader.error() << std::endl;
+        char ready = 0;
+        (void)!write(readyFd, &ready, 1);
+    }
+    (void)!write(resultFd, &result, sizeof(result));
+}
+
+int main(int argc, char** argv) {
+    const uint64_t events = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const size_t eventBytes = std::max<size_t>(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1024, 8);
+    const size_t ringBytes = (argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64) * 1024 * 1024;
+    const size_t maxReaders = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 8;
+    const size_t batch = 64; // Events per publish, like a pull-mode batch
+
+    std::cout << "events=" << events << " event_bytes=" << eventBytes << " ring_bytes=" << ringBytes
+              << " hardware_threads=" << sysconf(_SC_NPROCESSORS_ONLN) << std::endl;
+    std::cout << "readers,writer_events_per_s,writer_mb_per_s,slowest_reader_events_per_s,missed,torn" << std::endl;
+
+    std::vector<char> payload(eventBytes, 0x5a);
+    for (size_t readers = 0; readers <= maxReaders; readers = readers == 0 ? 1 : readers * 2) {
+        auto writer = std::make_unique<ShmRingWriter>(kRingName, ringBytes);
+        if (!writer->isOpen()) {
+            return 1;
+        }
+
+        int ready[2], results[2];
+        if (pipe(ready) != 0 || pipe(results) != 0) {
+            return 1;
+        }
+        std::vector<pid_t> children;
+        for (size_t i = 0; i < readers; ++i) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                runReader(ready[1], results[1]);
+                _exit(0);
+            }
+            children.push_back(pid);
+        }
+        for (size_t i = 0; i < readers; ++i) {
+            char ok = 0;
+            (void)!read(ready[0], &ok, 1);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto now = std::chrono::system_clock::now();
+        for (uint64_t sequence = 0; sequence < events; ++sequence) {
+            std::memcpy(payload.data(), &sequence, sizeof(sequence));
+            writer->write(sequence, now, payload.data(), payload.size());
+            if ((sequence + 1) % batch == 0) {
+                writer->publish();
+            }
+        }
+        writer->publish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Closing the ring tells the readers to finish
+        writer.reset();
+
+        double slowest = readers > 0 ? 1e300 : 0;
+        uint64_t missed = 0, torn = 0;
+        for (size_t i = 0; i < readers; ++i) {
+            ReaderResult result;
+            (void)!read(results[0], &result, sizeof(result));
+            double rate = result.seconds > 0 ? result.events / result.seconds : 0;
+            slowest = std::min(slowest, rate);
+            missed += result.missed;
+            torn += result.torn;
+        }
+        for (pid_t pid : children) {
+            waitpid(pid, nullptr, 0);
+        }
+        close(ready[0]);
+        close(ready[1]);
+        close(results[0]);
+        close(results[1]);
+
+        std::cout << readers << "," << static_cast<uint64_t>(events / seconds) << ","
+                  << static_cast<uint64_t>(events * eventBytes / seconds / 1e6) << ","
+                  << static_cast<uint64_t>(slowest) << "," << missed << "," << torn << std::endl;
+    }
+    return 0;
+}
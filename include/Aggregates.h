@@ -0,0 +1,216 @@
+#ifndef AGGREGATES_H
+#define AGGREGATES_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "midas.h"
+
+#include "Subscription.h"
+#include "TimedEvent.h"
+
+// Which values of a bank an aggregate reads. Values are decoded with the
+// bank's own TID; banks of TID_CHAR, TID_BOOL or struct types are ignored.
+// With channels > 1 the bank holds that many interleaved channels and
+// channel picks one of them; channel -1 takes every value.
+struct BankChannel {
+    std::string bank;            // Four-character bank name
+    int channel = -1;
+    uint32_t channels = 1;
+    int eventID = EVENTID_ALL;   // Only events with this ID
+};
+
+// Fixed-bin histogram of a bank channel, e.g. an ADC spectrum
+struct HistogramSpec {
+    std::string name;
+    BankChannel source;
+    size_t bins = 1024;
+    double min = 0;
+    double max = 1024;
+};
+
+// Sum and mean of a bank channel's values over a sliding time window
+struct WindowSpec {
+    std::string name;
+    BankChannel source;
+    std::chrono::milliseconds window{10000};
+};
+
+struct AggregateOptions {
+    bool eventRates = false;                      // Per-event-ID rates over rateWindow
+    std::chrono::milliseconds rateWindow{10000};
+    std::vector<HistogramSpec> histograms;
+    std::vector<WindowSpec> windows;
+    size_t queueCapacity = 65536;                 // Events queued for the worker before the oldest are dropped
+};
+
+struct HistogramSnapshot {
+    std::string name;
+    int runNumber = 0;
+    double min = 0;
+    double max = 0;
+    std::vector<uint64_t> counts;  // One per bin
+    uint64_t underflow = 0;        // Below min, or NaN
+    uint64_t overflow = 0;         // At or above max
+    uint64_t entries = 0;          // Every value, in range or not
+    double sum = 0;                // Of the in-range values
+
+    double mean() const {
+        uint64_t inRange = entries - underflow - overflow;
+        return inRange > 0 ? sum / static_cast<double>(inRange) : 0;
+    }
+};
+
+struct WindowSnapshot {
+    std::string name;
+    int runNumber = 0;
+    std::chrono::milliseconds window{0};
+    uint64_t count = 0;      // Values in the window
+    double sum = 0;
+    double mean = 0;
+    uint64_t runCount = 0;   // Since the run started
+    double runSum = 0;
+};
+
+struct EventRate {
+    uint16_t eventId = 0;
+    uint64_t runEvents = 0;  // Since the run started
+    double perSecond = 0;    // Over the rate window
+};
+
+// Worker-side bookkeeping, for checking the aggregates keep up
+struct AggregateStats {
+    int runNumber = 0;
+    uint64_t processedEvents = 0;
+    uint64_t droppedEvents = 0;  // Lost to a full queue; the aggregates undercount by this much
+    uint64_t lateEvents = 0;     // Arrived after their run was reset and were skipped
+};
+
+// Online aggregates over the event stream: histograms and sliding-window
+// sums of bank channels, and per-event-ID rates, updated incrementally as
+// events arrive so dashboards can read them instead of re-scanning the event
+// buffer.
+//
+// The work runs on the engine's own thread, fed by a Subscription, never on
+// the ingest thread; a worker that falls behind drops events (and counts
+// them) rather than stalling ingest. Snapshots copy a single aggregate under
+// a short lock. beginRun() resets everything at the given time: events stamped
+// before it that are still queued are skipped, so a run's figures never mix
+// with the previous run's.
+class AggregateEngine {
+public:
+    explicit AggregateEngine(const AggregateOptions& options);
+    ~AggregateEngine();
+
+    AggregateEngine(const AggregateEngine&) = delete;
+    AggregateEngine& operator=(const AggregateEngine&) = delete;
+
+    // Register another aggregate; false if the name is taken or the spec is
+    // invalid. Takes effect from the next event the worker processes.
+    bool addHistogram(const HistogramSpec& spec);
+    bool addWindow(const WindowSpec& spec);
+    void enableEventRates(std::chrono::milliseconds window);
+
+    // True if there is anything to compute, i.e. the engine needs a worker
+    bool hasAggregates() const;
+
+    // Start the worker on events from subscription; stop() waits for it
+    void start(std::shared_ptr<Subscription> subscription);
+    void stop();
+    bool isRunning() const { return worker.joinable(); }
+
+    // Ingest thread, at a run start: reset before the first event stamped at
+    // or after `at`
+    void beginRun(int runNumber, std::chrono::system_clock::time_point at);
+
+    // Reset now, keeping the run number
+    void reset();
+
+    // False if there is no aggregate of that name
+    bool histogram(const std::string& name, HistogramSnapshot& out) const;
+    bool window(const std::string& name, WindowSnapshot& out) const;
+    std::vector<EventRate> eventRates() const;
+    AggregateStats stats() const;
+
+private:
+    // Time-bucketed counter for windowed figures: kBuckets buckets, each
+    // covering window / kBuckets
+    struct Buckets {
+        static constexpr size_t kBuckets = 20;
+        int64_t width = 0;                 // Nanoseconds per bucket
+        int64_t newest = INT64_MIN;        // Index of the newest bucket
+        uint64_t counts[kBuckets] = {};
+        double sums[kBuckets] = {};
+
+        void init(std::chrono::milliseconds window);
+        void add(int64_t timeNs, uint64_t count, double sum);
+        void clear();
+        void total(int64_t nowNs, int64_t sinceNs, uint64_t& count, double& sum, double& seconds) const;
+    };
+
+    struct Source {
+        uint32_t bank = 0;   // Packed name
+        int channel = -1;
+        uint32_t channels = 1;
+        int eventID = EVENTID_ALL;
+    };
+
+    struct Histogram {
+        HistogramSpec spec;
+        Source source;
+        std::vector<uint64_t> counts; // Underflow, bins, overflow
+        uint64_t entries = 0;
+        double sum = 0;
+    };
+
+    struct Window {
+        WindowSpec spec;
+        Source source;
+        Buckets buckets;
+        uint64_t runCount = 0;
+        double runSum = 0;
+    };
+
+    struct Rate {
+        uint64_t runEvents = 0;
+        Buckets buckets;
+    };
+
+    struct PendingRun {
+        int runNumber;
+        int64_t atNs;
+    };
+
+    static bool compile(const BankChannel& channel, Source& source);
+    void workerLoop(std::shared_ptr<Subscription> events);
+    void process(const TimedEvent& event);
+    void applyRunStart(const PendingRun& run);
+    void resetLocked();
+
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+
+    // Guards everything below; the worker holds it for one event at a time
+    mutable std::mutex mutex;
+    std::shared_ptr<Subscription> subscription; // Kept after stop() for its counters
+    std::vector<std::unique_ptr<Histogram>> histograms;
+    std::vector<std::unique_ptr<Window>> windows;
+    bool ratesEnabled = false;
+    std::chrono::milliseconds rateWindow{10000};
+    std::unordered_map<uint16_t, Rate> rates;
+    std::deque<PendingRun> pendingRuns;
+    int runNumber = 0;
+    int64_t runStartNs = INT64_MIN;
+    uint64_t processedEvents = 0;
+    uint64_t lateEvents = 0;
+};
+
+#endif
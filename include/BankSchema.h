@@ -0,0 +1,373 @@
+#ifndef BANK_SCHEMA_H
+#define BANK_SCHEMA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "midas.h"
+
+#include "EventView.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BANK_SCHEMA_X86 1
+#include <immintrin.h>
+#endif
+
+// Compile-time bank schemas: declare once what a bank holds and get a
+// decoder specialised for it, instead of walking TMEvent::banks and
+// reinterpreting bytes by hand in every consumer.
+//
+//   using Adc = BankSchema<bankName("ADC0"), uint16_t, 4>;   // 4 interleaved channels
+//   BankSpan bank = Adc::find(event.view());
+//   size_t samples = Adc::samples(bank);
+//   Adc::channelToFloat(bank, 2, out, samples);               // channel 2 as float
+//
+// Lookup compares the packed bank name as an integer constant. Conversion to
+// float runs through the kernels in BankConvert: SSE2 on x86-64, AVX2 and
+// SSSE3 when the CPU has them (checked once at run time, so no special
+// build flags are needed), and plain loops elsewhere.
+// Everything is header-only.
+
+// Two 12-bit samples in three bytes, little-endian: the first sample is the
+// low 12 bits of the 24-bit group, the second the high 12 bits. Stored in
+// TID_UINT8 banks.
+struct Packed12 {};
+
+// How a multi-channel bank is laid out
+enum class BankLayout {
+    Interleaved,  // Sample-major: s0c0 s0c1 ... s1c0 s1c1 ...
+    ChannelMajor  // All samples of channel 0, then channel 1, ...
+};
+
+// Storage traits for a bank element type
+template <typename Element>
+struct BankElement;
+
+#define BANK_SCHEMA_ELEMENT(TYPE, TID)                                                       \
+    template <>                                                                             \
+    struct BankElement<TYPE> {                                                              \
+        static constexpr uint32_t tid = TID;                                                \
+        static size_t count(size_t bytes) { return bytes / sizeof(TYPE); }                  \
+    };
+BANK_SCHEMA_ELEMENT(uint8_t, TID_UINT8)
+BANK_SCHEMA_ELEMENT(int8_t, TID_INT8)
+BANK_SCHEMA_ELEMENT(uint16_t, TID_UINT16)
+BANK_SCHEMA_ELEMENT(int16_t, TID_INT16)
+BANK_SCHEMA_ELEMENT(uint32_t, TID_UINT32)
+BANK_SCHEMA_ELEMENT(int32_t, TID_INT32)
+BANK_SCHEMA_ELEMENT(float, TID_FLOAT)
+BANK_SCHEMA_ELEMENT(double, TID_DOUBLE)
+#undef BANK_SCHEMA_ELEMENT
+
+template <>
+struct BankElement<Packed12> {
+    static constexpr uint32_t tid = TID_UINT8;
+    static size_t count(size_t bytes) { return bytes / 3 * 2; }
+};
+
+// Conversion kernels from raw bank bytes (any alignment) to float. The
+// scalar versions are always available and are what the SIMD versions must
+// match bit for bit.
+struct BankConvert {
+    // ---- Scalar ----
+
+    template <typename T>
+    static void scalar(const char* in, size_t count, float* out) {
+        for (size_t i = 0; i < count; ++i) {
+            T value;
+            std::memcpy(&value, in + i * sizeof(T), sizeof(T));
+            out[i] = static_cast<float>(value);
+        }
+    }
+
+    static uint32_t unpack12(const unsigned char* group, size_t second) {
+        uint32_t bits = group[0] | uint32_t(group[1]) << 8 | uint32_t(group[2]) << 16;
+        return second ? bits >> 12 : bits & 0xfff;
+    }
+
+    static void packed12Scalar(const char* in, size_t count, float* out) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(in);
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2, bytes += 3) {
+            out[i] = static_cast<float>(unpack12(bytes, 0));
+            out[i + 1] = static_cast<float>(unpack12(bytes, 1));
+        }
+        if (i < count) {
+            out[i] = static_cast<float>(unpack12(bytes, 0));
+        }
+    }
+
+    // ---- Dispatch ----
+
+    template <typename T>
+    static void toFloat(const char* in, size_t count, float* out) {
+        size_t done = 0;
+#ifdef BANK_SCHEMA_X86
+        if constexpr (std::is_same_v<T, uint16_t> || std::is_same_v<T, int16_t>) {
+            done = hasAvx2() ? int16Avx2(in, count, out, std::is_signed_v<T>)
+                             : int16Sse2(in, count, out, std::is_signed_v<T>);
+        } else if constexpr (std::is_same_v<T, int32_t>) {
+            done = int32Sse2(in, count, out);
+        } else if constexpr (std::is_same_v<T, uint8_t>) {
+            done = uint8Sse2(in, count, out);
+        } else if constexpr (std::is_same_v<T, Packed12>) {
+            done = hasSsse3() ? packed12Ssse3(in, count, out) : 0;
+        }
+#endif
+        if constexpr (std::is_same_v<T, Packed12>) {
+            // Resume on a whole 3-byte group; the SIMD kernels stop on one
+            packed12Scalar(in + done / 2 * 3, count - done, out + done);
+        } else if constexpr (std::is_same_v<T, float>) {
+            std::memcpy(out, in, count * sizeof(float));
+        } else {
+            scalar<T>(in + done * sizeof(T), count - done, out + done);
+        }
+    }
+
+#ifdef BANK_SCHEMA_X86
+    static bool hasAvx2() {
+        static const bool has = __builtin_cpu_supports("avx2");
+        return has;
+    }
+
+    static bool hasSsse3() {
+        static const bool has = __builtin_cpu_supports("ssse3");
+        return has;
+    }
+
+    // Each kernel converts a prefix of whole vectors and returns its length;
+    // the caller finishes the tail with the scalar loop
+
+    __attribute__((target("sse2"))) static size_t int16Sse2(const char* in, size_t count, float* out,
+                                                            bool isSigned) {
+        size_t i = 0;
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+            __m128i lo, hi;
+            if (isSigned) {
+                lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            } else {
+                lo = _mm_unpacklo_epi16(v, zero);
+                hi = _mm_unpackhi_epi16(v, zero);
+            }
+            _mm_storeu_ps(out + i, _mm_cvtepi32_ps(lo));
+            _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(hi));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t int16Avx2(const char* in, size_t count, float* out,
+                                                            bool isSigned) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2 + 16));
+            __m256i wa = isSigned ? _mm256_cvtepi16_epi32(a) : _mm256_cvtepu16_epi32(a);
+            __m256i wb = isSigned ? _mm256_cvtepi16_epi32(b) : _mm256_cvtepu16_epi32(b);
+            _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(wa));
+            _mm256_storeu_ps(out + i + 8, _mm256_cvtepi32_ps(wb));
+        }
+        return i;
+    }
+
+    __attribute__((target("sse2"))) static size_t int32Sse2(const char* in, size_t count, float* out) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4));
+            _mm_storeu_ps(out + i, _mm_cvtepi32_ps(v));
+        }
+        return i;
+    }
+
+    __attribute__((target("sse2"))) static size_t uint8Sse2(const char* in, size_t count, float* out) {
+        size_t i = 0;
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+            _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+            _mm_storeu_ps(out + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+            _mm_storeu_ps(out + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+        }
+        return i;
+    }
+
+    // 8 samples (12 bytes) per step. A shuffle puts bytes 3k..3k+1 and
+    // 3k+1..3k+2 of each group into 16-bit lanes; even lanes keep their low
+    // 12 bits and odd lanes drop their low 4. Loads 16 bytes, so it stops
+    // while 16 remain.
+    __attribute__((target("ssse3"))) static size_t packed12Ssse3(const char* in, size_t count, float* out) {
+        const __m128i spread = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+        const __m128i evenMask = _mm_set1_epi32(0x00000fff);
+        const __m128i zero = _mm_setzero_si128();
+        const size_t bytes = count / 2 * 3;
+        size_t i = 0;
+        for (; i + 8 <= count && i / 2 * 3 + 16 <= bytes; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i / 2 * 3));
+            __m128i lanes = _mm_shuffle_epi8(v, spread);
+            __m128i even = _mm_and_si128(lanes, evenMask);
+            __m128i odd = _mm_slli_epi32(_mm_srli_epi32(lanes, 20), 16);
+            __m128i samples = _mm_or_si128(even, odd);
+            _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(samples, zero)));
+            _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(samples, zero)));
+        }
+        return i;
+    }
+#endif
+};
+
+// One bank's schema: name, element type and channel layout, all known at
+// compile time. Channels is the number of channels interleaved (or stored
+// one after another) in the bank; samples() is per channel.
+template <uint32_t Name, typename Element, size_t Channels = 1, BankLayout Layout = BankLayout::Interleaved>
+struct BankSchema {
+    static_assert(Channels > 0, "a bank has at least one channel");
+
+    static constexpr uint32_t name = Name;
+    static constexpr size_t channels = Channels;
+    static constexpr BankLayout layout = Layout;
+    using element_type = Element;
+
+    // The bank, or an empty span if the event lacks it or it has another TID
+    static BankSpan find(const EventView& event) { return check(event.findBank(Name)); }
+
+    // For spans found another way, e.g. by BankSet
+    static BankSpan check(const BankSpan& bank) {
+        return bank.data != nullptr && bank.type == BankElement<Element>::tid ? bank : BankSpan{};
+    }
+
+    static size_t elements(const BankSpan& bank) { return BankElement<Element>::count(bank.size); }
+    static size_t samples(const BankSpan& bank) { return elements(bank) / Channels; }
+
+    // Every element in stored order; returns how many were written
+    static size_t toFloat(const BankSpan& bank, float* out, size_t capacity) {
+        size_t count = std::min(elements(bank), capacity);
+        if constexpr (std::is_same_v<Element, Packed12>) {
+            count &= ~size_t(1); // Whole groups only, so the kernels stay aligned on them
+        }
+        BankConvert::toFloat<Element>(bank.data, count, out);
+        return count;
+    }
+
+    // One channel's samples; returns how many were written
+    static size_t channelToFloat(const BankSpan& bank, size_t channel, float* out, size_t capacity) {
+        if (channel >= Channels) {
+            return 0;
+        }
+        const size_t count = std::min(samples(bank), capacity);
+        if constexpr (Channels == 1) {
+            return toFloat(bank, out, count);
+        } else if constexpr (Layout == BankLayout::ChannelMajor && !std::is_same_v<Element, Packed12>) {
+            BankConvert::toFloat<Element>(bank.data + channel * samples(bank) * sizeof(Element), count, out);
+            return count;
+        } else {
+            for (size_t s = 0; s < count; ++s) {
+                size_t index = Layout == BankLayout::Interleaved ? s * Channels + channel
+                                                                  : channel * samples(bank) + s;
+                out[s] = element(bank.data, index);
+            }
+            return count;
+        }
+    }
+
+    // Every channel, channel-major: out[c * samples + s]. out must hold
+    // Channels * samples(bank) floats; returns samples per channel.
+    static size_t deinterleave(const BankSpan& bank, float* out) {
+        const size_t perChannel = samples(bank);
+        if constexpr (Layout == BankLayout::ChannelMajor || Channels == 1) {
+            toFloat(bank, out, perChannel * Channels);
+        } else if constexpr (std::is_same_v<Element, Packed12>) {
+            for (size_t c = 0; c < Channels; ++c) {
+                channelToFloat(bank, c, out + c * perChannel, perChannel);
+            }
+        } else {
+            // Convert a block in stored order with the vector kernel, then
+            // scatter it; strided loads straight from the bank do not vectorize
+            constexpr size_t kBlock = 256;
+            float block[kBlock * Channels];
+            for (size_t s = 0; s < perChannel; s += kBlock) {
+                const size_t n = std::min(kBlock, perChannel - s);
+                BankConvert::toFloat<Element>(bank.data + s * Channels * sizeof(Element), n * Channels, block);
+                for (size_t c = 0; c < Channels; ++c) {
+                    float* channelOut = out + c * perChannel + s;
+                    for (size_t i = 0; i < n; ++i) {
+                        channelOut[i] = block[i * Channels + c];
+                    }
+                }
+            }
+        }
+        return perChannel;
+    }
+
+    // A single element by index in stored order
+    static float element(const char* data, size_t index) {
+        if constexpr (std::is_same_v<Element, Packed12>) {
+            return static_cast<float>(
+                BankConvert::unpack12(reinterpret_cast<const unsigned char*>(data) + index / 2 * 3, index & 1));
+        } else {
+            Element value;
+            std::memcpy(&value, data + index * sizeof(Element), sizeof(Element));
+            return static_cast<float>(value);
+        }
+    }
+};
+
+// Several schemas looked up in one walk over an event's banks, each bank
+// name compared as an integer against the schema constants:
+//
+//   BankSet<Adc, Tdc> set(event.view());
+//   const BankSpan& adc = set.get<Adc>();
+template <typename... Schemas>
+class BankSet {
+public:
+    explicit BankSet(const EventView& event) {
+        size_t remaining = sizeof...(Schemas);
+        event.forEachBank([&](const BankSpan& bank) {
+            remaining -= match(bank, std::index_sequence_for<Schemas...>());
+            return remaining > 0;
+        });
+        checkTypes(std::index_sequence_for<Schemas...>());
+    }
+
+    // The schema's bank, empty if absent or of the wrong type
+    template <typename Schema>
+    const BankSpan& get() const {
+        return spans[indexOf<Schema, Schemas...>()];
+    }
+
+private:
+    template <size_t... I>
+    size_t match(const BankSpan& bank, std::index_sequence<I...>) {
+        size_t found = 0;
+        ((bank.name == Schemas::name && spans[I].data == nullptr ? (spans[I] = bank, ++found) : 0), ...);
+        return found;
+    }
+
+    template <size_t... I>
+    void checkTypes(std::index_sequence<I...>) {
+        ((spans[I] = Schemas::check(spans[I])), ...);
+    }
+
+    template <typename Schema, typename First, typename... Rest>
+    static constexpr size_t indexOf() {
+        if constexpr (std::is_same_v<Schema, First>) {
+            return 0;
+        } else {
+            static_assert(sizeof...(Rest) > 0, "schema is not part of this BankSet");
+            return 1 + indexOf<Schema, Rest...>();
+        }
+    }
+
+    BankSpan spans[sizeof...(Schemas)];
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef COLD_STORE_H
+#define COLD_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EventJournal.h"
+#include "EventPool.h"
+#include "TimedEvent.h"
+
+// When events leave the hot ring for the compressed in-memory tier
+struct ColdTierPolicy {
+    std::chrono::milliseconds after{0};    // Age at which events are compressed; 0 disables the tier
+    size_t maxBytes = 256UL * 1024 * 1024; // Compressed plus pending bytes kept before the oldest batch is dropped
+    size_t maxPendingBytes = 64UL * 1024 * 1024; // Raw bytes waiting for the compressor before the oldest are dropped
+    size_t batchEvents = 256;              // Events per compressed batch
+    int compressionLevel = 1;              // zlib level; 1 is fastest
+};
+
+// Compressed in-memory history between the event ring and the journal.
+//
+// The publisher hands over events as they age out of the ring (add(), a
+// pointer move). A background thread packs them in batches of batchEvents,
+// deflates each batch into one block and releases the originals to the pool.
+// Until then they stay readable uncompressed. Queries inflate only the blocks
+// they reach; the most recently inflated block is kept for sequential reads.
+//
+// Blocks beyond maxBytes, or older than maxAge, are dropped oldest first, into
+// the journal if one is given (the cold tier is then the journal's only writer).
+// When events arrive faster than one thread compresses them, the oldest
+// waiting beyond maxPendingBytes are dropped and counted; they cannot go to
+// the journal ahead of the older blocks.
+class ColdStore {
+public:
+    struct Usage {
+        size_t events = 0;           // Compressed and pending
+        size_t compressedBytes = 0;
+        size_t rawBytes = 0;         // Uncompressed size of the compressed events
+        size_t pendingEvents = 0;    // Waiting to be compressed
+        size_t pendingBytes = 0;
+        uint64_t blocks = 0;
+        uint64_t droppedEvents = 0;  // Never compressed: over maxPendingBytes
+        uint64_t droppedBytes = 0;
+    };
+
+    ColdStore(const ColdTierPolicy& policy, std::chrono::milliseconds maxAge, std::shared_ptr<EventPool> pool,
+              EventJournal* overflow);
+    ~ColdStore();
+
+    ColdStore(const ColdStore&) = delete;
+    ColdStore& operator=(const ColdStore&) = delete;
+
+    // Publisher only. Events must arrive in increasing sequence order.
+    void add(std::shared_ptr<TimedEvent> event);
+
+    // Stored sequences are [firstSequence(), endSequence()); equal when empty
+    uint64_t firstSequence() const;
+    uint64_t endSequence() const;
+
+    // First stored sequence with a timestamp after `since`, or endSequence()
+    uint64_t sequenceAfter(std::chrono::system_clock::time_point since) const;
+
+    // Up to maxCount events with sequence in [from, to), oldest first
+    std::vector<std::shared_ptr<TimedEvent>> read(uint64_t from, uint64_t to, size_t maxCount) const;
+
+    Usage usage() const;
+
+private:
+    struct RecordHeader {
+        uint32_t size;
+        uint32_t reserved;
+        uint64_t sequence;
+        int64_t timestampNs;
+    };
+
+    struct Block {
+        uint64_t firstSequence;
+        uint64_t endSequence;
+        int64_t lastTimestampNs;
+        size_t rawBytes;
+        std::vector<unsigned char> compressed;
+    };
+
+    using Inflated = std::shared_ptr<const std::vector<char>>;
+
+    void run();
+    std::shared_ptr<const Block> compress(const std::vector<std::shared_ptr<TimedEvent>>& batch) const;
+    void dropExpired();
+    Inflated inflate(const std::shared_ptr<const Block>& block) const;
+    std::shared_ptr<TimedEvent> materialize(const RecordHeader& header, const char* bytes) const;
+
+    ColdTierPolicy policy;
+    std::chrono::milliseconds maxAge;
+    std::shared_ptr<EventPool> pool;
+    EventJournal* overflow;
+
+    mutable std::mutex mutex; // Guards everything below except the cache
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<TimedEvent>> pending;
+    size_t pendingBytes = 0;
+    size_t compressing = 0;     // Leading pending events the worker has taken
+    uint64_t droppedEvents = 0;
+    uint64_t droppedBytes = 0;
+    bool shedding = false;      // Dropping since pending last fell below half the cap; logged once
+    std::deque<std::shared_ptr<const Block>> blocks;
+    size_t compressedBytes = 0;
+    size_t rawBytes = 0;
+    size_t compressedEvents = 0;
+    uint64_t blockCount = 0;
+    uint64_t nextSequence = 0; // One past the last event added
+    bool stopping = false;
+
+    mutable std::mutex cacheMutex;
+    mutable std::shared_ptr<const Block> cachedBlock;
+    mutable Inflated cachedData;
+
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef EVENT_FILE_WRITER_H
+#define EVENT_FILE_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ReceiverStats.h"
+#include "Subscription.h"
+#include "TimedEvent.h"
+
+// Where and how received events are written to MIDAS files
+struct EventFileOptions {
+    std::string directory = "";  // Empty disables the writer
+    // printf pattern taking the run number and the file's index within the
+    // run, as exactly two int conversions. The suffix picks the compression,
+    // as TMNewWriter does: .gz, .lz4, or none.
+    std::string pattern = "run%05d_%03d.mid.lz4";
+    size_t maxFileBytes = 1024UL * 1024 * 1024; // Raw bytes per file before rotating; 0: one file per run
+    size_t bufferBytes = 8 * 1024 * 1024;       // Each of the two write buffers
+    size_t queueCapacity = 65536;               // Events queued for the writer before the oldest are dropped
+    std::chrono::milliseconds flushInterval{1000}; // A partly filled buffer is written after this long
+};
+
+struct EventFileStats {
+    uint64_t files = 0;          // Files opened
+    std::string currentFile;     // Empty when none is open
+    uint64_t writtenEvents = 0;
+    uint64_t writtenBytes = 0;   // Raw event bytes, before compression
+    uint64_t droppedEvents = 0;  // Lost to a full queue, or with no file name free: the files lack them
+    uint64_t writeErrors = 0;    // Buffers or files that could not be written or named; their events are lost
+    uint64_t bufferWaits = 0;    // Times a full buffer waited for the I/O thread to finish the other
+    LatencySummary writeTime;    // Per buffer handed to the midasio writer, compression included
+    LatencySummary eventToFile;  // From the oldest event in a buffer being stamped to the buffer being written
+};
+
+// Writes the event stream to rotating MIDAS files, off the ingest thread.
+//
+// Events come from a Subscription, so the receiver only queues a pointer;
+// when the disk stalls the queue drops its oldest events (and counts them)
+// instead of stalling ingest. A packing thread copies events back to back
+// into one of two aligned buffers while an I/O thread hands the other, whole,
+// to a midasio writer (TMNewWriter), which compresses and writes it. A buffer
+// is written when it is full, at a file boundary, or after flushInterval.
+//
+// Files rotate when a run starts or stops, and within a run after
+// maxFileBytes. Run transitions are applied by event timestamp, like the
+// aggregates do: events stamped before a run's start still go to the
+// previous run's file. Events after a stop, until the next start, go to a
+// further file of the stopped run. An existing file is never overwritten; the
+// next free index is used instead. Files hold only events, no ODB dumps.
+class EventFileWriter {
+public:
+    explicit EventFileWriter(const EventFileOptions& options);
+    ~EventFileWriter();
+
+    EventFileWriter(const EventFileWriter&) = delete;
+    EventFileWriter& operator=(const EventFileWriter&) = delete;
+
+    // Start writing events from subscription; stop() writes what is queued,
+    // closes the file and waits for both threads. Does nothing unless isValid().
+    void start(std::shared_ptr<Subscription> subscription);
+    void stop();
+    bool isRunning() const { return packer.joinable(); }
+    bool isValid() const { return memory != nullptr; } // Pattern accepted and buffers allocated
+
+    // Ingest thread, at transitions: the file changes before the first
+    // event stamped at or after `at`
+    void beginRun(int runNumber, std::chrono::system_clock::time_point at);
+    void endRun(std::chrono::system_clock::time_point at);
+
+    EventFileStats stats() const;
+
+private:
+    struct Buffer {
+        char* data = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t events = 0;         // Events that end in the buffer
+        std::string path;          // File the bytes belong to
+        bool closeAfter = false;   // The file is complete after this buffer
+        int64_t oldestNs = 0;      // Timestamp of the first event with bytes in the buffer
+    };
+
+    struct PendingRun {
+        bool start;
+        int runNumber;
+        int64_t atNs;
+    };
+
+    static std::unique_ptr<char, decltype(&std::free)> allocate(size_t bytes);
+
+    void packLoop(std::shared_ptr<Subscription> events);
+    void ioLoop();
+    void pack(const TimedEvent& event);
+    void applyPendingRuns(int64_t beforeNs);
+    void closeFile();
+    std::string nextPath();
+    void submit();
+
+    EventFileOptions options;
+
+    std::thread packer;
+    std::thread io;
+    std::atomic<bool> stopping{false};
+
+    // Packing thread only
+    Buffer* filling = nullptr;
+    int runNumber = 0;
+    int fileIndex = 0;
+    std::string path;          // Current file; empty until an event needs one
+    uint64_t fileBytes = 0;    // Raw bytes packed for the current file
+    bool noFile = false;       // No free name; events are skipped until the next transition
+    std::chrono::steady_clock::time_point fillStarted;
+
+    // Both buffers, and the handoff between the threads
+    std::unique_ptr<char, decltype(&std::free)> memory{nullptr, &std::free};
+    Buffer buffers[2];
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Buffer*> toWrite;   // At most one: the other is being filled
+    std::deque<Buffer*> idle;      // Ready for packing
+    bool ioDone = false;           // The packer has submitted its last buffer
+    std::shared_ptr<Subscription> subscription; // Kept after stop() for its counters
+    std::deque<PendingRun> pendingRuns;
+    std::atomic<bool> runsPending{false};
+    std::string openPath;          // File the I/O thread has open
+
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> writtenEvents{0};
+    std::atomic<uint64_t> writtenBytes{0};
+    std::atomic<uint64_t> writeErrors{0};
+    std::atomic<uint64_t> bufferWaits{0};
+    std::atomic<uint64_t> unwrittenEvents{0}; // Skipped for want of a file name
+    LatencyHistogram writeTime;
+    LatencyHistogram eventToFile;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "EventPool.h"
+#include "TimedEvent.h"
+
+// On-disk history behind the in-memory event ring.
+//
+// Events evicted from RAM are appended, in sequence order, to fixed-size
+// segment files that are mmap'd and filled with plain memcpy. Each segment keeps
+// a sparse in-memory index (every kIndexStride-th record's sequence, timestamp
+// and offset), so a lookup by sequence or time touches only the pages holding
+// the records it returns. Once the journal exceeds its byte cap the oldest
+// segment is unmapped and deleted.
+//
+// The journal is a cache for the running process, not an archive: existing
+// segment files in the directory are removed when it opens, and nothing is
+// fsync'd.
+//
+// append() is for a single writer; reads may come from any thread
+// and keep the segments they use mapped until they are done.
+class EventJournal {
+public:
+    EventJournal(const std::string& directory, size_t segmentBytes, size_t maxBytes,
+                 std::shared_ptr<EventPool> pool);
+    ~EventJournal();
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    // False if the directory or a segment could not be created; appends are
+    // then dropped
+    bool isOpen() const { return open.load(std::memory_order_acquire); }
+
+    // Single writer (the event publisher, or the cold tier when one is
+    // configured). Events must arrive in increasing sequence order.
+    void append(const TimedEvent& event);
+    void append(uint64_t sequence, std::chrono::system_clock::time_point timestamp, const void* bytes,
+                size_t size);
+
+    // Stored sequences are [firstSequence(), endSequence()); equal when empty
+    uint64_t firstSequence() const;
+    uint64_t endSequence() const;
+
+    // First stored sequence with a timestamp after `since`, or endSequence()
+    uint64_t sequenceAfter(std::chrono::system_clock::time_point since) const;
+
+    // Copy up to maxCount events with sequence in [from, to) into pooled
+    // TimedEvents, oldest first
+    std::vector<std::shared_ptr<TimedEvent>> read(uint64_t from, uint64_t to, size_t maxCount) const;
+
+    size_t sizeBytes() const { return totalBytes.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kIndexStride = 64;
+
+    struct RecordHeader {
+        uint32_t size;        // Raw event bytes that follow
+        uint32_t reserved;
+        uint64_t sequence;
+        int64_t timestampNs;  // system_clock since epoch
+    };
+
+    struct IndexEntry {
+        uint64_t sequence;
+        int64_t timestampNs;
+        size_t offset;
+    };
+
+    struct Segment;
+
+    std::shared_ptr<Segment> openSegment(uint64_t firstSequence, size_t minBytes);
+    std::vector<std::shared_ptr<Segment>> snapshot() const;
+
+    std::string directory;
+    size_t segmentBytes;
+    size_t maxBytes;
+    std::shared_ptr<EventPool> pool;
+
+    std::atomic<bool> open{false};
+    std::atomic<size_t> totalBytes{0};
+
+    mutable std::mutex mutex; // Guards the segment list, not segment contents
+    std::deque<std::shared_ptr<Segment>> segments;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef EVENT_PIPELINE_H
+#define EVENT_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TimedEvent.h"
+
+// Decouples the MIDAS callback from per-event processing.
+//
+// The ingest thread only stages already-copied events (submit). A pool of
+// decode workers picks them up, builds the shared bank index and runs the
+// registered handlers; events with the same event ID always go to the same
+// worker. Finished events are handed to the publisher strictly in staging
+// order, one at a time, by whichever worker completes the next event in line,
+// so the publisher sees a single ordered stream even though decoding runs in
+// parallel.
+class EventPipeline {
+public:
+    using Handler = std::function<void(const TimedEvent&)>;
+    using Publisher = std::function<void(std::shared_ptr<TimedEvent>&&)>;
+
+    EventPipeline(size_t workers, size_t stagingCapacity, std::vector<Handler> handlers, Publisher publisher);
+    ~EventPipeline();
+
+    EventPipeline(const EventPipeline&) = delete;
+    EventPipeline& operator=(const EventPipeline&) = delete;
+
+    void start();
+
+    // Publish everything already staged, then stop the workers
+    void stop();
+
+    // Ingest thread only. Waits while the staging ring is full.
+    void submit(std::shared_ptr<TimedEvent> event);
+
+    // Run f as the publisher (no publish runs concurrently with it), e.g. to
+    // apply time-based retention from another thread
+    template <typename F>
+    void runExclusive(F&& f);
+
+    size_t workerCount() const { return workers.size(); }
+    uint64_t stagingStalls() const { return stalls.load(std::memory_order_relaxed); }
+    uint64_t publishedCount() const { return published.load(std::memory_order_relaxed); }
+
+    // Ingest thread only: events submitted so far. The publisher is handed
+    // event n (counting from 0) when publishedCount() is n.
+    uint64_t submittedCount() const { return stageSeq; }
+
+private:
+    enum SlotState : uint32_t { Empty, Staged, Done };
+
+    struct Slot {
+        std::shared_ptr<TimedEvent> event;
+        std::atomic<uint32_t> state{Empty};
+    };
+
+    // Single-producer/single-consumer queue of staging sequence numbers
+    struct Worker {
+        std::thread thread;
+        std::vector<uint64_t> queue;
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<bool> sleeping{false};
+    };
+
+    void workerLoop(Worker& worker);
+    void commitReady();
+    bool tryBecomeCommitter() { return !committing.exchange(true, std::memory_order_seq_cst); }
+    void releaseCommitter();
+
+    std::vector<Handler> handlers;
+    Publisher publisher;
+
+    std::vector<Slot> slots;
+    size_t mask;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    uint64_t stageSeq = 0;                // Ingest thread only
+    alignas(64) uint64_t commitSeq = 0;   // Owned by whoever holds `committing`
+    alignas(64) std::atomic<bool> committing{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<uint64_t> published{0};
+};
+
+template <typename F>
+void EventPipeline::runExclusive(F&& f) {
+    while (!tryBecomeCommitter()) {
+        std::this_thread::yield();
+    }
+    f();
+    commitReady();
+    releaseCommitter();
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef EVENT_POOL_H
+#define EVENT_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class EventPool;
+
+// Owning handle to one block from an EventPool. The block goes back to the
+// pool when the handle is destroyed; the pool must outlive the handle.
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    ~PooledBuffer();
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const; // Bytes actually held, i.e. the size-class block size
+    bool empty() const { return data_ == nullptr; }
+
+    // Return the block to the pool now
+    void reset();
+
+private:
+    friend class EventPool;
+    PooledBuffer(EventPool* pool, char* data, size_t size, unsigned sizeClass)
+        : pool_(pool), data_(data), size_(size), sizeClass_(sizeClass) {}
+
+    EventPool* pool_ = nullptr;
+    char* data_ = nullptr;
+    size_t size_ = 0;
+    unsigned sizeClass_ = 0;
+};
+
+// Recycling allocator for event storage.
+//
+// Requests are rounded up to power-of-two size classes from 256 bytes up to
+// the largest event size. Small classes are carved out of 1 MiB slabs that
+// live as long as the pool; large blocks are allocated one by one and kept
+// for reuse until the idle large-block cache reaches maxCachedBytes, after
+// which released blocks are freed. Blocks may be released from any thread.
+class EventPool {
+public:
+    EventPool(size_t maxBlockSize, size_t maxCachedBytes);
+    ~EventPool();
+
+    EventPool(const EventPool&) = delete;
+    EventPool& operator=(const EventPool&) = delete;
+
+    // Block of at least `size` bytes; size() of the handle reports `size`
+    PooledBuffer acquire(size_t size);
+
+    // Untyped interface used by PoolAllocator
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    // Block size that a request of `size` bytes is served from
+    size_t blockSizeFor(size_t size) const;
+
+    size_t reservedBytes() const { return reservedBytes_.load(std::memory_order_relaxed); }
+    size_t cachedBytes() const { return cachedBytes_.load(std::memory_order_relaxed); }
+    uint64_t heapAllocations() const { return heapAllocations_.load(std::memory_order_relaxed); }
+
+private:
+    friend class PooledBuffer;
+
+    struct SizeClass {
+        size_t blockSize = 0;
+        bool fromSlab = false;
+        std::mutex mutex;
+        std::vector<char*> freeBlocks;
+    };
+
+    static constexpr size_t kMinBlockSize = 256;
+    static constexpr size_t kMaxSlabBlockSize = 64 * 1024;
+    static constexpr size_t kSlabSize = 1024 * 1024;
+    static constexpr size_t kAlignment = 64;
+
+    unsigned classFor(size_t size) const;
+    char* take(unsigned sizeClass);
+    void give(unsigned sizeClass, char* block);
+    void refillFromSlab(SizeClass& sc);
+
+    std::vector<std::unique_ptr<SizeClass>> classes_;
+    unsigned oversizeClass_;
+    size_t maxCachedBytes_;
+
+    std::mutex slabMutex_;
+    std::vector<char*> slabs_;
+
+    std::atomic<size_t> reservedBytes_{0};
+    std::atomic<size_t> cachedBytes_{0};
+    std::atomic<size_t> cachedLargeBytes_{0};
+    std::atomic<uint64_t> heapAllocations_{0};
+};
+
+// std::allocator-compatible adaptor so shared_ptr control blocks and the
+// objects they hold come out of the pool too (via std::allocate_shared).
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(std::shared_ptr<EventPool> pool) : pool(std::move(pool)) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { pool->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+
+    std::shared_ptr<EventPool> pool;
+};
+
+#endif
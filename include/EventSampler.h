@@ -0,0 +1,112 @@
+#ifndef EVENT_SAMPLER_H
+#define EVENT_SAMPLER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "midas.h"
+
+#include "TimedEvent.h"
+
+enum class SamplingMode {
+    Prescale,  // Keep the first of every `prescale` events; 0 keeps none
+    RateLimit, // Token bucket: ratePerSecond on average, bursts of up to `burst`
+    Reservoir  // Uniform random sample of up to reservoirSize events per window
+};
+
+// How to thin out one event ID, or every ID without a rule of its own when
+// eventID is EVENTID_ALL. Counters and bucket/reservoir state are kept per
+// event ID, so a catch-all rule limits each ID separately.
+struct SamplingRule {
+    int eventID = EVENTID_ALL;
+    SamplingMode mode = SamplingMode::Prescale;
+    uint32_t prescale = 1;
+    double ratePerSecond = 0;
+    double burst = 1;
+    size_t reservoirSize = 0;
+    std::chrono::milliseconds window{1000};
+};
+
+// Events of one ID seen at ingest and kept by sampling. seen / sampled is the
+// weight that turns rates measured on the sample back into true rates.
+struct SamplingCount {
+    uint16_t eventId = 0;
+    uint64_t seen = 0;
+    uint64_t sampled = 0;
+};
+
+// Receiver-side sampling, decided from the event ID alone before the event is
+// copied, so a dropped event costs a table lookup and a counter update.
+//
+// Reservoir rules hold their sample until the window closes: admit() hands
+// out the slot to copy the event into, and closed windows are collected with
+// takeReady() in arrival order. Everything except counts() belongs to the
+// ingest thread.
+class EventSampler {
+public:
+    enum class Decision {
+        Drop,
+        Keep,
+        Hold // Copy the event into the returned slot, replacing what is there
+    };
+
+    explicit EventSampler(const std::vector<SamplingRule>& rules);
+
+    Decision admit(uint16_t eventId, std::shared_ptr<TimedEvent>*& slot);
+
+    // Move reservoirs whose window ended by `now` (all of them if `all`) to
+    // the ready list
+    void closeWindows(std::chrono::steady_clock::time_point now, bool all = false);
+
+    bool hasReady() const { return !ready.empty(); }
+    void takeReady(std::vector<std::shared_ptr<TimedEvent>>& out);
+
+    // Any thread
+    std::vector<SamplingCount> counts() const;
+    uint64_t totalSeen() const;
+    uint64_t totalSampled() const;
+
+private:
+    struct State {
+        uint16_t eventId = 0;
+        const SamplingRule* rule = nullptr; // Null: keep everything
+
+        uint64_t counter = 0; // Prescale
+
+        double tokens = 0; // RateLimit
+        std::chrono::steady_clock::time_point refilled;
+
+        std::chrono::steady_clock::time_point windowEnd; // Reservoir
+        uint64_t windowSeen = 0;
+        std::vector<std::shared_ptr<TimedEvent>> reservoir;
+        std::vector<uint64_t> arrival; // windowSeen of each reservoir entry
+
+        std::atomic<uint64_t> seen{0};
+        std::atomic<uint64_t> sampled{0};
+    };
+
+    State& stateFor(uint16_t eventId);
+    void closeWindow(State& state, std::chrono::steady_clock::time_point now);
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    uint64_t random();
+
+    std::vector<SamplingRule> rules;
+    const SamplingRule* defaultRule = nullptr;
+
+    std::vector<uint32_t> slots; // Indexed by event ID: index into states plus one, 0 if not seen yet
+    mutable std::mutex mutex;    // Guards the shape of states; the counters are atomic
+    std::deque<State> states;
+    std::vector<State*> reservoirStates;
+    std::vector<std::shared_ptr<TimedEvent>> ready;
+
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+};
+
+#endif
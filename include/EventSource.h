@@ -0,0 +1,59 @@
+#ifndef EVENT_SOURCE_H
+#define EVENT_SOURCE_H
+
+#include <cstddef>
+#include <string>
+
+#include "midas.h"
+
+// Receives what an EventSource delivers. Every call comes from the source's
+// own ingest thread, one at a time.
+class EventSink {
+public:
+    virtual ~EventSink() = default;
+
+    // The header is followed by data_size payload bytes, valid until return
+    virtual void deliverEvent(const EVENT_HEADER* header) = 0;
+
+    // Several events at once, in order, for sources that read in batches.
+    // A sink may publish them together; by default they go one at a time.
+    virtual void deliverEvents(const EVENT_HEADER* const* headers, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            deliverEvent(headers[i]);
+        }
+    }
+
+    // A MIDAS message: header->trigger_mask holds its MT_* type and the
+    // text (up to data_size bytes, not always NUL-terminated) follows it
+    virtual void deliverMessage(const EVENT_HEADER* header, const char* message) = 0;
+    virtual INT deliverTransition(INT transition, INT runNumber, char* error) = 0;
+
+    // Called between deliveries, at least every few hundred ms while the
+    // source runs, with its latest status (e.g. the cm_yield result)
+    virtual void sourceIdle(INT status) = 0;
+
+    // Nothing more will be delivered: open failed, connection lost or the
+    // input ended. stop() must still be called.
+    virtual void sourceStopped(INT status) = 0;
+};
+
+// Where a MidasReceiver's events come from. The receiver starts the source
+// in start() and stops it in stop(); see MidasBufferSource for a live buffer
+// and FileReplaySource for recorded runs.
+class EventSource {
+public:
+    virtual ~EventSource() = default;
+
+    // Begin delivering to the sink. Returns SUCCESS, or the failure status if
+    // the source cannot start at all; later failures go to sourceStopped().
+    virtual INT start(EventSink& sink) = 0;
+
+    // Blocks until no further call reaches the sink. May be called from
+    // inside a sink callback.
+    virtual void stop() = 0;
+
+    // For log messages and stats, e.g. the buffer or file name
+    virtual std::string describe() const = 0;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef EVENT_VIEW_H
+#define EVENT_VIEW_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midas.h"
+
+// Pack a four-character bank name into the integer used for comparisons,
+// e.g. bankName("ADC0"). Matches the in-memory byte order of BANK::name.
+constexpr uint32_t bankName(const char (&name)[5]) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(name[0])) |
+           static_cast<uint32_t>(static_cast<unsigned char>(name[1])) << 8 |
+           static_cast<uint32_t>(static_cast<unsigned char>(name[2])) << 16 |
+           static_cast<uint32_t>(static_cast<unsigned char>(name[3])) << 24;
+}
+
+// One bank inside a stored event. `data` points into the event's own bytes,
+// so a span is only valid while the event it came from is alive.
+struct BankSpan {
+    uint32_t name = 0;  // Packed name, see bankName()
+    uint32_t type = 0;  // TID_xxx
+    const char* data = nullptr;
+    size_t size = 0;
+
+    std::string nameString() const { return std::string(reinterpret_cast<const char*>(&name), 4); }
+
+    template <typename T>
+    const T* as() const { return reinterpret_cast<const T*>(data); }
+
+    template <typename T>
+    size_t count() const { return size / sizeof(T); }
+};
+
+// Locations of every bank in one event, in event order
+struct BankIndex {
+    std::vector<BankSpan> banks;
+
+    const BankSpan* find(uint32_t name) const {
+        for (const auto& bank : banks) {
+            if (bank.name == name) {
+                return &bank;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Lazily built BankIndex shared by every reader of one stored event.
+// The first reader that needs the full list builds it; later readers reuse it.
+class BankIndexSlot {
+public:
+    BankIndexSlot() = default;
+    ~BankIndexSlot() { delete index_.load(std::memory_order_relaxed); }
+
+    BankIndexSlot(const BankIndexSlot&) = delete;
+    BankIndexSlot& operator=(const BankIndexSlot&) = delete;
+
+    const BankIndex* get() const { return index_.load(std::memory_order_acquire); }
+    const BankIndex* getOrBuild(const char* event, size_t size) const;
+
+private:
+    mutable std::atomic<BankIndex*> index_{nullptr};
+};
+
+// Read-only view of one raw MIDAS event (EVENT_HEADER followed by payload).
+//
+// Nothing is copied: header fields are decoded from the bytes on each call
+// and bank payloads come back as spans into the same bytes. findBank() walks
+// only as far as the requested bank unless a bank index has already been
+// built; banks() builds the index once and caches it.
+class EventView {
+public:
+    EventView() = default;
+    EventView(const char* bytes, size_t size, const BankIndexSlot* slot = nullptr)
+        : bytes_(bytes), size_(size), slot_(slot) {}
+
+    bool valid() const { return bytes_ != nullptr && size_ >= sizeof(EVENT_HEADER); }
+
+    // Header fields
+    uint16_t eventId() const { return field<uint16_t>(offsetof(EVENT_HEADER, event_id)); }
+    uint16_t triggerMask() const { return field<uint16_t>(offsetof(EVENT_HEADER, trigger_mask)); }
+    uint32_t serialNumber() const { return field<uint32_t>(offsetof(EVENT_HEADER, serial_number)); }
+    uint32_t timeStamp() const { return field<uint32_t>(offsetof(EVENT_HEADER, time_stamp)); }
+    uint32_t dataSize() const { return field<uint32_t>(offsetof(EVENT_HEADER, data_size)); }
+
+    // Whole event and payload bytes
+    const char* data() const { return bytes_; }
+    size_t size() const { return size_; }
+    const char* payload() const { return bytes_ + sizeof(EVENT_HEADER); }
+    size_t payloadSize() const { return valid() ? size_ - sizeof(EVENT_HEADER) : 0; }
+
+    // True if the payload starts with a valid MIDAS bank header
+    bool hasBanks() const;
+    uint32_t bankFlags() const;
+
+    // Bank lookup by packed name (see bankName()) or four-character string.
+    // Returns an empty span if the bank is not present.
+    BankSpan findBank(uint32_t name) const;
+    BankSpan findBank(const char* name) const;
+
+    // Every bank in the event; built on first use and cached
+    const std::vector<BankSpan>& banks() const;
+
+    // Walk banks in order until f(bank) returns false; no caching, no allocation
+    template <typename F>
+    void forEachBank(F&& f) const;
+
+private:
+    template <typename T>
+    T field(size_t offset) const {
+        T value{};
+        if (valid()) {
+            std::memcpy(&value, bytes_ + offset, sizeof(T));
+        }
+        return value;
+    }
+
+    // Decode the bank at payload offset `pos`; returns the offset of the next one
+    // or 0 when there are no more banks
+    size_t readBank(size_t pos, BankSpan& bank) const;
+    size_t firstBankOffset() const;
+
+    const char* bytes_ = nullptr;
+    size_t size_ = 0;
+    const BankIndexSlot* slot_ = nullptr;
+    mutable std::shared_ptr<BankIndex> ownIndex_; // Used when there is no shared slot
+};
+
+template <typename F>
+void EventView::forEachBank(F&& f) const {
+    if (const BankIndex* index = slot_ != nullptr ? slot_->get() : ownIndex_.get()) {
+        for (const auto& bank : index->banks) {
+            if (!f(bank)) {
+                return;
+            }
+        }
+        return;
+    }
+
+    BankSpan bank;
+    for (size_t pos = firstBankOffset(); pos != 0;) {
+        pos = readBank(pos, bank);
+        if (bank.data == nullptr || !f(bank)) {
+            return;
+        }
+    }
+}
+
+#endif
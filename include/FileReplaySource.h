@@ -0,0 +1,82 @@
+#ifndef FILE_REPLAY_SOURCE_H
+#define FILE_REPLAY_SOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midas.h"
+#include "midasio.h"
+
+#include "EventSource.h"
+
+enum class ReplayPacing {
+    RealTime, // Recorded spacing, from the event header time stamps
+    Scaled,   // Recorded spacing divided by FileReplayConfig::speed
+    MaxSpeed, // As fast as the receiver takes them
+};
+
+struct FileReplayConfig {
+    std::vector<std::string> files; // Anything TMNewReader opens: .mid, .mid.gz, .mid.lz4, ...
+    ReplayPacing pacing = ReplayPacing::MaxSpeed;
+    double speed = 1.0;             // Scaled only; 10 replays ten times faster than recorded
+    bool loop = false;              // Start over after the last file until stopped
+    bool transitions = true;        // Deliver begin/end-of-run records as TR_START/TR_STOP
+    std::chrono::milliseconds idleInterval{100}; // How often the sink's periodic work runs
+};
+
+// Replays recorded MIDAS files through the midasio reader, so a receiver and
+// everything behind it can run at a controlled rate without an experiment.
+//
+// Events are read into one reused buffer on the source's own thread and
+// delivered in file order. Begin- and end-of-run records become TR_START and
+// TR_STOP transitions (their serial number is the run number); messages
+// stored in the file are delivered as messages.
+//
+// Pacing follows the header time stamps, which have one-second resolution:
+// events recorded within the same second are released together. Each file
+// starts its own clock, so gaps between runs are not replayed. When looping,
+// serial numbers repeat on every pass; files that begin with a run start
+// record keep the loss counters clean, as each pass then counts as a new run.
+class FileReplaySource : public EventSource {
+public:
+    explicit FileReplaySource(const FileReplayConfig& config);
+    ~FileReplaySource() override;
+
+    FileReplaySource(const FileReplaySource&) = delete;
+    FileReplaySource& operator=(const FileReplaySource&) = delete;
+
+    INT start(EventSink& sink) override;
+    void stop() override;
+    std::string describe() const override;
+
+    uint64_t replayedEvents() const { return replayed.load(std::memory_order_relaxed); }
+    uint64_t completedPasses() const { return passes.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    INT replayFile(const std::string& path);
+    bool waitUntil(std::chrono::steady_clock::time_point target);
+    void idleIfDue(std::chrono::steady_clock::time_point now);
+
+    FileReplayConfig config;
+    EventSink* sink = nullptr;
+
+    // Replay thread only
+    std::vector<uint64_t> buffer; // 8-byte aligned event storage, reused
+    std::chrono::steady_clock::time_point lastIdle;
+
+    std::mutex mutex; // Only for interruptible waits
+    std::condition_variable cv;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> replayed{0};
+    std::atomic<uint64_t> passes{0};
+    std::thread worker;
+};
+
+#endif
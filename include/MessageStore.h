@@ -0,0 +1,115 @@
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "midas.h"
+
+#include "EventPool.h"
+#include "SequencedRing.h"
+
+enum class MessageSeverity {
+    Debug, // MT_DEBUG
+    Info,  // MT_INFO, MT_USER, MT_LOG, MT_TALK, MT_CALL
+    Error  // MT_ERROR
+};
+
+// One MIDAS message, parsed at ingest. Facility and text live in a pooled
+// arena chunk shared with neighbouring messages, so copying a message only
+// bumps a reference count, and the views stay valid as long as the copy.
+struct TimedMessage {
+    std::chrono::system_clock::time_point timestamp;
+    uint64_t sequence = 0;
+    INT type = 0; // MT_ERROR, MT_INFO, ...
+    MessageSeverity severity = MessageSeverity::Info;
+    uint32_t facilityLength = 0;
+    uint32_t textLength = 0;
+    std::shared_ptr<const char> storage; // Facility followed by text
+
+    // The sender named in the leading "[client,TYPE]" tag; empty without one
+    std::string_view facility() const { return {storage.get(), facilityLength}; }
+    std::string_view text() const { return {storage.get() + facilityLength, textLength}; }
+};
+
+// Selects messages for MessageStore::find(); a field left at its default matches everything
+struct MessageFilter {
+    INT types = 0;                                  // Mask of MT_* bits; 0 matches every type
+    std::string facility;                           // Exact facility name
+    std::chrono::system_clock::time_point since{};  // Only messages newer than this
+    size_t maxCount = SIZE_MAX;                     // Newest ones kept
+};
+
+// Message history: a SequencedRing of parsed messages plus per-type and
+// per-facility index rings of (sequence, timestamp), so a filtered query
+// binary-searches one small index and reads only the messages it names.
+//
+// add() belongs to the ingest thread and, once the arena and rings are warm,
+// does not touch the heap. Queries may come from any thread.
+class MessageStore {
+public:
+    static constexpr size_t kMaxFacilities = 32; // Later facilities are found by scanning
+    static constexpr size_t kChunkBytes = 64 * 1024;
+
+    MessageStore(size_t capacity, std::shared_ptr<EventPool> pool);
+
+    MessageStore(const MessageStore&) = delete;
+    MessageStore& operator=(const MessageStore&) = delete;
+
+    // Parse and store one message; raw need not be NUL-terminated
+    uint64_t add(INT type, const char* raw, size_t length, std::chrono::system_clock::time_point timestamp);
+
+    std::vector<TimedMessage> find(const MessageFilter& filter) const;
+
+    SequencedRing<TimedMessage>& ring() { return messages; }
+    const SequencedRing<TimedMessage>& ring() const { return messages; }
+
+    // Split "[client,TYPE] text" into facility and text; type is taken from
+    // the tag when the buffer manager did not supply one
+    static void parse(const char* raw, size_t length, INT& type, std::string_view& facility,
+                      std::string_view& text);
+
+private:
+    struct IndexEntry {
+        uint64_t sequence = 0;
+        std::chrono::system_clock::time_point timestamp;
+    };
+    using Index = SequencedRing<IndexEntry>;
+
+    struct Facility {
+        std::string name;
+        std::unique_ptr<Index> index;
+    };
+
+    struct Chunk {
+        PooledBuffer block;
+    };
+
+    static constexpr size_t kTypeCount = 7; // MT_ERROR .. MT_CALL
+
+    std::shared_ptr<const char> store(std::string_view facility, std::string_view text);
+    const Facility* findFacility(std::string_view name) const;
+    void collect(const Index& index, const MessageFilter& filter, std::vector<TimedMessage>& out) const;
+
+    size_t capacity;
+    std::shared_ptr<EventPool> pool;
+    SequencedRing<TimedMessage> messages;
+    std::array<std::unique_ptr<Index>, kTypeCount> typeIndex;
+
+    // Registered by the ingest thread; readers see the first facilityCount
+    std::array<Facility, kMaxFacilities> facilities;
+    std::atomic<size_t> facilityCount{0};
+
+    // Arena: messages are copied back to back into the current chunk, which
+    // returns to the pool once its last message is evicted and unread
+    std::shared_ptr<Chunk> chunk;
+    size_t chunkUsed = 0;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef MIDAS_BUFFER_SOURCE_H
+#define MIDAS_BUFFER_SOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midas.h"
+
+#include "EventSource.h"
+#include "MidasConnection.h"
+
+struct TransitionRegistration {
+    int transition;
+    int sequence;
+};
+
+// How a MidasBufferSource takes events off its buffer
+struct BufferReadOptions {
+    size_t cacheBytes = 100000; // bm_set_cache_size read cache; larger means fewer buffer locks
+    // Pull mode drains the buffer with bm_receive_event into preallocated
+    // storage and delivers whole batches, instead of one callback per event
+    bool pull = false;
+    size_t batchEvents = 1024;             // Pull: most events per batch
+    size_t batchBytes = 4 * 1024 * 1024;   // Pull: batch fill limit (one maximum-size event may exceed it)
+    std::chrono::milliseconds maxPollInterval{50}; // Pull: longest wait between drains when idle
+};
+
+// Events, messages and transitions from one buffer of a live experiment.
+//
+// All MIDAS calls happen on the shared MidasConnection's yield thread, which
+// is also the thread the sink is called on.
+//
+// In pull mode the source drains the buffer after every cm_yield and asks
+// the connection for the next yield timeout: short enough that, at the rate
+// seen recently, about half a batch accumulates in between, and never more
+// than maxPollInterval. A drain that fills its batch asks for an immediate
+// return.
+class MidasBufferSource : public EventSource {
+public:
+    // Counters for comparing callback and pull mode; any thread may read them
+    struct ReadStats {
+        uint64_t receiveCalls = 0; // bm_receive_event calls, including empty ones
+        uint64_t batches = 0;      // Pull deliveries to the sink
+        uint64_t events = 0;
+        uint64_t truncated = 0;    // Events larger than the batch storage, dropped
+    };
+
+    MidasBufferSource(const std::string& host, const std::string& experiment, const std::string& clientName,
+                      const std::string& bufferName, int eventID, bool getAllEvents, int yieldTimeoutMs,
+                      const std::vector<TransitionRegistration>& transitionRegistrations,
+                      const BufferReadOptions& readOptions = BufferReadOptions());
+    ~MidasBufferSource() override;
+
+    INT start(EventSink& sink) override;
+    void stop() override;
+    std::string describe() const override { return bufferName; }
+
+    ReadStats readStats() const;
+
+private:
+    // MidasConnection drives everything below from its yield thread
+    friend class MidasConnection;
+
+    INT  openBuffer(EVENT_HANDLER* callback);
+    void closeBuffer();
+    int  afterYield(INT yieldStatus); // Returns the timeout this source wants for the next cm_yield
+    int  drain();
+    void connectionFailed(INT connectStatus);
+    void processEvent(HNDLE, HNDLE, EVENT_HEADER*, void*);
+    void processMessage(HNDLE, HNDLE, EVENT_HEADER*, void*);
+    INT  processTransition(INT transition, INT runNumber, char* error);
+
+    std::string hostName, exptName, clientName, bufferName;
+    int eventID;
+    bool getAllEvents;
+    int yieldTimeout;
+    std::vector<TransitionRegistration> transitionRegistrations_;
+
+    BufferReadOptions readOptions;
+
+    HNDLE hBufEvent = 0;
+    INT requestID = -1;
+
+    // Pull mode, yield thread only
+    std::vector<uint64_t> batchStorage; // 8-byte aligned
+    std::vector<const EVENT_HEADER*> batchHeaders;
+    std::chrono::steady_clock::time_point lastDrain;
+    double drainRate = 0; // Events per second, smoothed
+
+    std::atomic<uint64_t> receiveCalls{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> pulledEvents{0};
+    std::atomic<uint64_t> truncatedEvents{0};
+
+    EventSink* sink = nullptr;
+    std::shared_ptr<MidasConnection> connection;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef MIDAS_CONNECTION_H
+#define MIDAS_CONNECTION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "midas.h"
+
+class MidasBufferSource;
+
+// The process-wide experiment connection shared by every MidasBufferSource.
+//
+// MIDAS allows one cm_connect_experiment() per process and delivers buffer,
+// message and transition callbacks from inside cm_yield(). The connection owns
+// the thread that connects and yields; every MIDAS call made for a source
+// (opening its buffer, requesting events, closing it) is queued to that
+// thread. The static callbacks route events to sources by request ID and
+// fan messages and transitions out to every attached source.
+//
+// The connection lives as long as some source holds it and disconnects when
+// the last one lets go.
+class MidasConnection {
+public:
+    // The existing connection, or a new one. Returns nullptr (and logs) if the
+    // process is already connected to a different host or experiment.
+    static std::shared_ptr<MidasConnection> acquire(const std::string& host, const std::string& experiment,
+                                                    const std::string& clientName, int yieldTimeoutMs);
+
+    ~MidasConnection();
+
+    MidasConnection(const MidasConnection&) = delete;
+    MidasConnection& operator=(const MidasConnection&) = delete;
+
+    // Open the source's buffer on the yield thread once connected. Does not
+    // wait; failures are reported to the source's sink.
+    void attach(MidasBufferSource* source);
+
+    // Close the source's buffer. Blocks until done, after which no callback
+    // reaches the source.
+    void detach(MidasBufferSource* source);
+
+    // CM_SUCCESS once connected, the failure status if connecting failed
+    INT getStatus() const { return status.load(); }
+
+private:
+    MidasConnection(const std::string& host, const std::string& experiment, const std::string& clientName,
+                    int yieldTimeoutMs);
+
+    void run();
+    void post(std::function<void()> task);
+    bool runPendingTasks();
+
+    // Yield thread only
+    void registerTransitions(MidasBufferSource* source);
+
+    static void processEventCallback(HNDLE, HNDLE, EVENT_HEADER*, void*);
+    static void processMessageCallback(HNDLE, HNDLE, EVENT_HEADER*, void*);
+    template <INT Transition>
+    static INT processTransitionCallback(INT, char*);
+    static INT (*transitionCallbackFor(INT transition))(INT, char*);
+
+    std::string hostName, exptName, clientName;
+    int yieldTimeout;
+
+    // Work queued for the yield thread
+    std::mutex taskMutex;
+    std::condition_variable taskCV;
+    std::deque<std::function<void()>> tasks;
+
+    // Yield thread only
+    std::vector<MidasBufferSource*> sources;
+    std::unordered_map<INT, MidasBufferSource*> sourcesByRequest;
+    std::set<INT> registeredTransitions;
+
+    std::thread yieldThread;
+    std::atomic<bool> running{true};
+    std::atomic<INT> status{0};
+    std::atomic<bool> connected{false};
+
+    // Where the static callbacks find the connection; only one can exist
+    static MidasConnection* active;
+    static std::mutex instanceMutex;
+    static std::weak_ptr<MidasConnection> instance;
+};
+
+#endif
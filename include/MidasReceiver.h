@@ -3,19 +3,43 @@
 
 #include <thread>
 #include <atomic>
-#include <deque>
 #include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <string>
 #include <chrono>
+#include <cstdint>
 #include <memory>
+#include <functional>
 #include "midas.h"
 #include "midasio.h"
 
-struct TransitionRegistration {
-    int transition;
-    int sequence;
+#include "Aggregates.h"
+#include "ColdStore.h"
+#include "EventFileWriter.h"
+#include "EventJournal.h"
+#include "EventPipeline.h"
+#include "EventSampler.h"
+#include "EventSource.h"
+#include "MessageStore.h"
+#include "MidasBufferSource.h"
+#include "OdbCache.h"
+#include "ReceiverStats.h"
+#include "SerialGapTracker.h"
+#include "RingNotifier.h"
+#include "RunSegments.h"
+#include "SequencedRing.h"
+#include "ShmRingWriter.h"
+#include "Subscription.h"
+#include "TimedEvent.h"
+
+// Limits on the in-memory event history. An event is evicted as soon as any
+// one of them is exceeded; a zero disables that limit.
+struct RetentionPolicy {
+    size_t maxEvents = 0;                    // 0: use maxBufferSize
+    size_t maxBytes = 1024UL * 1024 * 1024;  // Resident bytes, counted per pooled block
+    std::chrono::milliseconds maxAge{0};
 };
 
 struct MidasReceiverConfig {
@@ -26,7 +50,40 @@ struct MidasReceiverConfig {
     int eventID = EVENTID_ALL;
     bool getAllEvents = true;
     size_t maxBufferSize = 1000;
+    size_t eventPoolCacheBytes = 64 * 1024 * 1024; // Idle large event blocks kept for reuse
+    RetentionPolicy eventRetention;
+    // Events partitioned by run, and when finished runs leave memory
+    RunRetentionPolicy runRetention;
+    // 0: decode and publish on the source's ingest thread. Events are split
+    // by event_id % decodeWorkers, so at most one worker per distinct ID is busy.
+    size_t decodeWorkers = 0;
+    size_t stagingCapacity = 4096; // Events staged for the decode workers before ingest waits
+    std::chrono::seconds serialReportInterval{10}; // At most one lost-event summary per interval
+    // Receiver-side sampling for monitoring; empty keeps every event. The
+    // first rule naming an event ID applies to it, else the EVENTID_ALL rule.
+    std::vector<SamplingRule> sampling;
+    // Optional compressed in-memory history for events older than coldTier.after
+    ColdTierPolicy coldTier;
+    // Optional on-disk history for events evicted from memory; empty disables it
+    std::string journalDirectory = "";
+    size_t journalSegmentBytes = 64UL * 1024 * 1024;
+    size_t journalMaxBytes = 4UL * 1024 * 1024 * 1024;
+    // Optional POSIX shared-memory ring ("/midas_events") that every stored
+    // event is also written to, for local ShmRingReader processes; empty
+    // disables it
+    std::string shmRingName = "";
+    size_t shmRingBytes = 64UL * 1024 * 1024;
     int cmYieldTimeout = 300;
+    // ODB subtrees getOdb() keeps in memory while a MIDAS buffer is received,
+    // dropped when an ODB watch reports a change; 0 disables the cache
+    size_t odbCacheEntries = 64;
+    BufferReadOptions bufferRead; // Cache size and pull-mode batching for the MIDAS buffer
+    // Histograms, windowed sums and rates kept up to date off the ingest
+    // thread; more can be added with addHistogram() and friends
+    AggregateOptions aggregates;
+    // Optional MIDAS files of every stored event, one or more per run,
+    // written off the ingest thread; an empty directory disables them
+    EventFileOptions fileWriter;
     std::vector<TransitionRegistration> transitionRegistrations {
         {TR_START, 100},
         {TR_STOP, 900},
@@ -34,32 +91,89 @@ struct MidasReceiverConfig {
         {TR_RESUME, 100},
         {TR_STARTABORT, 500}
     };
+    // Where events come from; null means the MIDAS buffer configured above.
+    // Set to a FileReplaySource to run without a live experiment.
+    std::shared_ptr<EventSource> eventSource;
 };
 
-class MidasReceiver {
+// Receives one MIDAS buffer into its own event, message and transition stores.
+// Any number of receivers can exist in one process, one per buffer; they
+// share a single experiment connection (see MidasConnection). The events can
+// also come from any other EventSource.
+class MidasReceiver : private EventSink {
 public:
-    struct TimedEvent {
-        std::chrono::system_clock::time_point timestamp;
-        std::shared_ptr<TMEvent> event;
-    };
+    // Every stored record carries the sequence number the ring assigned to it.
+    // Sequence numbers are per record type, start at 0 and never repeat.
+    using TimedEvent = ::TimedEvent;
 
-    struct TimedMessage {
-        std::chrono::system_clock::time_point timestamp;
-        void* message;
+    // Event store accounting. Resident figures describe what is in the buffer
+    // right now; residentBytes also counts evicted events whose storage a
+    // reader inside the ring may still be looking at. Received/evicted totals
+    // only grow.
+    struct BufferUsage {
+        size_t residentEvents = 0;
+        size_t residentBytes = 0;
+        uint64_t receivedEvents = 0;
+        uint64_t receivedBytes = 0;
+        uint64_t evictedEvents = 0;
+        uint64_t evictedBytes = 0;
+        uint64_t coldEvents = 0;     // Evicted events held in the compressed tier
+        size_t coldCompressedBytes = 0;
+        size_t coldRawBytes = 0;     // Their size before compression
+        uint64_t coldDroppedEvents = 0; // Lost because the compressor fell behind
+        uint64_t journalEvents = 0;  // Evicted events still readable from disk
+        size_t journalBytes = 0;     // Disk space held by the journal
     };
 
+    // Parsed at ingest; see MessageStore
+    using TimedMessage = ::TimedMessage;
+
     struct TimedTransition {
         std::chrono::system_clock::time_point timestamp;
+        uint64_t sequence;
+        INT transition; // TR_START, TR_STOP, ...
         INT run_number;
         char error[256];
     };
 
+    // Zero-copy views of the in-memory rings (see SequencedRing::Snapshot)
+    using EventSnapshot = SequencedRing<std::shared_ptr<TimedEvent>>::Snapshot;
+    using MessageSnapshot = SequencedRing<TimedMessage>::Snapshot;
+    using TransitionSnapshot = SequencedRing<TimedTransition>::Snapshot;
+
+    // Result of a cursor read: the records, the cursor to pass to the next
+    // call, and how many records were evicted before the caller got to them.
+    template <typename T>
+    struct Batch {
+        std::vector<T> records;
+        uint64_t nextCursor = 0;
+        uint64_t missed = 0;
+    };
+
+    // Per-event processing. Runs on a decode worker when decodeWorkers > 0,
+    // otherwise on the callback thread, before the event becomes readable.
+    using EventHandler = std::function<void(const TimedEvent&)>;
+
+    // The process-wide default receiver, configured with init()
     static MidasReceiver& getInstance();
 
+    // An independent receiver, e.g. for a second buffer next to the default one
+    explicit MidasReceiver(const MidasReceiverConfig& config);
+    ~MidasReceiver() override;
+
+    MidasReceiver(const MidasReceiver&) = delete;
+    MidasReceiver& operator=(const MidasReceiver&) = delete;
+
     void init(const MidasReceiverConfig& config, bool fromDefault = false);
     void start();
     void stop();
 
+    // Register before start(); handlers may run concurrently for different event IDs
+    void addEventHandler(EventHandler handler);
+
+    // Event queries. With a cold tier or journal configured, getLatestEvents()
+    // and the cursor reads continue into evicted events, so they can return
+    // more than the event buffer holds; getWholeBuffer() stays in the buffer.
     std::vector<std::shared_ptr<TimedEvent>> getWholeBuffer();
     std::vector<std::shared_ptr<TimedEvent>> getLatestEvents(size_t n);
     std::vector<std::shared_ptr<TimedEvent>> getLatestEvents(std::chrono::system_clock::time_point since);
@@ -70,12 +184,116 @@ public:
     std::vector<TimedMessage> getLatestMessages(std::chrono::system_clock::time_point since);
     std::vector<TimedMessage> getLatestMessages(size_t n, std::chrono::system_clock::time_point since);
 
+    // Messages by type mask, facility and age, e.g. every MT_ERROR of the
+    // last ten minutes; served from small per-type and per-facility indexes
+    std::vector<TimedMessage> findMessages(const MessageFilter& filter) const;
+
     std::vector<TimedTransition> getTransitionBuffer();
     std::vector<TimedTransition> getLatestTransitions(size_t n);
     std::vector<TimedTransition> getLatestTransitions(std::chrono::system_clock::time_point since);
     std::vector<TimedTransition> getLatestTransitions(size_t n, std::chrono::system_clock::time_point since);
 
-    std::string getOdb(const std::string& path = "/");
+    // Snapshot reads: iterate the records in place with range-for or
+    // forEach(). Nothing is allocated or reference-counted and the producer
+    // never waits, but evicted records are not recycled while a snapshot is
+    // open, so drop it after each poll. Cover the event buffer only, not the
+    // cold tier or journal. A cursor of 0 starts at the oldest stored record.
+    EventSnapshot snapshotEvents(uint64_t cursor = 0) const;
+    EventSnapshot snapshotLatestEvents(size_t n) const;
+    EventSnapshot snapshotEventsSince(std::chrono::system_clock::time_point since) const;
+    MessageSnapshot snapshotMessages(uint64_t cursor = 0) const;
+    MessageSnapshot snapshotMessagesSince(std::chrono::system_clock::time_point since) const;
+    TransitionSnapshot snapshotTransitions(uint64_t cursor = 0) const;
+    TransitionSnapshot snapshotTransitionsSince(std::chrono::system_clock::time_point since) const;
+
+    // Cursor reads: return up to maxCount records with sequence >= cursor in O(k).
+    // A cursor of 0 starts at the oldest stored record; get*Cursor() returns
+    // the cursor of the next record to arrive.
+    Batch<std::shared_ptr<TimedEvent>> readEventsFrom(uint64_t cursor, size_t maxCount);
+    Batch<TimedMessage> readMessagesFrom(uint64_t cursor, size_t maxCount);
+    Batch<TimedTransition> readTransitionsFrom(uint64_t cursor, size_t maxCount);
+
+    // Blocking cursor reads: wait until at least minCount records past cursor
+    // exist or the timeout expires, then read up to maxCount of them. Return
+    // early (possibly empty) once the receiver is stopped or its source has
+    // finished, including for calls made after that point.
+    Batch<std::shared_ptr<TimedEvent>> waitForEvents(uint64_t cursor, size_t minCount,
+                                                     std::chrono::milliseconds timeout,
+                                                     size_t maxCount = SIZE_MAX);
+    Batch<TimedMessage> waitForMessages(uint64_t cursor, size_t minCount,
+                                        std::chrono::milliseconds timeout, size_t maxCount = SIZE_MAX);
+    Batch<TimedTransition> waitForTransitions(uint64_t cursor, size_t minCount,
+                                              std::chrono::milliseconds timeout, size_t maxCount = SIZE_MAX);
+
+    // eventfd that becomes readable when new events arrive, for use in an
+    // external epoll loop. Call acknowledgeEventNotifyFd() before each read.
+    int getEventNotifyFd();
+    void acknowledgeEventNotifyFd();
+
+    // Independent consumer with its own filter, bounded queue and loss policy.
+    // The filter is checked once per event at ingest. Close the returned
+    // handle (or call unsubscribe) to stop delivery.
+    std::shared_ptr<Subscription> subscribe(const SubscriptionFilter& filter,
+                                            BackpressurePolicy policy = BackpressurePolicy::DropOldest,
+                                            size_t capacity = 1000);
+    void unsubscribe(const std::shared_ptr<Subscription>& subscription);
+
+    BufferUsage getBufferUsage() const;
+
+    // Online aggregates (see AggregateEngine): computed from each event as it
+    // is stored, on a thread of their own, and reset when a run starts.
+    // Register them here or in MidasReceiverConfig::aggregates, before or
+    // while running. Reading one copies just that aggregate.
+    bool addHistogram(const HistogramSpec& spec);
+    bool addWindow(const WindowSpec& spec);
+    void enableEventRates(std::chrono::milliseconds window = std::chrono::milliseconds(10000));
+    bool getHistogram(const std::string& name, HistogramSnapshot& out) const;
+    bool getWindow(const std::string& name, WindowSnapshot& out) const;
+    std::vector<EventRate> getEventRates() const;
+    AggregateStats getAggregateStats() const;
+    void resetAggregates();
+
+    // Files written by MidasReceiverConfig::fileWriter; all zero when disabled
+    EventFileStats getFileWriterStats() const;
+
+    // Events by run: TR_START opens a run and TR_STOP seals it (see
+    // RunSegments). Run lookups are O(1); readRunEvents() is a cursor read
+    // confined to the run, continuing into the cold tier and journal like
+    // readEventsFrom(), and a cursor of 0 starts at the run's first event.
+    bool getRun(int runNumber, RunSummary& out) const;
+    std::vector<RunSummary> getRuns() const;
+    Batch<std::shared_ptr<TimedEvent>> readRunEvents(int runNumber, uint64_t cursor, size_t maxCount);
+    EventSnapshot snapshotRun(int runNumber) const;
+
+    // Seen and sampled counts per event ID, for rate correction. Empty when
+    // no sampling is configured.
+    std::vector<SamplingCount> getSamplingCounts() const;
+
+    // Rates, occupancy, loss counters and latency percentiles. Ingest-to-read
+    // latency is recorded by readEventsFrom() and waitForEvents().
+    ReceiverStats getStats() const;
+
+    // Write getStats() to a file, or to a unix socket given as "unix:/path"
+    bool exportStats(const std::string& target, StatsFormat format = StatsFormat::Prometheus) const;
+
+    // Serial number gaps per run, from getAllEvents receivers. Run 0 collects
+    // gaps seen before the first run start.
+    int getCurrentRun() const;
+    SerialLoss getSerialLoss(int runNumber) const;
+    std::vector<SerialGap> getSerialGaps(int runNumber) const;
+
+    uint64_t getEventCursor() const;
+    uint64_t getMessageCursor() const;
+    uint64_t getTransitionCursor() const;
+
+    // JSON dump of an ODB subtree; served from the ODB cache while running.
+    // version, if given, receives the cache version the dump is current for.
+    std::string getOdb(const std::string& path = "/", uint64_t* version = nullptr);
+
+    // ODB keys changed after a version from getOdb() or an earlier call, so
+    // clients can refetch just those subtrees. Incomplete (refetch everything)
+    // when the cache is off or its change log no longer reaches back that far.
+    OdbCache::Changes getOdbChanges(uint64_t sinceVersion) const;
 
     INT getStatus() const;
     bool isListeningForEvents() const;
@@ -84,39 +302,171 @@ public:
 
 private:
     MidasReceiver();
-    ~MidasReceiver();
 
-    static void processEventCallback(HNDLE, HNDLE, EVENT_HEADER*, void*);
-    static void processMessageCallback(HNDLE, HNDLE, EVENT_HEADER*, void*);
-    static INT  processTransitionCallback(INT, char*);
+    // EventSink: called on the source's ingest thread
+    void deliverEvent(const EVENT_HEADER* header) override;
+    void deliverEvents(const EVENT_HEADER* const* headers, size_t count) override;
+    void deliverMessage(const EVENT_HEADER* header, const char* message) override;
+    INT  deliverTransition(INT transition, INT runNumber, char* error) override;
+    void sourceIdle(INT sourceStatus) override;
+    void sourceStopped(INT sourceStatus) override;
+
+    void setStatus(INT newStatus);
+    void wakeWaiters();
 
-    void run();
-    void processEvent(HNDLE, HNDLE, EVENT_HEADER*, void*);
-    void processMessage(HNDLE, HNDLE, EVENT_HEADER*, void*);
-    INT  processTransition(INT, char*);
+    void publishEvent(std::shared_ptr<TimedEvent>&& event);
+    void stageEvent(std::shared_ptr<TimedEvent>&& event);
+    void commitStaged();
+    void enforceRetention(size_t incomingBytes);
+    void evictOldest(bool handOver);
+    void markRunBoundary(INT transition, INT runNumber, std::chrono::system_clock::time_point at);
+    void applyRunBoundaries();
+    void releaseRuns();
+    void completeRun(RunSummary& run) const;
+    void dispatchToSubscribers(const std::shared_ptr<TimedEvent>& event);
+    std::chrono::system_clock::time_point nextTimestamp();
+    std::shared_ptr<TimedEvent> acceptEvent(const EVENT_HEADER* pheader);
+    std::shared_ptr<TimedEvent> copyEvent(const EVENT_HEADER* pheader);
+    void releaseSampled(bool all = false);
+    void storeEvent(const EVENT_HEADER* pheader);
+    Batch<std::shared_ptr<TimedEvent>> readEventsAcrossTiers(uint64_t cursor, size_t maxCount);
+    void recordReadLatency(const std::vector<std::shared_ptr<TimedEvent>>& events);
+    void reportSerialLoss();
+    void startAggregates();
+    void stopAggregates();
+    void stopFileWriter();
 
     std::string hostName, exptName, bufferName, clientName;
     int eventID;
     bool getAllEvents;
     size_t maxBufferSize;
     int cmYieldTimeout;
+    BufferReadOptions bufferRead;
+    size_t eventPoolCacheBytes;
+    RetentionPolicy eventRetention;
+    RunRetentionPolicy runRetention;
+    ColdTierPolicy coldTier;
+    std::string journalDirectory;
+    size_t journalSegmentBytes;
+    size_t journalMaxBytes;
+    std::string shmRingName;
+    size_t shmRingBytes;
+    size_t decodeWorkers;
+    size_t stagingCapacity;
+    size_t odbCacheEntries;
+
+    // Serial checking runs on the callback thread; the summary is logged from
+    // sourceIdle() at most once per serialReportInterval
+    SerialGapTracker serialGaps;
+    std::chrono::seconds serialReportInterval;
+    std::chrono::steady_clock::time_point lastSerialReport;
+
+    // Sampling runs on the ingest thread before events are copied; null when
+    // no rules are configured
+    std::vector<SamplingRule> samplingRules;
+    std::unique_ptr<EventSampler> sampler;
+    std::vector<std::shared_ptr<TimedEvent>> sampledReady;
+
+    // Byte accounting for eventBuffer; written by the producer, read by anyone.
+    // Evicted events count until the ring reclaims their nodes.
+    std::atomic<size_t> residentBytes{0};
+    std::atomic<uint64_t> receivedEvents{0};
+    std::atomic<uint64_t> receivedBytes{0};
+    std::atomic<uint64_t> evictedEvents{0};
+    std::atomic<uint64_t> evictedBytes{0};
+
+    // Storage for events and their shared_ptr control blocks; recycled on eviction
+    std::shared_ptr<EventPool> eventPool;
+
+    // Where evicted events go when journalDirectory is set. Appended by the
+    // publisher, or by the cold tier when there is one.
+    std::unique_ptr<EventJournal> journal;
+
+    // Compressed history between the ring and the journal; declared after the
+    // journal so it is destroyed first
+    std::unique_ptr<ColdStore> cold;
+
+    // Online aggregates, fed through their own subscription while running.
+    // aggregatesMutex serialises starting and stopping the worker.
+    std::unique_ptr<AggregateEngine> aggregates;
+    size_t aggregateQueueCapacity;
+    std::mutex aggregatesMutex;
+    std::shared_ptr<Subscription> aggregateSubscription;
+
+    // MIDAS file output, fed through its own subscription while running;
+    // null when disabled
+    std::unique_ptr<EventFileWriter> fileWriter;
+    size_t fileWriterQueueCapacity;
+    std::shared_ptr<Subscription> fileWriterSubscription;
+
+    // Local fan-out; written by whichever thread commits staged events
+    std::unique_ptr<ShmRingWriter> shmRing;
+
+    // Decode workers between the callback and the rings; null when decoding inline
+    std::vector<EventHandler> eventHandlers;
+    std::unique_ptr<EventPipeline> pipeline;
+
+    // Read lock-free by any caller. Events are written by the source's ingest
+    // thread (the cm_yield thread for a live buffer), or by the pipeline's
+    // current committer; messages and transitions always by the ingest thread.
+    std::unique_ptr<SequencedRing<std::shared_ptr<TimedEvent>>> eventBuffer;
+    std::unique_ptr<MessageStore> messageStore;
+    std::unique_ptr<SequencedRing<TimedTransition>> transitionBuffer;
+
+    // Run boundaries in the event sequence. Transitions arrive on the ingest
+    // thread but take effect on the publisher, in order with the events: with
+    // decode workers a boundary waits in runBoundaries until every event
+    // submitted before it has been published.
+    struct RunBoundary {
+        INT transition;
+        INT runNumber;
+        std::chrono::system_clock::time_point at;
+        uint64_t submitted; // Events submitted to the pipeline before the transition
+    };
+    std::unique_ptr<RunSegments> runSegments;
+    std::mutex runBoundaryMutex;
+    std::deque<RunBoundary> runBoundaries;
+    std::atomic<bool> runBoundaryPending{false};
+
+    // Events staged in eventBuffer but not yet published; owned by whichever
+    // thread is publishing, like the ring itself
+    std::vector<std::shared_ptr<TimedEvent>> stagedEvents;
+
+    // Subscribers: the master list is guarded by subscribersMutex; the producer
+    // works from its own copy, refreshed when subscribersVersion changes
+    mutable std::mutex subscribersMutex;
+    std::vector<std::shared_ptr<Subscription>> subscribers;
+    std::atomic<uint64_t> subscribersVersion{0};
+    std::vector<std::shared_ptr<Subscription>> activeSubscribers;
+    uint64_t activeSubscribersVersion = 0;
 
-    HNDLE hBufEvent;
-    INT requestID;
+    // One per ring: the producer signals, waitFor*() callers block on them
+    RingNotifier eventNotifier, messageNotifier, transitionNotifier;
 
-    std::vector<int> serialNumbers = std::vector<int>(10, 0);
-    bool firstEvent = true;
-    size_t countMismatches = 0;
-    size_t eventByteCount = 0;
+    // Instrumentation. callbacks and the rate window belong to the ingest
+    // thread; the histograms accept records from any thread.
+    static constexpr uint64_t kCallbackTimingInterval = 64; // Time one callback in this many
+    std::atomic<uint64_t> callbacks{0};
+    LatencyHistogram callbackTime;
+    mutable LatencyHistogram ingestToRead;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point rateWindowStart;
+    uint64_t rateWindowEvents = 0;
+    uint64_t rateWindowBytes = 0;
+    std::atomic<double> eventRate{0};
+    std::atomic<double> byteRate{0};
 
-    std::deque<std::shared_ptr<TimedEvent>> eventBuffer;
-    std::deque<TimedMessage> messageBuffer;
-    std::deque<TimedTransition> transitionBuffer;
+    // Last timestamp handed out; keeps every ring time-ordered for binary search
+    std::chrono::system_clock::time_point lastTimestamp{};
 
-    std::mutex eventBufferMutex, messageBufferMutex, transitionBufferMutex;
-    std::condition_variable bufferCV;
+    // Exists while a MIDAS buffer source runs, whose connection thread
+    // delivers the watch callbacks; replaced under odbCacheMutex
+    mutable std::mutex odbCacheMutex;
+    std::shared_ptr<OdbCache> odbCache;
 
-    std::thread workerThread;
+    // The configured source, or null for a MidasBufferSource built at start()
+    std::shared_ptr<EventSource> configuredSource;
+    std::shared_ptr<EventSource> source;
     std::atomic<bool> running;
     std::atomic<bool> listeningForEvents;
     std::atomic<bool> isInitialized;
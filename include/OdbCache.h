@@ -0,0 +1,92 @@
+#ifndef ODB_CACHE_H
+#define ODB_CACHE_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace midas {
+class odb;
+}
+
+// JSON dumps of ODB subtrees, kept until the ODB says they changed.
+//
+// The first get() of a path installs an ODB watch on it and then dumps it;
+// later calls are served from memory until a watch callback reports a change
+// at, above or below the path. Every reported change bumps a version
+// number and is logged, so clients can poll changedSince() and refetch only
+// the subtrees that moved instead of a full dump.
+//
+// Watch callbacks arrive on the thread running cm_yield, so the cache only
+// stays correct while something yields; MidasReceiver keeps one only while
+// its MIDAS buffer source runs. get() and changedSince() may be called from
+// any thread.
+class OdbCache {
+public:
+    struct Changes {
+        uint64_t version = 0;            // Pass to the next changedSince()
+        bool complete = true;            // False: the log no longer reaches back that far, refetch
+        std::vector<std::string> paths; // Changed keys, oldest change first, no duplicates
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;
+        size_t entries = 0;
+    };
+
+    explicit OdbCache(size_t maxEntries, size_t maxLoggedChanges = 4096);
+    ~OdbCache();
+
+    OdbCache(const OdbCache&) = delete;
+    OdbCache& operator=(const OdbCache&) = delete;
+
+    // JSON for the subtree at path; version, if given, receives the version
+    // the dump is current for
+    std::string get(const std::string& path, uint64_t* version = nullptr);
+
+    Changes changedSince(uint64_t version) const;
+    uint64_t version() const;
+    Stats stats() const;
+
+    // Drop every entry and its watch. The cache is closed afterwards: get()
+    // still dumps, but caches and watches nothing, so a get() in flight
+    // cannot leave a watch behind.
+    void clear();
+
+    static std::string normalize(const std::string& path);
+
+private:
+    struct Entry {
+        std::string json;
+        bool filled = false;
+        uint64_t fetchedAt = 0;  // Version when the dump started
+        uint64_t changedAt = 0;  // Version of the last change touching the path
+        uint64_t lastUsed = 0;
+        std::unique_ptr<midas::odb> watcher;
+    };
+
+    void changed(const std::string& path);
+    void evictIfFull(std::vector<std::unique_ptr<midas::odb>>& unwatch);
+    static bool related(const std::string& a, const std::string& b);
+
+    size_t maxEntries;
+    size_t maxLoggedChanges;
+
+    mutable std::mutex mutex; // Guards everything below
+    std::map<std::string, Entry> entries;
+    std::deque<std::pair<uint64_t, std::string>> changeLog;
+    uint64_t currentVersion = 0;
+    uint64_t useClock = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0;
+    bool closed = false;      // Set by clear()
+};
+
+#endif
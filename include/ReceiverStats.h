@@ -0,0 +1,115 @@
+#ifndef RECEIVER_STATS_H
+#define RECEIVER_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Percentiles of a LatencyHistogram, in nanoseconds
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p90Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+    uint64_t maxNs = 0;
+    double meanNs = 0;
+};
+
+// Log-linear (HDR-style) histogram of nanosecond durations.
+//
+// Values below 32 ns get a bucket each; above that every power of two is
+// split into 32 buckets, so any recorded value is reported within ~3%.
+// Values beyond ~73 minutes land in the last bucket. Recording is one relaxed
+// fetch_add and may happen from any number of threads.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t currentMax = max.load(std::memory_order_relaxed);
+        while (ns > currentMax && !max.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    LatencySummary summary() const;
+
+private:
+    static constexpr int kSubBits = 5;
+    static constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBits;
+    static constexpr int kMaxBit = 42;
+    static constexpr size_t kBuckets = (kMaxBit - kSubBits + 2) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t ns) {
+        if (ns < kSubBuckets) {
+            return static_cast<size_t>(ns);
+        }
+        int msb = 63 - __builtin_clzll(ns);
+        if (msb > kMaxBit) {
+            return kBuckets - 1;
+        }
+        int shift = msb - kSubBits;
+        return static_cast<size_t>((shift + 1) * kSubBuckets + ((ns >> shift) - kSubBuckets));
+    }
+
+    // Midpoint of the values that fall into a bucket
+    static uint64_t valueOf(size_t bucket);
+
+    std::vector<std::atomic<uint64_t>> counts;
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> max{0};
+};
+
+// Point-in-time view of one receiver, from MidasReceiver::getStats()
+struct ReceiverStats {
+    std::string bufferName;
+    double uptimeSeconds = 0;
+
+    // Averaged over the last rate window (about a second)
+    double eventsPerSecond = 0;
+    double bytesPerSecond = 0;
+
+    uint64_t callbacks = 0;        // Source deliveries (one per batch in pull mode)
+    uint64_t seenEvents = 0;       // Events arriving, before sampling
+    uint64_t sampledEvents = 0;    // Events kept by sampling; equals seenEvents without it
+    uint64_t receivedEvents = 0;   // Events stored
+    uint64_t receivedBytes = 0;
+    uint64_t evictedEvents = 0;
+    uint64_t evictedBytes = 0;
+
+    size_t residentEvents = 0;
+    size_t residentBytes = 0;
+    size_t capacityEvents = 0;
+    size_t capacityBytes = 0;      // 0: no byte limit
+
+    uint64_t serialGaps = 0;       // Serial number mismatches seen
+    uint64_t stagingStalls = 0;    // Times ingest waited on the decode workers
+    uint64_t subscriberDrops = 0;  // Events dropped by subscriber backpressure
+    uint64_t odbCacheHits = 0;     // getOdb() calls served from memory
+    uint64_t odbCacheMisses = 0;
+    uint64_t shmRingEvents = 0;    // Events written to the shared-memory ring
+    uint64_t shmRingDrops = 0;     // Events too large for it
+    uint64_t fileWriterEvents = 0; // Events written to MIDAS files
+    uint64_t fileWriterDrops = 0;  // Events the file writer's queue dropped
+
+    LatencySummary callbackTime;   // Sampled processEvent duration
+    LatencySummary ingestToRead;   // bm delivery to cursor read
+
+    std::string toJson() const;
+    std::string toPrometheus() const;
+};
+
+enum class StatsFormat {
+    Prometheus, // Text exposition format, e.g. for the node_exporter textfile collector
+    Json
+};
+
+// Write `text` to a file (replaced atomically) or, for "unix:/path", send it
+// to a listening unix stream socket. Logs and returns false on failure.
+bool exportStatsText(const std::string& text, const std::string& target);
+
+#endif
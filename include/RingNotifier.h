@@ -0,0 +1,113 @@
+#ifndef RING_NOTIFIER_H
+#define RING_NOTIFIER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+// Wakes consumers blocked on a SequencedRing when enough new records arrive.
+//
+// Waiters publish the lowest head they are waiting for (wakeTarget). The
+// producer only touches the mutex/futex when a waiter exists and that target
+// has been reached, then resets the target so the next few thousand pushes
+// cost two atomic loads each. Woken waiters whose own target is still ahead
+// lower it again before going back to sleep.
+//
+// An optional eventfd mirrors the same signal for external epoll loops. It is
+// written at most once until the consumer calls acknowledgeFd().
+class RingNotifier {
+public:
+    RingNotifier() = default;
+    ~RingNotifier();
+
+    RingNotifier(const RingNotifier&) = delete;
+    RingNotifier& operator=(const RingNotifier&) = delete;
+
+    // Producer: records up to (but excluding) `head` are now readable
+    void published(uint64_t head) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) != 0 &&
+            head >= wakeTarget.load(std::memory_order_relaxed)) {
+            wake();
+        }
+        if (fdArmed.load(std::memory_order_relaxed) && fdArmed.exchange(false, std::memory_order_acq_rel)) {
+            signalFd();
+        }
+    }
+
+    // Consumer: block until headFn() >= target, the deadline passes, or
+    // wakeAll() is called. After wakeAll(), and until start(), it does not
+    // block at all. Returns the last head observed.
+    template <typename HeadFn>
+    uint64_t waitUntil(uint64_t target, std::chrono::steady_clock::time_point deadline, HeadFn headFn) {
+        uint64_t head = headFn();
+        if (head >= target) {
+            return head;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopped) {
+            return head;
+        }
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        uint64_t generation = interruptGeneration;
+        while (true) {
+            lowerTarget(target);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            head = headFn();
+            if (head >= target || generation != interruptGeneration) {
+                break;
+            }
+            if (cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+                head = headFn();
+                break;
+            }
+        }
+        if (waiters.fetch_sub(1, std::memory_order_relaxed) == 1) {
+            wakeTarget.store(kNoTarget, std::memory_order_relaxed);
+        }
+        return head;
+    }
+
+    // Release every waiter regardless of its target, and keep later waits
+    // from blocking until start() (used when the producer stops)
+    void wakeAll();
+    void start();
+
+    // eventfd that becomes readable when new records arrive; created on first use
+    int fd();
+
+    // Drain the eventfd and re-arm it. Call when the fd is readable and before
+    // reading the new records, so nothing published in between is missed.
+    void acknowledgeFd();
+
+private:
+    static constexpr uint64_t kNoTarget = std::numeric_limits<uint64_t>::max();
+
+    void lowerTarget(uint64_t target) {
+        uint64_t current = wakeTarget.load(std::memory_order_relaxed);
+        while (target < current &&
+               !wakeTarget.compare_exchange_weak(current, target, std::memory_order_relaxed)) {
+        }
+    }
+
+    void wake();
+    void signalFd();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t interruptGeneration = 0; // Guarded by mutex
+    bool stopped = false;             // Guarded by mutex
+
+    alignas(64) std::atomic<uint32_t> waiters{0};
+    std::atomic<uint64_t> wakeTarget{kNoTarget};
+
+    std::mutex fdMutex;
+    std::atomic<int> eventFd{-1};
+    std::atomic<bool> fdArmed{false};
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef RUN_SEGMENTS_H
+#define RUN_SEGMENTS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "TimedEvent.h"
+
+// When the events of finished runs leave the event buffer. A run is sealed
+// by its stop (or abort, or the next start); sealed runs beyond keepRuns, or
+// sealed longer than keepFor, are taken out of memory together, oldest run
+// first. Zero disables that limit; the plain RetentionPolicy applies either way.
+struct RunRetentionPolicy {
+    size_t keepRuns = 0;                 // Newest sealed runs kept in memory
+    std::chrono::milliseconds keepFor{0}; // How long a sealed run stays in memory
+    bool spill = true;                   // Hand released runs to the cold tier or journal, if configured; else drop them
+    size_t maxRuns = 1000;               // Run summaries remembered
+};
+
+// One run's share of the event stream
+struct RunSummary {
+    int runNumber = 0;
+    bool sealed = false;    // No more events will be added
+    bool stopped = false;   // Sealed by TR_STOP, rather than an abort or the next start
+    bool aborted = false;   // Sealed by TR_STARTABORT
+    bool released = false;  // Taken out of the event buffer by the RunRetentionPolicy
+
+    // Transition times; the epoch when not seen (run 0 has no start)
+    std::chrono::system_clock::time_point startTime;
+    std::chrono::system_clock::time_point stopTime;
+    // First and last stored event; the epoch when there are none
+    std::chrono::system_clock::time_point firstEventTime;
+    std::chrono::system_clock::time_point lastEventTime;
+
+    uint64_t firstSequence = 0; // The run's events are [firstSequence, endSequence)
+    uint64_t endSequence = 0;   // Still growing while the run is open
+    uint64_t events = 0;
+    uint64_t bytes = 0;         // Raw event bytes
+    uint64_t residentEvents = 0; // Still in the event buffer
+
+    // From the serial gap tracker (getAllEvents receivers only)
+    uint64_t serialGaps = 0;
+    uint64_t missingEvents = 0;
+};
+
+// Event storage partitioned by run.
+//
+// Events keep one sequence space across runs, so a run is a contiguous range
+// of event sequences, opened at its start and sealed at its stop; run 0 holds
+// whatever arrives before the first start, and events between a stop and the
+// next start belong to no run. Lookups by run number are a hash lookup, and
+// reading a run's events is a cursor read over its range.
+//
+// begin(), end(), add() and takeExpired() are for the event publisher, in
+// sequence order; queries may come from any thread.
+class RunSegments {
+public:
+    explicit RunSegments(const RunRetentionPolicy& policy);
+
+    RunSegments(const RunSegments&) = delete;
+    RunSegments& operator=(const RunSegments&) = delete;
+
+    // Open a run at `sequence`, sealing any run still open there
+    void begin(int runNumber, uint64_t sequence, std::chrono::system_clock::time_point at);
+
+    // Seal the open run, if any, at `sequence`
+    void end(uint64_t sequence, std::chrono::system_clock::time_point at, bool aborted);
+
+    // Count a stored event towards the open run
+    void add(const TimedEvent& event) {
+        if (!isOpen) {
+            return;
+        }
+        int64_t ns = toNs(event.timestamp);
+        if (openEvents.load(std::memory_order_relaxed) == 0) {
+            openFirstNs.store(ns, std::memory_order_relaxed);
+        }
+        openLastNs.store(ns, std::memory_order_relaxed);
+        openBytes.store(openBytes.load(std::memory_order_relaxed) + event.size(), std::memory_order_relaxed);
+        openEvents.store(openEvents.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Mark the sealed runs the policy no longer keeps in memory as released.
+    // Returns the sequence their events end at, or 0 if there are none.
+    uint64_t takeExpired(std::chrono::system_clock::time_point now);
+
+    bool spills() const { return policy.spill; }
+
+    // False if the run is unknown. residentEvents and the serial figures are
+    // left for the caller, who knows the buffer.
+    bool find(int runNumber, RunSummary& out) const;
+
+    // Every remembered run, oldest first
+    std::vector<RunSummary> runs() const;
+
+private:
+    static int64_t toNs(std::chrono::system_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    }
+
+    void sealLocked(uint64_t sequence, std::chrono::system_clock::time_point at);
+    RunSummary summaryLocked(const RunSummary& run) const;
+
+    RunRetentionPolicy policy;
+    bool isOpen = true; // Publisher only; run 0 is open from the start
+
+    // Running totals of the open run, written by the publisher
+    std::atomic<uint64_t> openEvents{0};
+    std::atomic<uint64_t> openBytes{0};
+    std::atomic<int64_t> openFirstNs{0};
+    std::atomic<int64_t> openLastNs{0};
+
+    // Guards everything below. history[i] has the absolute index droppedRuns + i,
+    // which is what byNumber holds; the open run, if any, is history.back().
+    mutable std::mutex mutex;
+    std::deque<RunSummary> history;
+    std::unordered_map<int, uint64_t> byNumber;
+    uint64_t droppedRuns = 0;
+};
+
+#endif
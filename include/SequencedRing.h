@@ -0,0 +1,409 @@
+#ifndef SEQUENCED_RING_H
+#define SEQUENCED_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed-capacity ring with one producer and any number of concurrent readers.
+//
+// Every pushed record is assigned a monotonically increasing sequence number.
+// Readers never take a lock and the producer never waits for a reader: records
+// that fall off the ring are retired, and their nodes are only recycled once
+// every reader that could still be looking at them has left (two-phase epoch
+// reclamation). A reader must hold a ReadGuard while it touches records.
+// A retired record's value stays alive until its node is reclaimed; set a
+// reclaim handler to learn when that happens.
+template <typename T>
+class SequencedRing {
+    struct Node;
+
+public:
+    explicit SequencedRing(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1) {
+        size_t slots = 1;
+        while (slots < capacity_) {
+            slots <<= 1;
+        }
+        mask_ = slots - 1;
+        slots_ = std::vector<std::atomic<Node*>>(slots);
+        for (auto& slot : slots_) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SequencedRing() {
+        for (auto& slot : slots_) {
+            delete slot.load(std::memory_order_relaxed);
+        }
+        for (auto& list : retired_) {
+            for (Node* node : list) {
+                delete node;
+            }
+        }
+        for (Node* node : freeNodes_) {
+            delete node;
+        }
+    }
+
+    SequencedRing(const SequencedRing&) = delete;
+    SequencedRing& operator=(const SequencedRing&) = delete;
+
+    // Marks the calling thread as a reader for as long as the guard lives.
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const SequencedRing& ring) : ring_(ring), parity_(ring.enterRead()) {}
+        ~ReadGuard() { ring_.exitRead(parity_); }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+    private:
+        const SequencedRing& ring_;
+        unsigned parity_;
+    };
+
+    // ---- Producer side (single thread) ----
+
+    // Append a record, evicting the oldest one if the ring is full.
+    // Returns the sequence number assigned to the record.
+    uint64_t push(T value) {
+        uint64_t seq = stage(std::move(value));
+        publish();
+        return seq;
+    }
+
+    // Append a record without making it readable yet; publish() releases
+    // everything staged so far with a single store. Staged records are never
+    // evicted: if the ring fills up with them, they are published first.
+    uint64_t stage(T value) {
+        uint64_t seq = staged_;
+        if (seq - tail_.load(std::memory_order_relaxed) >= capacity_) {
+            if (tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_relaxed)) {
+                publish();
+            }
+            evictOldest();
+        }
+
+        Node* node = acquireNode();
+        node->seq = seq;
+        node->value = std::move(value);
+        slots_[seq & mask_].store(node, std::memory_order_release);
+        staged_ = seq + 1;
+
+        if (retiredSinceReclaim_ >= kReclaimBatch) {
+            tryReclaim();
+        }
+        return seq;
+    }
+
+    void publish() { head_.store(staged_, std::memory_order_release); }
+
+    // Sequence number the next staged or pushed record will receive
+    uint64_t nextSequence() const { return staged_; }
+
+    // Drop the oldest record. Returns false if the ring is empty.
+    bool evictOldest() {
+        uint64_t seq = tail_.load(std::memory_order_relaxed);
+        if (seq == head_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        Node* node = slots_[seq & mask_].exchange(nullptr, std::memory_order_acq_rel);
+        tail_.store(seq + 1, std::memory_order_release);
+        if (node != nullptr) {
+            retired_[epoch_.load(std::memory_order_relaxed) & 1].push_back(node);
+            ++retiredSinceReclaim_;
+        }
+        return true;
+    }
+
+    // Recycle what retired nodes no reader can still see, releasing their
+    // values. Producer side; stage() also does this every few evictions.
+    void reclaim() {
+        if (retired_[0].empty() && retired_[1].empty()) {
+            return;
+        }
+        tryReclaim(); // The previous epoch's nodes...
+        tryReclaim(); // ...then the current one's, unless a reader is in it
+    }
+
+    // Called by the producer with each retired value just before it is
+    // released, e.g. to account for the memory it held. Set before use.
+    void setReclaimHandler(std::function<void(const T&)> handler) { onReclaim_ = std::move(handler); }
+
+    // Producer-only peek at the oldest record, used to make eviction decisions.
+    const T* oldest() const {
+        uint64_t seq = tail_.load(std::memory_order_relaxed);
+        if (seq == head_.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        Node* node = slots_[seq & mask_].load(std::memory_order_relaxed);
+        return node != nullptr ? &node->value : nullptr;
+    }
+
+    // ---- Reader side (any thread) ----
+
+    // Sequence number the next pushed record will receive.
+    uint64_t head() const { return head_.load(std::memory_order_acquire); }
+
+    // Oldest sequence number that may still be readable.
+    uint64_t tail() const { return tail_.load(std::memory_order_acquire); }
+
+    size_t size() const {
+        uint64_t t = tail();
+        uint64_t h = head();
+        return h > t ? static_cast<size_t>(h - t) : 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // Visit records with sequence numbers in [from, to) that are still stored.
+    // f(seq, value) may return void, or bool where false stops the walk.
+    // Must be called while holding a ReadGuard; returns the sequence number
+    // after the last record visited (or the clamped start if none was).
+    template <typename F>
+    uint64_t visit(uint64_t from, uint64_t to, F&& f) const {
+        uint64_t t = tail();
+        uint64_t h = head();
+        uint64_t seq = from < t ? t : from;
+        uint64_t end = to < h ? to : h;
+        for (; seq < end; ++seq) {
+            const Node* node = slots_[seq & mask_].load(std::memory_order_acquire);
+            if (node == nullptr || node->seq != seq) {
+                continue; // Evicted while we were walking
+            }
+            if (!invoke(f, seq, node->value)) {
+                return seq + 1;
+            }
+        }
+        return seq;
+    }
+
+    // First sequence number in [tail(), end) for which pred(value) is true,
+    // assuming pred is false for a prefix of the ring and true for the rest
+    // (e.g. "timestamp > t" over time-ordered records). Returns end if none
+    // match; pass the head() the caller read, so one snapshot bounds the whole
+    // query. Binary search, so O(log n). Must be called while holding a ReadGuard.
+    template <typename Pred>
+    uint64_t partitionPoint(Pred&& pred, uint64_t end) const {
+        uint64_t lo = std::min(tail(), end);
+        uint64_t hi = end;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            const Node* node = slots_[mid & mask_].load(std::memory_order_acquire);
+            // A record evicted under us belongs to the old end of the ring
+            if (node == nullptr || node->seq != mid || !pred(node->value)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    template <typename Pred>
+    uint64_t partitionPoint(Pred&& pred) const {
+        return partitionPoint(std::forward<Pred>(pred), head());
+    }
+
+    // Zero-copy view of the records in [from, to) at the time it is taken.
+    // It holds a ReadGuard, so everything it yields stays valid, without a
+    // copy or a refcount change, until the view is destroyed. The producer
+    // never waits for it, but retired nodes are not recycled while it lives,
+    // so keep views short-lived. A record evicted before the walk reaches it
+    // is skipped.
+    class Snapshot {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            reference operator*() const { return node_->value; }
+            pointer operator->() const { return &node_->value; }
+            uint64_t sequence() const { return seq_; }
+
+            iterator& operator++() {
+                ++seq_;
+                settle();
+                return *this;
+            }
+            iterator operator++(int) {
+                iterator previous = *this;
+                ++*this;
+                return previous;
+            }
+            bool operator==(const iterator& other) const { return seq_ == other.seq_; }
+            bool operator!=(const iterator& other) const { return seq_ != other.seq_; }
+
+        private:
+            friend class Snapshot;
+            iterator(const SequencedRing* ring, uint64_t seq, uint64_t end) : ring_(ring), seq_(seq), end_(end) {
+                settle();
+            }
+
+            // Move to the first record at or after seq_ that is still stored
+            void settle() {
+                for (; seq_ < end_; ++seq_) {
+                    node_ = ring_->nodeAt(seq_);
+                    if (node_ != nullptr) {
+                        return;
+                    }
+                }
+                node_ = nullptr;
+            }
+
+            const SequencedRing* ring_;
+            uint64_t seq_;
+            uint64_t end_;
+            const Node* node_ = nullptr;
+        };
+
+        Snapshot(const SequencedRing& ring, uint64_t from, uint64_t to) : guard_(ring), ring_(ring) {
+            uint64_t t = ring.tail();
+            uint64_t h = ring.head();
+            begin_ = from < t ? t : from;
+            end_ = to < h ? to : h;
+            if (end_ < begin_) {
+                end_ = begin_;
+            }
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        iterator begin() const { return iterator(&ring_, begin_, end_); }
+        iterator end() const { return iterator(&ring_, end_, end_); }
+
+        // The sequence range the view covers; size() counts records evicted
+        // since the view was taken, so treat it as an upper bound
+        uint64_t firstSequence() const { return begin_; }
+        uint64_t endSequence() const { return end_; }
+        size_t size() const { return static_cast<size_t>(end_ - begin_); }
+        bool empty() const { return begin_ == end_; }
+
+        // f(seq, value), as for visit()
+        template <typename F>
+        uint64_t forEach(F&& f) const {
+            return ring_.visit(begin_, end_, std::forward<F>(f));
+        }
+
+    private:
+        ReadGuard guard_;
+        const SequencedRing& ring_;
+        uint64_t begin_ = 0;
+        uint64_t end_ = 0;
+    };
+
+    // Copy records in [from, to) out of the ring.
+    std::vector<T> copyRange(uint64_t from, uint64_t to) const {
+        std::vector<T> out;
+        ReadGuard guard(*this);
+        uint64_t t = tail();
+        uint64_t h = head();
+        uint64_t begin = from < t ? t : from;
+        uint64_t end = to < h ? to : h;
+        if (end > begin) {
+            out.reserve(static_cast<size_t>(end - begin));
+        }
+        visit(begin, end, [&out](uint64_t, const T& value) { out.push_back(value); });
+        return out;
+    }
+
+private:
+    struct Node {
+        uint64_t seq = 0;
+        T value{};
+    };
+
+    // The node holding seq, or null if it was evicted. Reader side.
+    const Node* nodeAt(uint64_t seq) const {
+        const Node* node = slots_[seq & mask_].load(std::memory_order_acquire);
+        return node != nullptr && node->seq == seq ? node : nullptr;
+    }
+
+    template <typename F>
+    static bool invoke(F& f, uint64_t seq, const T& value) {
+        if constexpr (std::is_same_v<decltype(f(seq, value)), void>) {
+            f(seq, value);
+            return true;
+        } else {
+            return static_cast<bool>(f(seq, value));
+        }
+    }
+
+    unsigned enterRead() const {
+        for (;;) {
+            uint64_t e = epoch_.load(std::memory_order_seq_cst);
+            unsigned parity = static_cast<unsigned>(e & 1);
+            readers_[parity].fetch_add(1, std::memory_order_seq_cst);
+            if (epoch_.load(std::memory_order_seq_cst) == e) {
+                return parity;
+            }
+            readers_[parity].fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    void exitRead(unsigned parity) const {
+        readers_[parity].fetch_sub(1, std::memory_order_release);
+    }
+
+    Node* acquireNode() {
+        if (!freeNodes_.empty()) {
+            Node* node = freeNodes_.back();
+            freeNodes_.pop_back();
+            return node;
+        }
+        return new Node();
+    }
+
+    // Nodes retired in the previous epoch can be recycled once no reader that
+    // entered during that epoch is left; then the epoch moves forward.
+    void tryReclaim() {
+        uint64_t e = epoch_.load(std::memory_order_relaxed);
+        unsigned previous = static_cast<unsigned>((e + 1) & 1);
+        if (readers_[previous].load(std::memory_order_seq_cst) != 0) {
+            return;
+        }
+        for (Node* node : retired_[previous]) {
+            if (onReclaim_) {
+                onReclaim_(node->value);
+            }
+            node->value = T{};
+            freeNodes_.push_back(node);
+        }
+        retired_[previous].clear();
+        epoch_.store(e + 1, std::memory_order_seq_cst);
+        retiredSinceReclaim_ = 0;
+    }
+
+    // Retirements between reclaim attempts; bounds the extra nodes in flight
+    static constexpr size_t kReclaimBatch = 32;
+
+    size_t capacity_;
+    size_t mask_ = 0;
+    std::vector<std::atomic<Node*>> slots_;
+
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> epoch_{0};
+    alignas(64) mutable std::atomic<uint32_t> readers_[2] = {{0}, {0}};
+
+    // Producer-owned bookkeeping
+    alignas(64) uint64_t staged_ = 0; // head_ plus records staged but not yet published
+    std::vector<Node*> retired_[2];
+    std::vector<Node*> freeNodes_;
+    size_t retiredSinceReclaim_ = 0;
+    std::function<void(const T&)> onReclaim_;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef SERIAL_GAP_TRACKER_H
+#define SERIAL_GAP_TRACKER_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// A run of consecutive serial numbers that never arrived for one event ID
+struct SerialGap {
+    uint16_t eventId;
+    uint32_t firstMissing;
+    uint32_t lastMissing;
+
+    uint64_t count() const { return uint64_t(lastMissing - firstMissing) + 1; }
+};
+
+// Loss totals for one run
+struct SerialLoss {
+    int runNumber = 0;
+    uint64_t gaps = 0;
+    uint64_t missingEvents = 0;
+    uint64_t outOfOrder = 0;  // Serials at or behind the previous one (duplicates, restarts)
+    bool truncated = false;   // More gaps than maxGapsPerRun; totals are still exact
+};
+
+// Loss accumulated since the previous takeReport(), for periodic summaries
+struct SerialLossReport {
+    uint64_t gaps = 0;
+    uint64_t missingEvents = 0;
+    uint64_t outOfOrder = 0;
+    SerialGap firstGap{};     // Valid when gaps > 0
+};
+
+// Per-event-ID serial number checking over the whole 16-bit event ID range.
+//
+// observe() is called for every event from the ingest thread and is a table
+// lookup plus a compare when nothing is lost. Gaps are recorded as intervals
+// per run, so a burst of a million lost events costs one entry. Queries and
+// reports may come from any thread.
+class SerialGapTracker {
+public:
+    explicit SerialGapTracker(size_t maxGapsPerRun = 65536, size_t maxRuns = 100);
+
+    // Ingest thread. Returns true if the serial does not follow the previous
+    // one for this event ID. Serial 0 restarts the sequence without a gap.
+    bool observe(uint16_t eventId, uint32_t serial) {
+        Entry& entry = table[eventId];
+        uint32_t expected = entry.last + 1;
+        bool first = !entry.seen;
+        entry.last = serial;
+        entry.seen = true;
+        if (first || serial == expected || serial == 0) {
+            return false;
+        }
+        recordGap(eventId, expected, serial);
+        return true;
+    }
+
+    // Ingest thread. Start attributing gaps to a new run; serials restart.
+    void beginRun(int runNumber);
+
+    int currentRun() const;
+    std::vector<int> runs() const;
+    std::vector<SerialGap> gaps(int runNumber) const;
+    SerialLoss loss(int runNumber) const;
+    uint64_t totalGaps() const;
+
+    // Loss since the previous call
+    SerialLossReport takeReport();
+
+private:
+    struct Entry {
+        uint32_t last = 0;
+        bool seen = false;
+    };
+
+    struct RunRecord {
+        SerialLoss loss;
+        std::vector<SerialGap> gaps;
+    };
+
+    void recordGap(uint16_t eventId, uint32_t expected, uint32_t serial);
+
+    std::vector<Entry> table; // Indexed by event ID; ingest thread only
+
+    size_t maxGapsPerRun;
+    size_t maxRuns;
+
+    mutable std::mutex mutex; // Guards everything below
+    std::map<int, RunRecord> history;
+    std::deque<int> order;    // Run numbers in history, oldest begun first
+    int current = 0;          // 0 until the first run start is seen
+    uint64_t total = 0;
+    SerialLossReport pending;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Live events in a named POSIX shared-memory ring, for local processes that
+// want them without linking midas_receiver or connecting to the experiment.
+//
+// One writer (a receiver with shmRingName set, see ShmRingWriter) copies each
+// event into the ring once. Any number of ShmRingReaders map it read-only and
+// walk it in place, each with a private cursor, so readers put no load on the
+// writer or on the experiment and cannot disturb one another. A reader that
+// falls more than a ring behind loses the oldest records and is told how many.
+//
+// This header and ShmRingReader.cpp use nothing from MIDAS; consumers link
+// the midas_shm_reader library. Event bytes are exactly what the buffer
+// manager delivered: an EVENT_HEADER followed by the banks.
+
+// Shared layout, version kVersion. The data area follows the header.
+// Positions are byte offsets that only grow; the data lives at
+// position % dataBytes. Records are 8-byte aligned and never straddle the end
+// of the data area: a padding record, or fewer than sizeof(ShmRecordHeader)
+// spare bytes, sends the reader to the start.
+struct ShmRingHeader {
+    static constexpr uint64_t kMagic = 0x31474e524d48534dULL; // "MSHMRNG1"
+    static constexpr uint32_t kVersion = 1;
+
+    std::atomic<uint64_t> magic;  // Stored last, once the rest is initialised
+    uint32_t version;
+    uint32_t headerBytes;         // Offset of the data area
+    uint64_t dataBytes;           // A power of two
+    int64_t createdNs;            // Tells one writer's ring from the next
+
+    // Seqlock over the fields below: odd while the writer changes them.
+    // Readers that need several at once retry until they see the same even
+    // value before and after.
+    alignas(64) std::atomic<uint64_t> lock;
+    std::atomic<uint64_t> head;          // Sequence after the newest published record
+    std::atomic<uint64_t> writePos;      // End of the published records
+    std::atomic<uint64_t> tailPos;       // Oldest intact record; bytes before it may be overwritten
+    std::atomic<uint64_t> tailSequence;  // Its sequence, or head if the ring is empty
+    std::atomic<uint32_t> closed;        // Set when the writer goes away
+};
+
+struct ShmRecordHeader {
+    static constexpr uint32_t kPadding = UINT32_MAX; // size of a padding record
+
+    uint32_t size;        // Event bytes that follow
+    uint32_t reserved;
+    uint64_t sequence;    // The receiver's event sequence number
+    int64_t timestampNs;  // system_clock since epoch
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory ring needs lock-free 64-bit atomics");
+
+// One process's view of a ring. Not thread-safe; give each thread its own.
+class ShmRingReader {
+public:
+    // A record as it sits in shared memory. The bytes may be overwritten as
+    // soon as the writer laps the reader, so a consumer that must not act on
+    // a torn event checks intact() after reading it (or copies it out and
+    // checks then).
+    struct Record {
+        uint64_t sequence;
+        std::chrono::system_clock::time_point timestamp;
+        const void* data;
+        size_t size;
+
+        bool intact() const { return reader->intact(position); }
+
+    private:
+        friend class ShmRingReader;
+        const ShmRingReader* reader;
+        uint64_t position;
+    };
+
+    ShmRingReader() = default;
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    // Map the ring called name ("/midas_events"). The cursor starts after the
+    // newest record, or at the oldest one with fromOldest. False, with
+    // error() set, if there is no such ring or it is not one of ours.
+    bool open(const std::string& name, bool fromOldest = false);
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+    const std::string& error() const { return error_; }
+
+    // True once the writer has gone; reopen to pick up its successor
+    bool writerClosed() const;
+
+    // Hand up to maxCount records after the cursor to f(const Record&),
+    // oldest first, and advance the cursor past them. Returns how many.
+    template <typename F>
+    size_t poll(F&& f, size_t maxCount = SIZE_MAX);
+
+    // Wait, polling, until records are available, the writer closes or the
+    // timeout passes; true if there is something to poll
+    bool wait(std::chrono::milliseconds timeout) const;
+
+    // Sequence of the next record the cursor will return
+    uint64_t nextSequence() const { return sequence_; }
+
+    // Records overwritten before this reader reached them
+    uint64_t missed() const { return missed_; }
+
+    // Consistent copy of the writer's counters
+    struct Status {
+        uint64_t head = 0;
+        uint64_t tailSequence = 0;
+        uint64_t writePos = 0;
+        uint64_t tailPos = 0;
+    };
+    Status status() const;
+
+    size_t dataBytes() const { return dataBytes_; }
+
+private:
+    bool intact(uint64_t position) const;
+    void resync();
+
+    ShmRingHeader* header_ = nullptr;
+    const char* data_ = nullptr;
+    size_t mappedBytes_ = 0;
+    uint64_t dataBytes_ = 0;
+    uint64_t position_ = 0;
+    uint64_t sequence_ = 0;
+    uint64_t missed_ = 0;
+    std::string error_;
+};
+
+template <typename F>
+size_t ShmRingReader::poll(F&& f, size_t maxCount) {
+    if (header_ == nullptr) {
+        return 0;
+    }
+    const uint64_t end = header_->writePos.load(std::memory_order_acquire);
+    size_t delivered = 0;
+    while (delivered < maxCount && position_ < end) {
+        const uint64_t offset = position_ & (dataBytes_ - 1);
+        if (dataBytes_ - offset < sizeof(ShmRecordHeader)) {
+            position_ += dataBytes_ - offset;
+            continue;
+        }
+
+        // Read the record header, then make sure the writer had not started
+        // on these bytes; the size is not trusted before that
+        ShmRecordHeader record = *reinterpret_cast<const ShmRecordHeader*>(data_ + offset);
+        if (!intact(position_)) {
+            resync();
+            continue;
+        }
+        if (record.size == ShmRecordHeader::kPadding) {
+            position_ += dataBytes_ - offset;
+            continue;
+        }
+
+        if (record.sequence > sequence_) {
+            missed_ += record.sequence - sequence_;
+        }
+        Record view;
+        view.sequence = record.sequence;
+        view.timestamp = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds(record.timestampNs)));
+        view.data = data_ + offset + sizeof(ShmRecordHeader);
+        view.size = record.size;
+        view.reader = this;
+        view.position = position_;
+
+        position_ += (sizeof(ShmRecordHeader) + record.size + 7) & ~uint64_t(7);
+        sequence_ = record.sequence + 1;
+        ++delivered;
+        f(static_cast<const Record&>(view));
+    }
+    return delivered;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SHM_RING_WRITER_H
+#define SHM_RING_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "ShmRing.h"
+
+// Writer side of a shared-memory event ring (see ShmRing.h for the layout
+// and the reader). Creates the named segment, replacing a stale one left by a
+// crashed writer, and unlinks it again on destruction; readers still mapping
+// it see closed and can reopen.
+//
+// write() and publish() belong to a single thread. Nothing here waits on or
+// even looks at the readers.
+class ShmRingWriter {
+public:
+    // dataBytes is rounded up to a power of two, at least 64 KiB
+    ShmRingWriter(const std::string& name, size_t dataBytes);
+    ~ShmRingWriter();
+
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    // False if the segment could not be created; writes are then dropped
+    bool isOpen() const { return header != nullptr; }
+
+    // Copy one event into the ring, overwriting the oldest records as needed.
+    // Readers see it after the next publish(). Events larger than half the
+    // ring are dropped and counted.
+    void write(uint64_t sequence, std::chrono::system_clock::time_point timestamp, const void* bytes,
+               size_t size);
+    void publish();
+
+    const std::string& name() const { return segmentName; }
+    uint64_t written() const { return writtenCount.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t recordEnd(uint64_t position) const;
+    uint64_t skipPadding(uint64_t position, uint64_t limit) const;
+
+    std::string segmentName;
+    ShmRingHeader* header = nullptr;
+    char* data = nullptr;
+    size_t mappedBytes = 0;
+    uint64_t dataBytes = 0;
+
+    // Writer-local: where the next record goes and the sequence after the
+    // newest record written, published or not
+    uint64_t nextPos = 0;
+    uint64_t nextSequence = 0;
+    bool unpublished = false;
+
+    std::atomic<uint64_t> writtenCount{0};
+    std::atomic<uint64_t> droppedCount{0};
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "TimedEvent.h"
+
+// Which events a subscriber receives. Empty lists match everything.
+struct SubscriptionFilter {
+    std::vector<uint16_t> eventIds;
+    uint16_t triggerMask = 0xFFFF;       // Event matches if any of these bits is set
+    std::vector<std::string> bankNames;  // Event must contain at least one of these banks
+};
+
+// What happens when a subscriber's queue is full
+enum class BackpressurePolicy {
+    DropOldest, // Discard the oldest queued event to make room
+    DropNewest, // Discard the incoming event
+    Block       // Stall ingest until the subscriber makes room
+};
+
+// Per-subscriber counters; totals only grow
+struct SubscriptionStats {
+    uint64_t matched = 0;    // Events that passed the filter
+    uint64_t delivered = 0;  // Events handed to the consumer
+    uint64_t droppedOldest = 0;
+    uint64_t droppedNewest = 0;
+    uint64_t blockedNs = 0;  // Time ingest spent waiting on a full queue (Block)
+    size_t queued = 0;
+};
+
+// One subscriber: a filter checked once at ingest, a bounded queue of matching
+// events, and a cursor counting how many events the consumer has taken.
+// Obtained from MidasReceiver::subscribe(); the consumer side may be used from
+// one thread at a time.
+class Subscription {
+public:
+    Subscription(const SubscriptionFilter& filter, BackpressurePolicy policy, size_t capacity);
+
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+
+    // ---- Consumer side ----
+
+    // Take up to maxCount queued events without waiting
+    std::vector<std::shared_ptr<TimedEvent>> poll(size_t maxCount = SIZE_MAX);
+
+    // Wait until minCount events are queued, the timeout expires or the
+    // subscription is closed, then take up to maxCount of them
+    std::vector<std::shared_ptr<TimedEvent>> wait(size_t minCount, std::chrono::milliseconds timeout,
+                                                  size_t maxCount = SIZE_MAX);
+
+    // Number of events taken so far; the subscriber's own sequence space
+    uint64_t cursor() const { return delivered.load(std::memory_order_relaxed); }
+
+    SubscriptionStats stats() const;
+    BackpressurePolicy policy() const { return policy_; }
+
+    // Stop receiving events; the receiver drops the subscription on its next event
+    void close();
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    // ---- Ingest side (receiver thread) ----
+
+    bool matches(const EventView& event) const;
+
+    // Queue an event according to the backpressure policy. Block waits until
+    // there is room, the subscription is closed, or keepWaiting() returns false.
+    template <typename KeepWaiting>
+    void offer(const std::shared_ptr<TimedEvent>& event, KeepWaiting keepWaiting);
+
+    // Wake a producer blocked in offer() so it can re-check keepWaiting()
+    void interrupt();
+
+private:
+    void pushLocked(const std::shared_ptr<TimedEvent>& event);
+
+    // Compiled filter
+    std::vector<uint64_t> eventIdBits; // 65536-bit set, empty when all IDs match
+    uint16_t triggerMask;
+    std::vector<uint32_t> banks;       // Packed bank names
+
+    BackpressurePolicy policy_;
+
+    // Bounded FIFO of queued events
+    mutable std::mutex mutex;
+    std::condition_variable dataCV, spaceCV;
+    std::vector<std::shared_ptr<TimedEvent>> queue;
+    size_t queueHead = 0;
+    size_t queueSize = 0;
+
+    std::atomic<bool> closed{false};
+    std::atomic<uint64_t> matched{0}, delivered{0}, droppedOldest{0}, droppedNewest{0}, blockedNs{0};
+};
+
+template <typename KeepWaiting>
+void Subscription::offer(const std::shared_ptr<TimedEvent>& event, KeepWaiting keepWaiting) {
+    matched.fetch_add(1, std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (queueSize == queue.size()) {
+        switch (policy_) {
+        case BackpressurePolicy::DropNewest:
+            droppedNewest.fetch_add(1, std::memory_order_relaxed);
+            return;
+        case BackpressurePolicy::DropOldest:
+            queue[queueHead].reset();
+            queueHead = (queueHead + 1) % queue.size();
+            --queueSize;
+            droppedOldest.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case BackpressurePolicy::Block: {
+            auto start = std::chrono::steady_clock::now();
+            while (queueSize == queue.size() && !isClosed() && keepWaiting()) {
+                spaceCV.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            blockedNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - start).count(),
+                                std::memory_order_relaxed);
+            if (queueSize == queue.size()) {
+                droppedNewest.fetch_add(1, std::memory_order_relaxed); // Gave up waiting
+                return;
+            }
+            break;
+        }
+        }
+    }
+    pushLocked(event);
+    lock.unlock();
+    dataCV.notify_one();
+}
+
+#endif
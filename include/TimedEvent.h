@@ -0,0 +1,35 @@
+#ifndef TIMED_EVENT_H
+#define TIMED_EVENT_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "midas.h"
+#include "midasio.h"
+
+#include "EventPool.h"
+#include "EventView.h"
+
+// One stored event. The raw bytes live in a pooled block, and the record is
+// shared (via shared_ptr) by the event ring and every reader holding it.
+struct TimedEvent {
+    std::chrono::system_clock::time_point timestamp;
+    uint64_t sequence; // Assigned by the event ring; never repeats
+    PooledBuffer raw; // EVENT_HEADER followed by the payload, as delivered by the buffer manager
+    BankIndexSlot bankIndex; // Built on first full bank walk, shared by all readers
+
+    const EVENT_HEADER* header() const { return reinterpret_cast<const EVENT_HEADER*>(raw.data()); }
+    size_t size() const { return raw.size(); }
+
+    // Zero-copy view of the stored bytes with lazy bank parsing
+    EventView view() const { return EventView(raw.data(), raw.size(), &bankIndex); }
+
+    // Memory this event holds: its pooled payload block plus the record itself
+    size_t footprint() const { return raw.capacity() + sizeof(TimedEvent); }
+
+    // Parse into a TMEvent (allocates and copies the payload)
+    std::shared_ptr<TMEvent> toTMEvent() const { return std::make_shared<TMEvent>(raw.data(), raw.size()); }
+};
+
+#endif
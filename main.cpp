@@ -1,3 +1,4 @@
+#include "FileReplaySource.h"
 #include "MidasReceiver.h"
 #include <iostream>
 #include <thread>
@@ -25,6 +26,9 @@ int main(int argc, char* argv[]) {
     if (argc > 2) {
         numEvents = std::atoi(argv[2]);
     }
+    // Optional third argument: replay a recorded .mid/.mid.gz file instead of
+    // connecting to an experiment
+    std::string replayFile = argc > 3 ? argv[3] : "";
 
     std::cout << "Starting MidasReceiver with interval " << intervalMs
               << " ms and retrieving " << numEvents << " events per iteration." << std::endl;
@@ -39,6 +43,8 @@ int main(int argc, char* argv[]) {
     config.eventID = EVENTID_ALL;
     config.getAllEvents = true;
     config.maxBufferSize = 1000;
+    config.eventRetention.maxBytes = 256 * 1024 * 1024;
+    config.eventRetention.maxAge = std::chrono::minutes(5);
     config.cmYieldTimeout = 300;
     config.transitionRegistrations = {
         {TR_START,      100},
@@ -48,78 +54,96 @@ int main(int argc, char* argv[]) {
         {TR_STARTABORT, 500}
     };
 
+    if (!replayFile.empty()) {
+        FileReplayConfig replay;
+        replay.files = {replayFile};
+        replay.pacing = ReplayPacing::RealTime;
+        config.eventSource = std::make_shared<FileReplaySource>(replay);
+    }
+
     midasReceiver.init(config);
 
-    auto lastEventTimestamp = std::chrono::system_clock::now();
-    auto lastMessageTimestamp = std::chrono::system_clock::now();
-    auto lastTransitionTimestamp = std::chrono::system_clock::now();
+    // Cursors start at "now": only records arriving after start are shown
+    uint64_t eventCursor = midasReceiver.getEventCursor();
+    uint64_t messageCursor = midasReceiver.getMessageCursor();
+    uint64_t transitionCursor = midasReceiver.getTransitionCursor();
 
     midasReceiver.start();
 
     while (midasReceiver.isListeningForEvents()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        // Sleep until an event arrives, or at most one interval
+        midasReceiver.waitForEvents(eventCursor, 1, std::chrono::milliseconds(intervalMs), 0);
+
+        // Only the newest numEvents are printed; skip ahead over the rest
+        uint64_t head = midasReceiver.getEventCursor();
+        if (head - eventCursor > numEvents) {
+            eventCursor = head - numEvents;
+        }
 
         // Retrieve and print events (shared_ptr<TimedEvent>)
-        auto timedEvents = midasReceiver.getLatestEvents(numEvents, lastEventTimestamp);
+        auto eventBatch = midasReceiver.readEventsFrom(eventCursor, numEvents);
+        auto& timedEvents = eventBatch.records;
+        eventCursor = eventBatch.nextCursor;
         if (!timedEvents.empty()) {
             std::cout << "\n=== Midas Events (count=" << timedEvents.size() << ") ===" << std::endl;
             for (auto& timedEventPtr : timedEvents) {
                 auto& timedEvent = *timedEventPtr;
-                TMEvent& event = *timedEvent.event;
+                EventView event = timedEvent.view();
                 auto& ts = timedEvent.timestamp;
 
-                event.FindAllBanks();
-
-                std::cout << "[EVENT] Timestamp: " << formatTimestamp(ts) << std::endl;
-                std::cout << "  Event ID: " << event.event_id << std::endl;
-                std::cout << "  Trigger Mask: " << event.trigger_mask << std::endl;
-                std::cout << "  Serial Number: " << event.serial_number << std::endl;
-                std::cout << "  Data Size: " << event.data_size << " bytes" << std::endl;
-                std::cout << "  Event Header Size: " << event.event_header_size << " bytes" << std::endl;
-                std::cout << "  Bank Header Flags: " << event.bank_header_flags << std::endl;
-
-                if (!event.banks.empty()) {
-                    std::cout << "  Banks (" << event.banks.size() << "):" << std::endl;
-                    for (const auto& bank : event.banks) {
-                        std::cout << "    Name: " << bank.name << ", Size: " << bank.data_size << " bytes" << std::endl;
+                std::cout << "[EVENT] Timestamp: " << formatTimestamp(ts)
+                          << " (sequence " << timedEvent.sequence << ")" << std::endl;
+                std::cout << "  Event ID: " << event.eventId() << std::endl;
+                std::cout << "  Trigger Mask: " << event.triggerMask() << std::endl;
+                std::cout << "  Serial Number: " << event.serialNumber() << std::endl;
+                std::cout << "  Data Size: " << event.dataSize() << " bytes" << std::endl;
+                std::cout << "  Event Header Size: " << sizeof(EVENT_HEADER) << " bytes" << std::endl;
+                std::cout << "  Bank Header Flags: " << event.bankFlags() << std::endl;
+
+                const auto& banks = event.banks();
+                if (!banks.empty()) {
+                    std::cout << "  Banks (" << banks.size() << "):" << std::endl;
+                    for (const auto& bank : banks) {
+                        std::cout << "    Name: " << bank.nameString() << ", Size: " << bank.size << " bytes" << std::endl;
                     }
                 }
 
                 std::cout << "  Data (first 32 bytes): ";
-                for (size_t i = 0; i < std::min(event.data.size(), size_t(32)); ++i) {
-                    printf("%02X ", static_cast<unsigned char>(event.data[i]));
+                for (size_t i = 0; i < std::min(event.size(), size_t(32)); ++i) {
+                    printf("%02X ", static_cast<unsigned char>(event.data()[i]));
                 }
                 std::cout << std::endl << std::endl;
             }
-            lastEventTimestamp = timedEvents.back()->timestamp;
         } else {
             std::cout << "[INFO] No new events." << std::endl;
         }
 
-        // Messages remain unchanged (still by value)
-        auto messages = midasReceiver.getLatestMessages(numEvents, lastMessageTimestamp);
+        // Messages are parsed at ingest and own their text
+        auto messageBatch = midasReceiver.readMessagesFrom(messageCursor, numEvents);
+        auto& messages = messageBatch.records;
+        messageCursor = messageBatch.nextCursor;
         if (!messages.empty()) {
             std::cout << "\n=== Midas Messages (count=" << messages.size() << ") ===" << std::endl;
             for (const auto& msg : messages) {
                 std::cout << "Timestamp: " << formatTimestamp(msg.timestamp) << std::endl;
-                std::cout << "Message data pointer: " << msg.message << std::endl;
-                // Add decoding here if message structure is known
+                std::cout << "[" << msg.facility() << "," << msg.type << "] " << msg.text() << std::endl;
             }
             std::cout << std::endl;
-            lastMessageTimestamp = messages.back().timestamp;
         }
 
         // Transitions remain unchanged (still by value)
-        auto transitions = midasReceiver.getLatestTransitions(numEvents, lastTransitionTimestamp);
+        auto transitionBatch = midasReceiver.readTransitionsFrom(transitionCursor, numEvents);
+        auto& transitions = transitionBatch.records;
+        transitionCursor = transitionBatch.nextCursor;
         if (!transitions.empty()) {
             std::cout << "\n=== Midas Transitions (count=" << transitions.size() << ") ===" << std::endl;
             for (const auto& transition : transitions) {
                 std::cout << "Timestamp: " << formatTimestamp(transition.timestamp)
+                          << ", Transition: " << cm_transition_name(transition.transition)
                           << ", Run Number: " << transition.run_number
                           << ", Error: " << transition.error << std::endl;
             }
             std::cout << std::endl;
-            lastTransitionTimestamp = transitions.back().timestamp;
         }
     }
 
@@ -0,0 +1,457 @@
+#include "Aggregates.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "EventView.h"
+
+static int64_t toNs(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+// ---- Value kernels ----
+//
+// Bank payloads are not guaranteed to be aligned for their type (16-bit bank
+// headers give 4-byte alignment), so values are first copied into a small
+// aligned chunk. The per-value arithmetic then runs over that chunk with no
+// branches and no dependencies between iterations, which the compiler turns
+// into SIMD code; only the bin increments are scalar.
+
+static constexpr size_t kChunk = 256;
+
+template <typename T>
+static size_t loadChunk(const char* data, size_t first, size_t stride, size_t done, size_t count, T* values) {
+    size_t n = std::min(kChunk, count - done);
+    if (stride == 1) {
+        std::memcpy(values, data + (first + done) * sizeof(T), n * sizeof(T));
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            std::memcpy(&values[i], data + (first + (done + i) * stride) * sizeof(T), sizeof(T));
+        }
+    }
+    return n;
+}
+
+// counts has bins + 2 entries: underflow, the bins, overflow
+template <typename T>
+static void fillBins(const char* data, size_t first, size_t stride, size_t count, double min, double scale,
+                     size_t bins, uint64_t* counts, double& sum) {
+    T values[kChunk];
+    int32_t index[kChunk];
+    const double top = static_cast<double>(bins + 1);
+    double total = 0;
+    for (size_t done = 0; done < count;) {
+        size_t n = loadChunk(data, first, stride, done, count, values);
+        for (size_t i = 0; i < n; ++i) {
+            double x = (static_cast<double>(values[i]) - min) * scale + 1.0;
+            x = x > 0.0 ? x : 0.0; // Also sends NaN to the underflow bin
+            x = x < top ? x : top;
+            index[i] = static_cast<int32_t>(x);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            ++counts[index[i]];
+            total += static_cast<size_t>(index[i] - 1) < bins ? static_cast<double>(values[i]) : 0.0;
+        }
+        done += n;
+    }
+    sum += total;
+}
+
+template <typename T>
+static double sumValues(const char* data, size_t first, size_t stride, size_t count) {
+    T values[kChunk];
+    double lanes[4] = {0, 0, 0, 0};
+    for (size_t done = 0; done < count;) {
+        size_t n = loadChunk(data, first, stride, done, count, values);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            lanes[0] += static_cast<double>(values[i]);
+            lanes[1] += static_cast<double>(values[i + 1]);
+            lanes[2] += static_cast<double>(values[i + 2]);
+            lanes[3] += static_cast<double>(values[i + 3]);
+        }
+        for (; i < n; ++i) {
+            lanes[0] += static_cast<double>(values[i]);
+        }
+        done += n;
+    }
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// Call f with a value of the C type for a bank TID; false for types that
+// are not numbers
+template <typename F>
+static bool withBankType(uint32_t type, F&& f) {
+    switch (type) {
+    case TID_UINT8: f(uint8_t()); return true;
+    case TID_INT8: f(int8_t()); return true;
+    case TID_UINT16: f(uint16_t()); return true;
+    case TID_INT16: f(int16_t()); return true;
+    case TID_UINT32: f(uint32_t()); return true;
+    case TID_INT32: f(int32_t()); return true;
+    case TID_UINT64: f(uint64_t()); return true;
+    case TID_INT64: f(int64_t()); return true;
+    case TID_FLOAT: f(float()); return true;
+    case TID_DOUBLE: f(double()); return true;
+    default: return false;
+    }
+}
+
+// ---- Buckets ----
+
+void AggregateEngine::Buckets::init(std::chrono::milliseconds window) {
+    width = std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(window).count() / kBuckets, 1);
+    clear();
+}
+
+void AggregateEngine::Buckets::clear() {
+    newest = INT64_MIN;
+    std::fill(std::begin(counts), std::end(counts), 0);
+    std::fill(std::begin(sums), std::end(sums), 0.0);
+}
+
+void AggregateEngine::Buckets::add(int64_t timeNs, uint64_t count, double sum) {
+    int64_t bucket = timeNs / width;
+    if (newest == INT64_MIN) {
+        newest = bucket;
+    } else if (bucket > newest) {
+        for (int64_t b = std::max(newest + 1, bucket - static_cast<int64_t>(kBuckets) + 1); b <= bucket; ++b) {
+            counts[b % kBuckets] = 0;
+            sums[b % kBuckets] = 0;
+        }
+        newest = bucket;
+    } else if (bucket <= newest - static_cast<int64_t>(kBuckets)) {
+        return; // Older than the window
+    }
+    counts[bucket % kBuckets] += count;
+    sums[bucket % kBuckets] += sum;
+}
+
+// Totals over the window ending at nowNs, and the seconds they cover: the
+// whole window, or less if the run began inside it
+void AggregateEngine::Buckets::total(int64_t nowNs, int64_t sinceNs, uint64_t& count, double& sum,
+                                     double& seconds) const {
+    count = 0;
+    sum = 0;
+    int64_t nowBucket = nowNs / width;
+    int64_t oldest = nowBucket - static_cast<int64_t>(kBuckets) + 1;
+    if (newest != INT64_MIN) {
+        for (int64_t b = std::max(oldest, newest - static_cast<int64_t>(kBuckets) + 1);
+             b <= std::min(newest, nowBucket); ++b) {
+            count += counts[b % kBuckets];
+            sum += sums[b % kBuckets];
+        }
+    }
+    int64_t start = std::max(oldest * width, sinceNs);
+    seconds = nowNs > start ? static_cast<double>(nowNs - start) * 1e-9 : 0;
+}
+
+// ---- Engine ----
+
+AggregateEngine::AggregateEngine(const AggregateOptions& options) {
+    for (const auto& spec : options.histograms) {
+        addHistogram(spec);
+    }
+    for (const auto& spec : options.windows) {
+        addWindow(spec);
+    }
+    if (options.eventRates) {
+        enableEventRates(options.rateWindow);
+    }
+}
+
+AggregateEngine::~AggregateEngine() {
+    stop();
+}
+
+bool AggregateEngine::compile(const BankChannel& channel, Source& source) {
+    if (channel.bank.size() != 4 || channel.channels == 0 ||
+        (channel.channel >= 0 && static_cast<uint32_t>(channel.channel) >= channel.channels)) {
+        return false;
+    }
+    std::memcpy(&source.bank, channel.bank.data(), 4);
+    source.channel = channel.channel;
+    source.channels = channel.channel >= 0 ? channel.channels : 1;
+    source.eventID = channel.eventID;
+    return true;
+}
+
+bool AggregateEngine::addHistogram(const HistogramSpec& spec) {
+    auto histogram = std::make_unique<Histogram>();
+    histogram->spec = spec;
+    if (spec.bins == 0 || !(spec.max > spec.min) || !compile(spec.source, histogram->source)) {
+        cm_msg(MERROR, "AggregateEngine::addHistogram", "Invalid histogram \"%s\"", spec.name.c_str());
+        return false;
+    }
+    histogram->counts.assign(spec.bins + 2, 0);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& existing : histograms) {
+        if (existing->spec.name == spec.name) {
+            cm_msg(MERROR, "AggregateEngine::addHistogram", "Histogram \"%s\" already exists", spec.name.c_str());
+            return false;
+        }
+    }
+    histograms.push_back(std::move(histogram));
+    return true;
+}
+
+bool AggregateEngine::addWindow(const WindowSpec& spec) {
+    auto window = std::make_unique<Window>();
+    window->spec = spec;
+    if (spec.window.count() <= 0 || !compile(spec.source, window->source)) {
+        cm_msg(MERROR, "AggregateEngine::addWindow", "Invalid window \"%s\"", spec.name.c_str());
+        return false;
+    }
+    window->buckets.init(spec.window);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& existing : windows) {
+        if (existing->spec.name == spec.name) {
+            cm_msg(MERROR, "AggregateEngine::addWindow", "Window \"%s\" already exists", spec.name.c_str());
+            return false;
+        }
+    }
+    windows.push_back(std::move(window));
+    return true;
+}
+
+void AggregateEngine::enableEventRates(std::chrono::milliseconds window) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ratesEnabled = true;
+    rateWindow = window.count() > 0 ? window : std::chrono::milliseconds(10000);
+    rates.clear();
+}
+
+bool AggregateEngine::hasAggregates() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ratesEnabled || !histograms.empty() || !windows.empty();
+}
+
+void AggregateEngine::start(std::shared_ptr<Subscription> events) {
+    if (worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscription = events;
+    }
+    stopping = false;
+    worker = std::thread(&AggregateEngine::workerLoop, this, std::move(events));
+}
+
+void AggregateEngine::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    stopping = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    subscription->close();
+    lock.unlock();
+    worker.join();
+
+    lock.lock();
+    while (!pendingRuns.empty()) {
+        applyRunStart(pendingRuns.front());
+        pendingRuns.pop_front();
+    }
+}
+
+void AggregateEngine::beginRun(int run, std::chrono::system_clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingRuns.push_back(PendingRun{run, toNs(at)});
+}
+
+void AggregateEngine::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    resetLocked();
+}
+
+void AggregateEngine::workerLoop(std::shared_ptr<Subscription> events) {
+    while (!stopping.load(std::memory_order_acquire)) {
+        auto batch = events->wait(1, std::chrono::milliseconds(100), 1024);
+        if (batch.empty()) {
+            // Nothing queued from before a pending run start, as far as we
+            // can tell; stragglers still in the decode pipeline count as late
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!pendingRuns.empty()) {
+                applyRunStart(pendingRuns.front());
+                pendingRuns.pop_front();
+            }
+            continue;
+        }
+        for (const auto& event : batch) {
+            std::lock_guard<std::mutex> lock(mutex);
+            process(*event);
+        }
+    }
+}
+
+void AggregateEngine::applyRunStart(const PendingRun& run) {
+    runNumber = run.runNumber;
+    runStartNs = run.atNs;
+    resetLocked();
+}
+
+void AggregateEngine::resetLocked() {
+    for (auto& histogram : histograms) {
+        std::fill(histogram->counts.begin(), histogram->counts.end(), 0);
+        histogram->entries = 0;
+        histogram->sum = 0;
+    }
+    for (auto& window : windows) {
+        window->buckets.clear();
+        window->runCount = 0;
+        window->runSum = 0;
+    }
+    rates.clear();
+}
+
+// Worker thread, with the lock held
+void AggregateEngine::process(const TimedEvent& event) {
+    const int64_t timeNs = toNs(event.timestamp);
+    while (!pendingRuns.empty() && timeNs >= pendingRuns.front().atNs) {
+        applyRunStart(pendingRuns.front());
+        pendingRuns.pop_front();
+    }
+    if (timeNs < runStartNs) {
+        ++lateEvents;
+        return;
+    }
+    ++processedEvents;
+
+    EventView view = event.view();
+    const uint16_t eventId = view.eventId();
+
+    if (ratesEnabled) {
+        Rate& rate = rates[eventId];
+        if (rate.buckets.width == 0) {
+            rate.buckets.init(rateWindow);
+        }
+        ++rate.runEvents;
+        rate.buckets.add(timeNs, 1, 0);
+    }
+
+    // Values of one source in this event: first index, stride and count
+    auto select = [&](const Source& source, const BankSpan& bank, size_t valueSize, size_t& first, size_t& count) {
+        size_t values = bank.size / valueSize;
+        if (source.channel < 0) {
+            first = 0;
+            count = values;
+        } else {
+            first = static_cast<size_t>(source.channel);
+            count = values > first ? (values - first + source.channels - 1) / source.channels : 0;
+        }
+    };
+    auto wanted = [&](const Source& source) {
+        return source.eventID == EVENTID_ALL || static_cast<uint16_t>(source.eventID) == eventId;
+    };
+
+    for (auto& histogram : histograms) {
+        if (!wanted(histogram->source)) {
+            continue;
+        }
+        BankSpan bank = view.findBank(histogram->source.bank);
+        if (bank.data == nullptr) {
+            continue;
+        }
+        const HistogramSpec& spec = histogram->spec;
+        const double scale = static_cast<double>(spec.bins) / (spec.max - spec.min);
+        withBankType(bank.type, [&](auto tag) {
+            using T = decltype(tag);
+            size_t first, count;
+            select(histogram->source, bank, sizeof(T), first, count);
+            fillBins<T>(bank.data, first, histogram->source.channels, count, spec.min, scale, spec.bins,
+                        histogram->counts.data(), histogram->sum);
+            histogram->entries += count;
+        });
+    }
+
+    for (auto& window : windows) {
+        if (!wanted(window->source)) {
+            continue;
+        }
+        BankSpan bank = view.findBank(window->source.bank);
+        if (bank.data == nullptr) {
+            continue;
+        }
+        withBankType(bank.type, [&](auto tag) {
+            using T = decltype(tag);
+            size_t first, count;
+            select(window->source, bank, sizeof(T), first, count);
+            double sum = sumValues<T>(bank.data, first, window->source.channels, count);
+            window->buckets.add(timeNs, count, sum);
+            window->runCount += count;
+            window->runSum += sum;
+        });
+    }
+}
+
+bool AggregateEngine::histogram(const std::string& name, HistogramSnapshot& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& histogram : histograms) {
+        if (histogram->spec.name == name) {
+            out.name = name;
+            out.runNumber = runNumber;
+            out.min = histogram->spec.min;
+            out.max = histogram->spec.max;
+            out.counts.assign(histogram->counts.begin() + 1, histogram->counts.end() - 1);
+            out.underflow = histogram->counts.front();
+            out.overflow = histogram->counts.back();
+            out.entries = histogram->entries;
+            out.sum = histogram->sum;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AggregateEngine::window(const std::string& name, WindowSnapshot& out) const {
+    const int64_t nowNs = toNs(std::chrono::system_clock::now());
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& window : windows) {
+        if (window->spec.name == name) {
+            double seconds;
+            out.name = name;
+            out.runNumber = runNumber;
+            out.window = window->spec.window;
+            window->buckets.total(nowNs, runStartNs, out.count, out.sum, seconds);
+            out.mean = out.count > 0 ? out.sum / static_cast<double>(out.count) : 0;
+            out.runCount = window->runCount;
+            out.runSum = window->runSum;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<EventRate> AggregateEngine::eventRates() const {
+    const int64_t nowNs = toNs(std::chrono::system_clock::now());
+    std::vector<EventRate> result;
+    std::lock_guard<std::mutex> lock(mutex);
+    result.reserve(rates.size());
+    for (const auto& [eventId, rate] : rates) {
+        uint64_t count;
+        double sum, seconds;
+        rate.buckets.total(nowNs, runStartNs, count, sum, seconds);
+        EventRate entry;
+        entry.eventId = eventId;
+        entry.runEvents = rate.runEvents;
+        entry.perSecond = seconds > 0 ? static_cast<double>(count) / seconds : 0;
+        result.push_back(entry);
+    }
+    std::sort(result.begin(), result.end(), [](const EventRate& a, const EventRate& b) { return a.eventId < b.eventId; });
+    return result;
+}
+
+AggregateStats AggregateEngine::stats() const {
+    AggregateStats result;
+    std::lock_guard<std::mutex> lock(mutex);
+    result.runNumber = runNumber;
+    result.processedEvents = processedEvents;
+    result.lateEvents = lateEvents;
+    if (subscription) {
+        result.droppedEvents = subscription->stats().droppedOldest;
+    }
+    return result;
+}
@@ -0,0 +1,328 @@
+#include "ColdStore.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include <zlib.h>
+
+#include "midas.h"
+
+static int64_t toNs(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+ColdStore::ColdStore(const ColdTierPolicy& policy, std::chrono::milliseconds maxAge,
+                     std::shared_ptr<EventPool> pool, EventJournal* overflow)
+    : policy(policy), maxAge(maxAge), pool(std::move(pool)), overflow(overflow) {
+    if (this->policy.batchEvents == 0) {
+        this->policy.batchEvents = 1;
+    }
+    worker = std::thread(&ColdStore::run, this);
+}
+
+ColdStore::~ColdStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+void ColdStore::add(std::shared_ptr<TimedEvent> event) {
+    bool batchReady;
+    bool startedShedding = false;
+    std::vector<std::shared_ptr<TimedEvent>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingBytes += event->size();
+        nextSequence = event->sequence + 1;
+        pending.push_back(std::move(event));
+        batchReady = pending.size() == policy.batchEvents;
+
+        // The compressor is behind: drop the oldest events it has not taken,
+        // keeping the newest
+        while (pendingBytes > policy.maxPendingBytes && pending.size() > compressing + 1) {
+            auto it = pending.begin() + static_cast<std::ptrdiff_t>(compressing);
+            pendingBytes -= (*it)->size();
+            droppedBytes += (*it)->size();
+            droppedEvents++;
+            dropped.push_back(std::move(*it));
+            pending.erase(it);
+        }
+        if (!dropped.empty() && !shedding) {
+            shedding = startedShedding = true;
+        }
+    }
+    if (batchReady) {
+        cv.notify_one();
+    }
+    if (startedShedding) {
+        cm_msg(MERROR, "ColdStore::add",
+               "Events arrive faster than they can be compressed; dropping the oldest beyond %zu pending bytes",
+               policy.maxPendingBytes);
+    }
+    // Pooled storage goes back outside the lock
+}
+
+// Background thread: compress full batches, or whatever is pending once a
+// second so a slow trickle still gets compressed, then apply the limits
+void ColdStore::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        cv.wait_for(lock, std::chrono::seconds(1),
+                    [this] { return stopping || pending.size() >= policy.batchEvents; });
+        if (stopping) {
+            break;
+        }
+
+        if (!pending.empty()) {
+            size_t n = std::min(policy.batchEvents, pending.size());
+            std::vector<std::shared_ptr<TimedEvent>> batch(pending.begin(), pending.begin() + n);
+            compressing = n;
+            lock.unlock();
+
+            auto block = compress(batch);
+
+            lock.lock();
+            if (block) {
+                blocks.push_back(block);
+                compressedBytes += block->compressed.size();
+                rawBytes += block->rawBytes;
+                compressedEvents += n;
+                blockCount++;
+            }
+            // Without a block the batch is lost; compress() has logged why
+            for (size_t i = 0; i < n; ++i) {
+                pendingBytes -= pending.front()->size();
+                pending.pop_front();
+            }
+            compressing = 0;
+            if (pendingBytes < policy.maxPendingBytes / 2) {
+                shedding = false;
+            }
+            lock.unlock();
+            batch.clear(); // Pooled storage goes back outside the lock
+            lock.lock();
+        }
+
+        lock.unlock();
+        dropExpired();
+        lock.lock();
+    }
+}
+
+std::shared_ptr<const ColdStore::Block> ColdStore::compress(
+    const std::vector<std::shared_ptr<TimedEvent>>& batch) const {
+    size_t total = 0;
+    for (const auto& event : batch) {
+        total += sizeof(RecordHeader) + event->size();
+    }
+
+    std::vector<char> raw(total);
+    size_t offset = 0;
+    for (const auto& event : batch) {
+        RecordHeader header{static_cast<uint32_t>(event->size()), 0, event->sequence, toNs(event->timestamp)};
+        std::memcpy(raw.data() + offset, &header, sizeof(header));
+        std::memcpy(raw.data() + offset + sizeof(header), event->raw.data(), event->size());
+        offset += sizeof(header) + event->size();
+    }
+
+    auto block = std::make_shared<Block>();
+    block->firstSequence = batch.front()->sequence;
+    block->endSequence = batch.back()->sequence + 1;
+    block->lastTimestampNs = toNs(batch.back()->timestamp);
+    block->rawBytes = total;
+
+    uLongf compressedSize = compressBound(static_cast<uLong>(total));
+    block->compressed.resize(compressedSize);
+    int result = compress2(block->compressed.data(), &compressedSize,
+                           reinterpret_cast<const Bytef*>(raw.data()), static_cast<uLong>(total),
+                           policy.compressionLevel);
+    if (result != Z_OK) {
+        cm_msg(MERROR, "ColdStore::compress", "zlib compress2 failed: %d; %zu events dropped", result,
+               batch.size());
+        return nullptr;
+    }
+    block->compressed.resize(compressedSize);
+    block->compressed.shrink_to_fit();
+    return block;
+}
+
+// Drop blocks over the byte or age limit, oldest first. Each one is written
+// to the journal before it leaves, so readers always find it in one tier.
+void ColdStore::dropExpired() {
+    const int64_t oldestAllowed = maxAge.count() > 0 ? toNs(std::chrono::system_clock::now() - maxAge) : INT64_MIN;
+
+    while (true) {
+        std::shared_ptr<const Block> oldest;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (blocks.empty() ||
+                (compressedBytes + pendingBytes <= policy.maxBytes &&
+                 blocks.front()->lastTimestampNs >= oldestAllowed)) {
+                return;
+            }
+            oldest = blocks.front(); // Only this thread removes blocks
+        }
+
+        if (overflow != nullptr && overflow->isOpen()) {
+            if (Inflated data = inflate(oldest)) {
+                for (size_t offset = 0; offset < data->size();) {
+                    RecordHeader header;
+                    std::memcpy(&header, data->data() + offset, sizeof(header));
+                    auto timestamp = std::chrono::system_clock::time_point(
+                        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                            std::chrono::nanoseconds(header.timestampNs)));
+                    overflow->append(header.sequence, timestamp, data->data() + offset + sizeof(header),
+                                     header.size);
+                    offset += sizeof(header) + header.size;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        compressedBytes -= oldest->compressed.size();
+        rawBytes -= oldest->rawBytes;
+        compressedEvents -= oldest->endSequence - oldest->firstSequence;
+        blocks.pop_front();
+    }
+}
+
+ColdStore::Inflated ColdStore::inflate(const std::shared_ptr<const Block>& block) const {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (cachedBlock == block) {
+            return cachedData;
+        }
+    }
+
+    auto data = std::make_shared<std::vector<char>>(block->rawBytes);
+    uLongf size = static_cast<uLongf>(block->rawBytes);
+    int result = uncompress(reinterpret_cast<Bytef*>(data->data()), &size, block->compressed.data(),
+                            static_cast<uLong>(block->compressed.size()));
+    if (result != Z_OK || size != block->rawBytes) {
+        cm_msg(MERROR, "ColdStore::inflate", "zlib uncompress failed: %d", result);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cachedBlock = block;
+    cachedData = data;
+    return cachedData;
+}
+
+std::shared_ptr<TimedEvent> ColdStore::materialize(const RecordHeader& header, const char* bytes) const {
+    auto event = std::allocate_shared<TimedEvent>(PoolAllocator<TimedEvent>(pool));
+    event->timestamp = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(header.timestampNs)));
+    event->sequence = header.sequence;
+    event->raw = pool->acquire(header.size);
+    std::memcpy(event->raw.data(), bytes, header.size);
+    return event;
+}
+
+uint64_t ColdStore::firstSequence() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!blocks.empty()) {
+        return blocks.front()->firstSequence;
+    }
+    return pending.empty() ? nextSequence : pending.front()->sequence;
+}
+
+uint64_t ColdStore::endSequence() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextSequence;
+}
+
+uint64_t ColdStore::sequenceAfter(std::chrono::system_clock::time_point since) const {
+    const int64_t sinceNs = toNs(since);
+    std::shared_ptr<const Block> block;
+    uint64_t fallback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::partition_point(blocks.begin(), blocks.end(),
+                                       [sinceNs](const auto& b) { return b->lastTimestampNs <= sinceNs; });
+        if (it == blocks.end()) {
+            auto p = std::partition_point(pending.begin(), pending.end(),
+                                          [since](const auto& e) { return e->timestamp <= since; });
+            return p == pending.end() ? nextSequence : (*p)->sequence;
+        }
+        block = *it;
+        fallback = block->endSequence;
+    }
+
+    if (Inflated data = inflate(block)) {
+        for (size_t offset = 0; offset < data->size();) {
+            RecordHeader header;
+            std::memcpy(&header, data->data() + offset, sizeof(header));
+            if (header.timestampNs > sinceNs) {
+                return header.sequence;
+            }
+            offset += sizeof(header) + header.size;
+        }
+    }
+    return fallback;
+}
+
+std::vector<std::shared_ptr<TimedEvent>> ColdStore::read(uint64_t from, uint64_t to, size_t maxCount) const {
+    std::vector<std::shared_ptr<const Block>> hits;
+    std::vector<std::shared_ptr<TimedEvent>> uncompressed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t expected = 0;
+        auto it = std::partition_point(blocks.begin(), blocks.end(),
+                                       [from](const auto& b) { return b->endSequence <= from; });
+        for (; it != blocks.end() && (*it)->firstSequence < to && expected < maxCount; ++it) {
+            hits.push_back(*it);
+            expected += (*it)->endSequence - std::max(from, (*it)->firstSequence);
+        }
+        auto p = std::partition_point(pending.begin(), pending.end(),
+                                      [from](const auto& e) { return e->sequence < from; });
+        for (; p != pending.end() && (*p)->sequence < to && expected < maxCount; ++p) {
+            uncompressed.push_back(*p); // Still the original event; no copy needed
+            expected++;
+        }
+    }
+
+    std::vector<std::shared_ptr<TimedEvent>> events;
+    for (const auto& block : hits) {
+        Inflated data = inflate(block);
+        if (!data) {
+            continue;
+        }
+        for (size_t offset = 0; offset < data->size() && events.size() < maxCount;) {
+            RecordHeader header;
+            std::memcpy(&header, data->data() + offset, sizeof(header));
+            if (header.sequence >= to) {
+                break;
+            }
+            if (header.sequence >= from) {
+                events.push_back(materialize(header, data->data() + offset + sizeof(header)));
+            }
+            offset += sizeof(header) + header.size;
+        }
+    }
+    for (auto& event : uncompressed) {
+        if (events.size() >= maxCount) {
+            break;
+        }
+        events.push_back(std::move(event));
+    }
+    return events;
+}
+
+ColdStore::Usage ColdStore::usage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Usage u;
+    u.events = compressedEvents + pending.size();
+    u.compressedBytes = compressedBytes;
+    u.rawBytes = rawBytes;
+    u.pendingEvents = pending.size();
+    u.pendingBytes = pendingBytes;
+    u.blocks = blockCount;
+    u.droppedEvents = droppedEvents;
+    u.droppedBytes = droppedBytes;
+    return u;
+}
@@ -0,0 +1,379 @@
+#include "EventFileWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "midas.h"
+#include "midasio.h"
+
+static constexpr size_t kAlignment = 4096;
+static constexpr size_t kMinBufferBytes = 64 * 1024;
+static constexpr int kMaxPathAttempts = 1000; // Existing files skipped before giving up on a name
+
+// A file name pattern must take exactly the run number and the file index:
+// two int conversions (d, i, u, o, x, X, with flags, width and precision
+// but no '*' or length modifier) and nothing else but "%%"
+static bool validPattern(const std::string& pattern) {
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        if (++i < pattern.size() && pattern[i] == '%') {
+            continue;
+        }
+        while (i < pattern.size() && std::strchr("-+ #0'", pattern[i])) {
+            ++i;
+        }
+        while (i < pattern.size() && (std::isdigit(static_cast<unsigned char>(pattern[i])) || pattern[i] == '.')) {
+            ++i;
+        }
+        if (i >= pattern.size() || !std::strchr("diouxX", pattern[i])) {
+            return false;
+        }
+        ++conversions;
+    }
+    return conversions == 2;
+}
+
+static int64_t toNs(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+// Page-aligned, so the compressors and write() see whole pages
+std::unique_ptr<char, decltype(&std::free)> EventFileWriter::allocate(size_t bytes) {
+    void* p = nullptr;
+    if (posix_memalign(&p, kAlignment, bytes) != 0) {
+        p = nullptr;
+    }
+    return std::unique_ptr<char, decltype(&std::free)>(static_cast<char*>(p), &std::free);
+}
+
+EventFileWriter::EventFileWriter(const EventFileOptions& options) : options(options) {
+    if (!validPattern(options.pattern)) {
+        cm_msg(MERROR, "EventFileWriter::EventFileWriter",
+               "File name pattern \"%s\" must have exactly two integer conversions, for the run number and the "
+               "file index; no files will be written",
+               options.pattern.c_str());
+        return;
+    }
+    size_t bytes = std::max(options.bufferBytes, kMinBufferBytes);
+    bytes = (bytes + kAlignment - 1) & ~(kAlignment - 1);
+    memory = allocate(2 * bytes);
+    if (!memory) {
+        cm_msg(MERROR, "EventFileWriter::EventFileWriter", "Cannot allocate two %zu-byte write buffers", bytes);
+        return;
+    }
+    for (int i = 0; i < 2; ++i) {
+        buffers[i].data = memory.get() + i * bytes;
+        buffers[i].capacity = bytes;
+        idle.push_back(&buffers[i]);
+    }
+    if (mkdir(options.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        cm_msg(MERROR, "EventFileWriter::EventFileWriter", "Cannot create directory %s: %s",
+               options.directory.c_str(), strerror(errno));
+    }
+}
+
+EventFileWriter::~EventFileWriter() {
+    stop();
+}
+
+void EventFileWriter::start(std::shared_ptr<Subscription> events) {
+    if (packer.joinable() || !memory) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscription = events;
+        ioDone = false;
+    }
+    stopping = false;
+    io = std::thread(&EventFileWriter::ioLoop, this);
+    packer = std::thread(&EventFileWriter::packLoop, this, std::move(events));
+}
+
+void EventFileWriter::stop() {
+    if (!packer.joinable()) {
+        return;
+    }
+    stopping = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    subscription->close();
+    lock.unlock();
+    packer.join(); // Packs what is still queued and submits the last buffer
+    io.join();
+}
+
+void EventFileWriter::beginRun(int run, std::chrono::system_clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingRuns.push_back(PendingRun{true, run, toNs(at)});
+    runsPending.store(true, std::memory_order_release);
+}
+
+void EventFileWriter::endRun(std::chrono::system_clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingRuns.push_back(PendingRun{false, 0, toNs(at)});
+    runsPending.store(true, std::memory_order_release);
+}
+
+// ---- Packing thread ----
+
+void EventFileWriter::packLoop(std::shared_ptr<Subscription> events) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        filling = idle.front();
+        idle.pop_front();
+    }
+    const auto poll = std::min(options.flushInterval, std::chrono::milliseconds(100));
+    while (!stopping.load(std::memory_order_acquire)) {
+        auto batch = events->wait(1, poll, 1024);
+        if (batch.empty()) {
+            // Nothing queued from before a pending transition, as far as we
+            // can tell; stragglers still in the decode pipeline go to the next file
+            applyPendingRuns(INT64_MAX);
+        }
+        for (const auto& event : batch) {
+            pack(*event);
+        }
+        if (filling->used > 0 && std::chrono::steady_clock::now() - fillStarted >= options.flushInterval) {
+            submit();
+        }
+    }
+
+    for (const auto& event : events->poll()) {
+        pack(*event);
+    }
+    applyPendingRuns(INT64_MAX);
+    closeFile();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(filling);
+        filling = nullptr;
+        ioDone = true;
+    }
+    cv.notify_all();
+}
+
+// Copy one event into the write buffers, rotating files as needed. Events
+// bigger than what is left of a buffer continue in the next one; the file
+// is a byte stream, so where a write ends does not matter.
+void EventFileWriter::pack(const TimedEvent& event) {
+    const int64_t timeNs = toNs(event.timestamp);
+    if (runsPending.load(std::memory_order_acquire)) {
+        applyPendingRuns(timeNs);
+    }
+
+    if (noFile) {
+        unwrittenEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const size_t size = event.size();
+    if (!path.empty() && options.maxFileBytes > 0 && fileBytes > 0 && fileBytes + size > options.maxFileBytes) {
+        closeFile();
+    }
+    if (path.empty()) {
+        path = nextPath();
+        if (path.empty()) {
+            noFile = true; // Until the next run transition
+            unwrittenEvents.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    if (filling->used == filling->capacity) {
+        submit();
+    }
+    if (filling->used == 0) {
+        fillStarted = std::chrono::steady_clock::now();
+        filling->oldestNs = timeNs;
+    }
+
+    const char* bytes = event.raw.data();
+    size_t left = size;
+    while (left > 0) {
+        size_t n = std::min(left, filling->capacity - filling->used);
+        std::memcpy(filling->data + filling->used, bytes, n);
+        filling->used += n;
+        bytes += n;
+        left -= n;
+        if (left > 0) {
+            submit();
+            filling->oldestNs = timeNs;
+        }
+    }
+    filling->events++; // Counted where it ends, once all of it is written
+    fileBytes += size;
+}
+
+// Apply the transitions stamped at or before beforeNs
+void EventFileWriter::applyPendingRuns(int64_t beforeNs) {
+    std::vector<PendingRun> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!pendingRuns.empty() && pendingRuns.front().atNs <= beforeNs) {
+            due.push_back(pendingRuns.front());
+            pendingRuns.pop_front();
+        }
+        runsPending.store(!pendingRuns.empty(), std::memory_order_relaxed);
+    }
+    for (const auto& run : due) {
+        closeFile();
+        noFile = false;
+        if (run.start) {
+            runNumber = run.runNumber;
+            fileIndex = 0;
+        }
+    }
+}
+
+// Finish the current file: its last buffer goes out marked for closing
+void EventFileWriter::closeFile() {
+    if (path.empty()) {
+        return;
+    }
+    filling->closeAfter = true;
+    submit();
+    path.clear();
+    fileBytes = 0;
+}
+
+// Next file name of the current run that does not exist yet; empty, after
+// reporting it, when there is none
+std::string EventFileWriter::nextPath() {
+    for (int attempt = 0; attempt < kMaxPathAttempts; ++attempt) {
+        char name[1024];
+        int length = std::snprintf(name, sizeof(name), options.pattern.c_str(), runNumber, fileIndex++);
+        if (length < 0 || static_cast<size_t>(length) >= sizeof(name)) {
+            cm_msg(MERROR, "EventFileWriter::nextPath", "File name pattern \"%s\" gives a name too long for run %d",
+                   options.pattern.c_str(), runNumber);
+            writeErrors.fetch_add(1, std::memory_order_relaxed);
+            return std::string();
+        }
+        std::string candidate = options.directory + "/" + name;
+        struct stat st;
+        if (stat(candidate.c_str(), &st) != 0) {
+            return candidate;
+        }
+    }
+    cm_msg(MERROR, "EventFileWriter::nextPath",
+           "No free file name for run %d in %s after %d tries; its events are not written until the next run",
+           runNumber, options.directory.c_str(), kMaxPathAttempts);
+    writeErrors.fetch_add(1, std::memory_order_relaxed);
+    return std::string();
+}
+
+// Hand the filling buffer to the I/O thread and take the other one, waiting
+// if it is still being written
+void EventFileWriter::submit() {
+    filling->path = path;
+    std::unique_lock<std::mutex> lock(mutex);
+    toWrite.push_back(filling);
+    cv.notify_all();
+    if (idle.empty()) {
+        bufferWaits.fetch_add(1, std::memory_order_relaxed);
+        cv.wait(lock, [this] { return !idle.empty(); });
+    }
+    filling = idle.front();
+    idle.pop_front();
+    lock.unlock();
+
+    filling->used = 0;
+    filling->events = 0;
+    filling->closeAfter = false;
+}
+
+// ---- I/O thread ----
+
+void EventFileWriter::ioLoop() {
+    std::unique_ptr<TMWriterInterface> writer;
+    bool failed = false; // The current file has had an error; logged once
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this] { return !toWrite.empty() || ioDone; });
+        if (toWrite.empty()) {
+            break;
+        }
+        Buffer* buffer = toWrite.front();
+        lock.unlock();
+
+        if (buffer->used > 0) {
+            if (!writer || buffer->path != openPath) {
+                if (writer) {
+                    writer->Close();
+                }
+                writer.reset(TMNewWriter(buffer->path.c_str()));
+                failed = false;
+                files.fetch_add(1, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> guard(mutex);
+                openPath = buffer->path;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            int written = writer ? writer->Write(buffer->data, static_cast<int>(buffer->used)) : -1;
+            auto end = std::chrono::steady_clock::now();
+            writeTime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            if (written == static_cast<int>(buffer->used)) {
+                writtenEvents.fetch_add(buffer->events, std::memory_order_relaxed);
+                writtenBytes.fetch_add(buffer->used, std::memory_order_relaxed);
+                if (buffer->events > 0) { // Not just the middle of a large event
+                    int64_t waited = toNs(std::chrono::system_clock::now()) - buffer->oldestNs;
+                    eventToFile.record(waited > 0 ? static_cast<uint64_t>(waited) : 0);
+                }
+            } else {
+                writeErrors.fetch_add(1, std::memory_order_relaxed);
+                if (!failed) {
+                    cm_msg(MERROR, "EventFileWriter::ioLoop", "Cannot write %zu bytes to %s: %s", buffer->used,
+                           buffer->path.c_str(), writer ? strerror(errno) : "cannot open file");
+                    failed = true;
+                }
+            }
+        }
+        if (buffer->closeAfter && writer) {
+            writer->Close();
+            writer.reset();
+            std::lock_guard<std::mutex> guard(mutex);
+            openPath.clear();
+        }
+
+        lock.lock();
+        toWrite.pop_front();
+        idle.push_back(buffer);
+        cv.notify_all();
+    }
+    lock.unlock();
+
+    if (writer) {
+        writer->Close();
+        std::lock_guard<std::mutex> guard(mutex);
+        openPath.clear();
+    }
+}
+
+EventFileStats EventFileWriter::stats() const {
+    EventFileStats s;
+    s.files = files.load(std::memory_order_relaxed);
+    s.writtenEvents = writtenEvents.load(std::memory_order_relaxed);
+    s.writtenBytes = writtenBytes.load(std::memory_order_relaxed);
+    s.writeErrors = writeErrors.load(std::memory_order_relaxed);
+    s.bufferWaits = bufferWaits.load(std::memory_order_relaxed);
+    s.writeTime = writeTime.summary();
+    s.eventToFile = eventToFile.summary();
+    std::lock_guard<std::mutex> lock(mutex);
+    s.currentFile = openPath;
+    if (subscription) {
+        SubscriptionStats queue = subscription->stats();
+        s.droppedEvents = queue.droppedOldest + queue.droppedNewest;
+    }
+    s.droppedEvents += unwrittenEvents.load(std::memory_order_relaxed);
+    return s;
+}
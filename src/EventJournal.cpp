@@ -0,0 +1,256 @@
+#include "EventJournal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "midas.h"
+
+static const char* kSegmentSuffix = ".journal";
+
+static size_t alignRecord(size_t bytes) {
+    return (bytes + 7) & ~size_t(7);
+}
+
+static int64_t toNs(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+struct EventJournal::Segment {
+    std::string path;
+    char* base = nullptr;
+    size_t capacity = 0;
+    uint64_t firstSequence = 0;
+
+    // Published by the appender after each record; readers stop at `used`
+    std::atomic<size_t> used{0};
+    std::atomic<uint64_t> endSequence{0};
+    std::atomic<int64_t> lastTimestampNs{INT64_MIN};
+    size_t records = 0; // Appender only
+
+    std::mutex indexMutex;
+    std::vector<IndexEntry> index;
+
+    ~Segment() {
+        if (base != nullptr) {
+            munmap(base, capacity);
+        }
+    }
+
+    // Offset of the last indexed record at or before the sequence
+    size_t seekSequence(uint64_t sequence) {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        auto it = std::upper_bound(index.begin(), index.end(), sequence,
+                                   [](uint64_t s, const IndexEntry& e) { return s < e.sequence; });
+        return it == index.begin() ? 0 : std::prev(it)->offset;
+    }
+
+    // Offset of the last indexed record at or before the time
+    size_t seekTime(int64_t timestampNs) {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        auto it = std::upper_bound(index.begin(), index.end(), timestampNs,
+                                   [](int64_t t, const IndexEntry& e) { return t < e.timestampNs; });
+        return it == index.begin() ? 0 : std::prev(it)->offset;
+    }
+
+    RecordHeader headerAt(size_t offset) const {
+        RecordHeader header;
+        std::memcpy(&header, base + offset, sizeof(header));
+        return header;
+    }
+};
+
+EventJournal::EventJournal(const std::string& directory, size_t segmentBytes, size_t maxBytes,
+                           std::shared_ptr<EventPool> pool)
+    : directory(directory), segmentBytes(alignRecord(segmentBytes)), maxBytes(maxBytes), pool(std::move(pool)) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        cm_msg(MERROR, "EventJournal::EventJournal", "Cannot create journal directory %s: %s", directory.c_str(),
+               std::strerror(errno));
+        return;
+    }
+
+    // Leftovers from an earlier process are not ours to serve
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            size_t suffix = std::strlen(kSegmentSuffix);
+            if (name.size() > suffix && name.compare(name.size() - suffix, suffix, kSegmentSuffix) == 0) {
+                unlink((directory + "/" + name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    open = true;
+}
+
+EventJournal::~EventJournal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& segment : segments) {
+        unlink(segment->path.c_str());
+    }
+    segments.clear();
+}
+
+std::shared_ptr<EventJournal::Segment> EventJournal::openSegment(uint64_t firstSequence, size_t minBytes) {
+    auto segment = std::make_shared<Segment>();
+    char name[64];
+    std::snprintf(name, sizeof(name), "/segment-%020llu%s", static_cast<unsigned long long>(firstSequence),
+                  kSegmentSuffix);
+    segment->path = directory + name;
+    segment->capacity = std::max(segmentBytes, minBytes);
+    segment->firstSequence = firstSequence;
+    segment->endSequence = firstSequence;
+
+    int fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        cm_msg(MERROR, "EventJournal::openSegment", "Cannot create %s: %s", segment->path.c_str(),
+               std::strerror(errno));
+        return nullptr;
+    }
+    // Reserve the blocks now: running out of disk later would be a SIGBUS
+    int err = posix_fallocate(fd, 0, static_cast<off_t>(segment->capacity));
+    if (err != 0) {
+        cm_msg(MERROR, "EventJournal::openSegment", "Cannot allocate %zu bytes for %s: %s", segment->capacity,
+               segment->path.c_str(), std::strerror(err));
+        close(fd);
+        unlink(segment->path.c_str());
+        return nullptr;
+    }
+    void* base = mmap(nullptr, segment->capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        cm_msg(MERROR, "EventJournal::openSegment", "Cannot map %s: %s", segment->path.c_str(),
+               std::strerror(errno));
+        unlink(segment->path.c_str());
+        return nullptr;
+    }
+    segment->base = static_cast<char*>(base);
+    return segment;
+}
+
+void EventJournal::append(const TimedEvent& event) {
+    append(event.sequence, event.timestamp, event.raw.data(), event.size());
+}
+
+void EventJournal::append(uint64_t sequence, std::chrono::system_clock::time_point timestamp, const void* bytes,
+                          size_t size) {
+    if (!isOpen()) {
+        return;
+    }
+    size_t recordBytes = alignRecord(sizeof(RecordHeader) + size);
+
+    std::shared_ptr<Segment> segment;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!segments.empty()) {
+            segment = segments.back();
+        }
+    }
+
+    if (!segment || segment->used.load(std::memory_order_relaxed) + recordBytes > segment->capacity) {
+        segment = openSegment(sequence, recordBytes);
+        if (!segment) {
+            open = false; // Stop trying; queries still serve what is already on disk
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        segments.push_back(segment);
+        size_t total = totalBytes.load(std::memory_order_relaxed) + segment->capacity;
+        // Roll off the oldest segments; readers still using one keep it mapped
+        while (total > maxBytes && segments.size() > 1) {
+            unlink(segments.front()->path.c_str());
+            total -= segments.front()->capacity;
+            segments.pop_front();
+        }
+        totalBytes.store(total, std::memory_order_relaxed);
+    }
+
+    size_t offset = segment->used.load(std::memory_order_relaxed);
+    int64_t timestampNs = toNs(timestamp);
+    RecordHeader header{static_cast<uint32_t>(size), 0, sequence, timestampNs};
+    std::memcpy(segment->base + offset, &header, sizeof(header));
+    std::memcpy(segment->base + offset + sizeof(header), bytes, size);
+
+    if (segment->records++ % kIndexStride == 0) {
+        std::lock_guard<std::mutex> lock(segment->indexMutex);
+        segment->index.push_back({sequence, timestampNs, offset});
+    }
+
+    segment->used.store(offset + recordBytes, std::memory_order_release);
+    segment->lastTimestampNs.store(timestampNs, std::memory_order_release);
+    segment->endSequence.store(sequence + 1, std::memory_order_release);
+}
+
+std::vector<std::shared_ptr<EventJournal::Segment>> EventJournal::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<std::shared_ptr<Segment>>(segments.begin(), segments.end());
+}
+
+uint64_t EventJournal::firstSequence() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments.empty() ? 0 : segments.front()->firstSequence;
+}
+
+uint64_t EventJournal::endSequence() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments.empty() ? 0 : segments.back()->endSequence.load(std::memory_order_acquire);
+}
+
+uint64_t EventJournal::sequenceAfter(std::chrono::system_clock::time_point since) const {
+    int64_t sinceNs = toNs(since);
+    auto segs = snapshot();
+    for (const auto& segment : segs) {
+        if (segment->lastTimestampNs.load(std::memory_order_acquire) <= sinceNs) {
+            continue;
+        }
+        size_t used = segment->used.load(std::memory_order_acquire);
+        for (size_t offset = segment->seekTime(sinceNs); offset < used;) {
+            RecordHeader header = segment->headerAt(offset);
+            if (header.timestampNs > sinceNs) {
+                return header.sequence;
+            }
+            offset += alignRecord(sizeof(header) + header.size);
+        }
+    }
+    return segs.empty() ? 0 : segs.back()->endSequence.load(std::memory_order_acquire);
+}
+
+std::vector<std::shared_ptr<TimedEvent>> EventJournal::read(uint64_t from, uint64_t to, size_t maxCount) const {
+    std::vector<std::shared_ptr<TimedEvent>> events;
+    for (const auto& segment : snapshot()) {
+        if (segment->endSequence.load(std::memory_order_acquire) <= from) {
+            continue;
+        }
+        if (segment->firstSequence >= to || events.size() >= maxCount) {
+            break;
+        }
+
+        size_t used = segment->used.load(std::memory_order_acquire);
+        for (size_t offset = segment->seekSequence(from); offset < used && events.size() < maxCount;) {
+            RecordHeader header = segment->headerAt(offset);
+            if (header.sequence >= to) {
+                return events;
+            }
+            if (header.sequence >= from) {
+                auto event = std::allocate_shared<TimedEvent>(PoolAllocator<TimedEvent>(pool));
+                event->timestamp = std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                        std::chrono::nanoseconds(header.timestampNs)));
+                event->sequence = header.sequence;
+                event->raw = pool->acquire(header.size);
+                std::memcpy(event->raw.data(), segment->base + offset + sizeof(header), header.size);
+                events.push_back(std::move(event));
+            }
+            offset += alignRecord(sizeof(header) + header.size);
+        }
+    }
+    return events;
+}
@@ -0,0 +1,155 @@
+#include "EventPipeline.h"
+
+EventPipeline::EventPipeline(size_t workerCount, size_t stagingCapacity, std::vector<Handler> handlers,
+                             Publisher publisher)
+    : handlers(std::move(handlers)), publisher(std::move(publisher)) {
+    size_t capacity = 1;
+    while (capacity < stagingCapacity) {
+        capacity <<= 1;
+    }
+    slots = std::vector<Slot>(capacity);
+    mask = capacity - 1;
+
+    for (size_t i = 0; i < (workerCount > 0 ? workerCount : 1); ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->queue.resize(capacity);
+        workers.push_back(std::move(worker));
+    }
+}
+
+EventPipeline::~EventPipeline() {
+    stop();
+}
+
+void EventPipeline::start() {
+    stopping = false;
+    for (auto& worker : workers) {
+        if (!worker->thread.joinable()) {
+            Worker* w = worker.get();
+            worker->thread = std::thread([this, w] { workerLoop(*w); });
+        }
+    }
+}
+
+void EventPipeline::stop() {
+    // Everything staged so far still gets published
+    while (true) {
+        bool drained = false;
+        runExclusive([&] { drained = commitSeq == stageSeq; });
+        if (drained || !workers.front()->thread.joinable()) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+
+    stopping = true;
+    for (auto& worker : workers) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+        worker->cv.notify_all();
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void EventPipeline::submit(std::shared_ptr<TimedEvent> event) {
+    Slot& slot = slots[stageSeq & mask];
+
+    // Staging full: the oldest event is still being decoded or waiting to publish
+    if (slot.state.load(std::memory_order_acquire) != Empty) {
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        while (slot.state.load(std::memory_order_acquire) != Empty) {
+            std::this_thread::yield();
+        }
+    }
+
+    Worker& worker = *workers[event->header()->event_id % workers.size()];
+    slot.event = std::move(event);
+    slot.state.store(Staged, std::memory_order_release);
+
+    uint64_t tail = worker.tail.load(std::memory_order_relaxed);
+    worker.queue[tail & mask] = stageSeq;
+    worker.tail.store(tail + 1, std::memory_order_seq_cst);
+    ++stageSeq;
+
+    // Only pay for the futex when the worker has actually gone to sleep
+    if (worker.sleeping.load(std::memory_order_seq_cst)) {
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+        }
+        worker.cv.notify_one();
+    }
+}
+
+void EventPipeline::workerLoop(Worker& worker) {
+    int idleSpins = 0;
+    while (true) {
+        uint64_t head = worker.head.load(std::memory_order_relaxed);
+        if (head == worker.tail.load(std::memory_order_acquire)) {
+            if (stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            if (++idleSpins < 64) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.sleeping.store(true, std::memory_order_seq_cst);
+            worker.cv.wait(lock, [&] {
+                return worker.tail.load(std::memory_order_seq_cst) != head || stopping.load();
+            });
+            worker.sleeping.store(false, std::memory_order_relaxed);
+            idleSpins = 0;
+            continue;
+        }
+        idleSpins = 0;
+
+        uint64_t seq = worker.queue[head & mask];
+        worker.head.store(head + 1, std::memory_order_release);
+
+        Slot& slot = slots[seq & mask];
+        const TimedEvent& event = *slot.event;
+        event.view().banks(); // Build the shared bank index off the ingest thread
+        for (const auto& handler : handlers) {
+            handler(event);
+        }
+        slot.state.store(Done, std::memory_order_seq_cst);
+
+        // Publish this event and any finished ones after it, unless another
+        // worker is already doing so (it will pick ours up before it lets go)
+        if (tryBecomeCommitter()) {
+            commitReady();
+            releaseCommitter();
+        }
+    }
+}
+
+// Publish consecutive finished events in staging order; caller is the committer
+void EventPipeline::commitReady() {
+    while (true) {
+        Slot& slot = slots[commitSeq & mask];
+        if (slot.state.load(std::memory_order_acquire) != Done) {
+            return;
+        }
+        publisher(std::move(slot.event));
+        slot.event.reset();
+        slot.state.store(Empty, std::memory_order_release);
+        ++commitSeq;
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Give up the committer role, re-taking it if an event finished in the
+// window where another worker saw us holding it and backed off
+void EventPipeline::releaseCommitter() {
+    while (true) {
+        uint64_t next = commitSeq; // Not ours to read once released
+        committing.store(false, std::memory_order_seq_cst);
+        if (slots[next & mask].state.load(std::memory_order_seq_cst) != Done || !tryBecomeCommitter()) {
+            return;
+        }
+        commitReady();
+    }
+}
@@ -0,0 +1,183 @@
+#include "EventPool.h"
+
+#include <new>
+
+// ---- PooledBuffer ----
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : pool_(other.pool_), data_(other.data_), size_(other.size_), sizeClass_(other.sizeClass_) {
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        size_ = other.size_;
+        sizeClass_ = other.sizeClass_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer() {
+    reset();
+}
+
+void PooledBuffer::reset() {
+    if (data_ != nullptr) {
+        pool_->give(sizeClass_, data_);
+        pool_ = nullptr;
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+size_t PooledBuffer::capacity() const {
+    return data_ != nullptr ? pool_->blockSizeFor(size_) : 0;
+}
+
+// ---- EventPool ----
+
+EventPool::EventPool(size_t maxBlockSize, size_t maxCachedBytes)
+    : maxCachedBytes_(maxCachedBytes) {
+    // Power-of-two classes; the last one is capped at maxBlockSize exactly
+    size_t blockSize = kMinBlockSize;
+    while (true) {
+        auto sc = std::make_unique<SizeClass>();
+        sc->blockSize = blockSize < maxBlockSize ? blockSize : maxBlockSize;
+        sc->fromSlab = sc->blockSize <= kMaxSlabBlockSize;
+        classes_.push_back(std::move(sc));
+        if (blockSize >= maxBlockSize) {
+            break;
+        }
+        blockSize <<= 1;
+    }
+    // Anything larger than maxBlockSize is allocated exactly and never cached
+    oversizeClass_ = static_cast<unsigned>(classes_.size());
+}
+
+EventPool::~EventPool() {
+    for (auto& sc : classes_) {
+        if (!sc->fromSlab) {
+            for (char* block : sc->freeBlocks) {
+                ::operator delete(block, std::align_val_t(kAlignment));
+            }
+        }
+    }
+    for (char* slab : slabs_) {
+        ::operator delete(slab, std::align_val_t(kAlignment));
+    }
+}
+
+unsigned EventPool::classFor(size_t size) const {
+    unsigned c = 0;
+    while (c < classes_.size() && classes_[c]->blockSize < size) {
+        ++c;
+    }
+    return c;
+}
+
+size_t EventPool::blockSizeFor(size_t size) const {
+    unsigned c = classFor(size);
+    return c == oversizeClass_ ? size : classes_[c]->blockSize;
+}
+
+PooledBuffer EventPool::acquire(size_t size) {
+    unsigned c = classFor(size);
+    if (c == oversizeClass_) {
+        heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+        char* block = static_cast<char*>(::operator new(size, std::align_val_t(kAlignment)));
+        return PooledBuffer(this, block, size, c);
+    }
+    return PooledBuffer(this, take(c), size, c);
+}
+
+void* EventPool::allocate(size_t size) {
+    unsigned c = classFor(size);
+    if (c == oversizeClass_) {
+        heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size, std::align_val_t(kAlignment));
+    }
+    return take(c);
+}
+
+void EventPool::deallocate(void* p, size_t size) {
+    unsigned c = classFor(size);
+    if (c == oversizeClass_) {
+        ::operator delete(p, std::align_val_t(kAlignment));
+        return;
+    }
+    give(c, static_cast<char*>(p));
+}
+
+char* EventPool::take(unsigned sizeClass) {
+    SizeClass& sc = *classes_[sizeClass];
+    std::lock_guard<std::mutex> lock(sc.mutex);
+
+    if (sc.freeBlocks.empty()) {
+        if (sc.fromSlab) {
+            refillFromSlab(sc);
+        } else {
+            heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+            reservedBytes_.fetch_add(sc.blockSize, std::memory_order_relaxed);
+            return static_cast<char*>(::operator new(sc.blockSize, std::align_val_t(kAlignment)));
+        }
+    }
+
+    char* block = sc.freeBlocks.back();
+    sc.freeBlocks.pop_back();
+    cachedBytes_.fetch_sub(sc.blockSize, std::memory_order_relaxed);
+    if (!sc.fromSlab) {
+        cachedLargeBytes_.fetch_sub(sc.blockSize, std::memory_order_relaxed);
+    }
+    return block;
+}
+
+void EventPool::give(unsigned sizeClass, char* block) {
+    if (sizeClass == oversizeClass_) {
+        ::operator delete(block, std::align_val_t(kAlignment));
+        return;
+    }
+
+    SizeClass& sc = *classes_[sizeClass];
+
+    // Slab blocks always go back on the free list; large blocks only while
+    // the idle cache has room, otherwise the memory is handed back
+    if (!sc.fromSlab) {
+        if (cachedLargeBytes_.fetch_add(sc.blockSize, std::memory_order_relaxed) + sc.blockSize > maxCachedBytes_) {
+            cachedLargeBytes_.fetch_sub(sc.blockSize, std::memory_order_relaxed);
+            reservedBytes_.fetch_sub(sc.blockSize, std::memory_order_relaxed);
+            ::operator delete(block, std::align_val_t(kAlignment));
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(sc.mutex);
+    sc.freeBlocks.push_back(block);
+    cachedBytes_.fetch_add(sc.blockSize, std::memory_order_relaxed);
+}
+
+// Carve a fresh slab into blocks of this class (called with sc.mutex held)
+void EventPool::refillFromSlab(SizeClass& sc) {
+    size_t slabSize = sc.blockSize > kSlabSize ? sc.blockSize : kSlabSize;
+    char* slab = static_cast<char*>(::operator new(slabSize, std::align_val_t(kAlignment)));
+    heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+    reservedBytes_.fetch_add(slabSize, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(slabMutex_);
+        slabs_.push_back(slab);
+    }
+
+    size_t count = slabSize / sc.blockSize;
+    sc.freeBlocks.reserve(sc.freeBlocks.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        sc.freeBlocks.push_back(slab + i * sc.blockSize);
+    }
+    cachedBytes_.fetch_add(count * sc.blockSize, std::memory_order_relaxed);
+}
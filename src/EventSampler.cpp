@@ -0,0 +1,177 @@
+#include "EventSampler.h"
+
+#include <algorithm>
+#include <numeric>
+
+EventSampler::EventSampler(const std::vector<SamplingRule>& rules) : rules(rules), slots(65536, 0) {
+    for (auto& rule : this->rules) {
+        rule.burst = std::max(rule.burst, 1.0);
+        if (rule.window.count() <= 0) {
+            rule.window = std::chrono::milliseconds(1000);
+        }
+    }
+    for (const auto& rule : this->rules) {
+        if (rule.eventID == EVENTID_ALL) {
+            defaultRule = &rule;
+            break;
+        }
+    }
+}
+
+EventSampler::State& EventSampler::stateFor(uint16_t eventId) {
+    uint32_t slot = slots[eventId];
+    if (slot != 0) {
+        return states[slot - 1];
+    }
+
+    const SamplingRule* rule = defaultRule;
+    for (const auto& candidate : rules) {
+        if (candidate.eventID != EVENTID_ALL && static_cast<uint16_t>(candidate.eventID) == eventId) {
+            rule = &candidate;
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    states.emplace_back();
+    State& state = states.back();
+    state.eventId = eventId;
+    state.rule = rule;
+    auto now = std::chrono::steady_clock::now();
+    if (rule && rule->mode == SamplingMode::RateLimit) {
+        state.tokens = rule->burst;
+        state.refilled = now;
+    } else if (rule && rule->mode == SamplingMode::Reservoir) {
+        state.windowEnd = now + rule->window;
+        state.reservoir.reserve(rule->reservoirSize);
+        state.arrival.reserve(rule->reservoirSize);
+        reservoirStates.push_back(&state);
+    }
+    slots[eventId] = static_cast<uint32_t>(states.size());
+    return state;
+}
+
+EventSampler::Decision EventSampler::admit(uint16_t eventId, std::shared_ptr<TimedEvent>*& slot) {
+    State& state = stateFor(eventId);
+    bump(state.seen);
+
+    const SamplingRule* rule = state.rule;
+    bool keep = true;
+    if (rule == nullptr) {
+        keep = true;
+    } else if (rule->mode == SamplingMode::Prescale) {
+        keep = rule->prescale > 0 && state.counter++ % rule->prescale == 0;
+    } else if (rule->mode == SamplingMode::RateLimit) {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - state.refilled).count();
+        state.refilled = now;
+        state.tokens = std::min(rule->burst, state.tokens + elapsed * rule->ratePerSecond);
+        keep = state.tokens >= 1.0;
+        if (keep) {
+            state.tokens -= 1.0;
+        }
+    } else {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= state.windowEnd) {
+            closeWindow(state, now);
+        }
+        // Algorithm R: the n-th event replaces a random entry with probability k/n
+        uint64_t n = ++state.windowSeen;
+        if (state.reservoir.size() < rule->reservoirSize) {
+            state.reservoir.emplace_back();
+            state.arrival.push_back(n);
+            slot = &state.reservoir.back();
+            return Decision::Hold;
+        }
+        uint64_t j = random() % n;
+        if (j < rule->reservoirSize) {
+            state.arrival[j] = n;
+            slot = &state.reservoir[j];
+            return Decision::Hold;
+        }
+        return Decision::Drop;
+    }
+
+    if (keep) {
+        bump(state.sampled);
+        return Decision::Keep;
+    }
+    return Decision::Drop;
+}
+
+void EventSampler::closeWindows(std::chrono::steady_clock::time_point now, bool all) {
+    for (State* state : reservoirStates) {
+        if (all || now >= state->windowEnd) {
+            closeWindow(*state, now);
+        }
+    }
+}
+
+// Hand the window's sample over in arrival order and start the next window
+void EventSampler::closeWindow(State& state, std::chrono::steady_clock::time_point now) {
+    if (!state.reservoir.empty()) {
+        std::vector<size_t> order(state.reservoir.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return state.arrival[a] < state.arrival[b]; });
+        for (size_t i : order) {
+            ready.push_back(std::move(state.reservoir[i]));
+        }
+        bump(state.sampled, state.reservoir.size());
+        state.reservoir.clear();
+        state.arrival.clear();
+    }
+    state.windowSeen = 0;
+    state.windowEnd += state.rule->window;
+    if (state.windowEnd <= now) {
+        state.windowEnd = now + state.rule->window;
+    }
+}
+
+void EventSampler::takeReady(std::vector<std::shared_ptr<TimedEvent>>& out) {
+    for (auto& event : ready) {
+        out.push_back(std::move(event));
+    }
+    ready.clear();
+}
+
+std::vector<SamplingCount> EventSampler::counts() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<SamplingCount> result;
+    result.reserve(states.size());
+    for (const auto& state : states) {
+        SamplingCount count;
+        count.eventId = state.eventId;
+        count.seen = state.seen.load(std::memory_order_relaxed);
+        count.sampled = state.sampled.load(std::memory_order_relaxed);
+        result.push_back(count);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const SamplingCount& a, const SamplingCount& b) { return a.eventId < b.eventId; });
+    return result;
+}
+
+uint64_t EventSampler::totalSeen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t total = 0;
+    for (const auto& state : states) {
+        total += state.seen.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t EventSampler::totalSampled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t total = 0;
+    for (const auto& state : states) {
+        total += state.sampled.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// xorshift64*; only needs to be cheap and unbiased enough for sampling
+uint64_t EventSampler::random() {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1DULL;
+}
@@ -0,0 +1,141 @@
+#include "EventView.h"
+
+namespace {
+
+BANK_HEADER readBankHeader(const char* payload) {
+    BANK_HEADER header;
+    std::memcpy(&header, payload, sizeof(header));
+    return header;
+}
+
+size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+} // namespace
+
+const BankIndex* BankIndexSlot::getOrBuild(const char* event, size_t size) const {
+    const BankIndex* existing = get();
+    if (existing != nullptr) {
+        return existing;
+    }
+
+    auto* built = new BankIndex();
+    EventView(event, size).forEachBank([built](const BankSpan& bank) {
+        built->banks.push_back(bank);
+        return true;
+    });
+
+    // Another reader may have raced us; keep whichever index landed first
+    BankIndex* expected = nullptr;
+    if (!index_.compare_exchange_strong(expected, built, std::memory_order_acq_rel)) {
+        delete built;
+        return expected;
+    }
+    return built;
+}
+
+bool EventView::hasBanks() const {
+    if (payloadSize() < sizeof(BANK_HEADER)) {
+        return false;
+    }
+    BANK_HEADER header = readBankHeader(payload());
+    return (header.flags & BANK_FORMAT_VERSION) != 0 &&
+           header.data_size <= payloadSize() - sizeof(BANK_HEADER);
+}
+
+uint32_t EventView::bankFlags() const {
+    return payloadSize() >= sizeof(BANK_HEADER) ? readBankHeader(payload()).flags : 0;
+}
+
+size_t EventView::firstBankOffset() const {
+    if (!hasBanks() || readBankHeader(payload()).data_size == 0) {
+        return 0;
+    }
+    return sizeof(BANK_HEADER);
+}
+
+size_t EventView::readBank(size_t pos, BankSpan& bank) const {
+    BANK_HEADER header = readBankHeader(payload());
+    size_t end = sizeof(BANK_HEADER) + header.data_size;
+    const char* base = payload();
+
+    size_t headerSize;
+    if (header.flags & BANK_FORMAT_32BIT) {
+        headerSize = (header.flags & BANK_FORMAT_64BIT_ALIGNED) ? sizeof(BANK32A) : sizeof(BANK32);
+    } else {
+        headerSize = sizeof(BANK);
+    }
+
+    bank = BankSpan{};
+    if (pos + headerSize > end) {
+        return 0;
+    }
+
+    uint32_t type;
+    uint32_t dataSize;
+    if (header.flags & BANK_FORMAT_32BIT) {
+        BANK32 b;
+        std::memcpy(&b, base + pos, sizeof(b));
+        type = b.type;
+        dataSize = b.data_size;
+    } else {
+        BANK b;
+        std::memcpy(&b, base + pos, sizeof(b));
+        type = b.type;
+        dataSize = b.data_size;
+    }
+
+    size_t dataPos = pos + headerSize;
+    if (dataPos + dataSize > end) {
+        return 0; // Corrupt bank: runs past the end of the event
+    }
+
+    std::memcpy(&bank.name, base + pos, 4);
+    bank.type = type;
+    bank.data = base + dataPos;
+    bank.size = dataSize;
+
+    size_t next = dataPos + align8(dataSize);
+    return next < end ? next : 0;
+}
+
+BankSpan EventView::findBank(uint32_t name) const {
+    const BankIndex* index = slot_ != nullptr ? slot_->get() : ownIndex_.get();
+    if (index != nullptr) {
+        const BankSpan* bank = index->find(name);
+        return bank != nullptr ? *bank : BankSpan{};
+    }
+
+    // No index yet: stop walking as soon as the bank turns up
+    BankSpan found;
+    forEachBank([&found, name](const BankSpan& bank) {
+        if (bank.name == name) {
+            found = bank;
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+BankSpan EventView::findBank(const char* name) const {
+    uint32_t packed = 0;
+    std::memcpy(&packed, name, strnlen(name, 4));
+    return findBank(packed);
+}
+
+const std::vector<BankSpan>& EventView::banks() const {
+    if (slot_ != nullptr) {
+        return slot_->getOrBuild(bytes_, size_)->banks;
+    }
+    if (!ownIndex_) {
+        auto index = std::make_shared<BankIndex>();
+        forEachBank([&index](const BankSpan& bank) {
+            index->banks.push_back(bank);
+            return true;
+        });
+        ownIndex_ = std::move(index);
+    }
+    return ownIndex_->banks;
+}
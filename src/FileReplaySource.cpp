@@ -0,0 +1,187 @@
+#include "FileReplaySource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#define MAX_EVENT_SIZE (10 * 1024 * 1024)
+
+// Look at the clock for the sink's periodic work once per this many events
+static const uint64_t kIdleCheckInterval = 64;
+
+FileReplaySource::FileReplaySource(const FileReplayConfig& config) : config(config) {
+    if (this->config.pacing == ReplayPacing::RealTime || this->config.speed <= 0) {
+        this->config.speed = 1.0;
+    }
+}
+
+FileReplaySource::~FileReplaySource() {
+    stop();
+    if (worker.joinable()) {
+        worker.detach(); // Destroyed from inside a sink callback; the thread is on its way out
+    }
+}
+
+INT FileReplaySource::start(EventSink& eventSink) {
+    if (config.files.empty()) {
+        cm_msg(MERROR, "FileReplaySource::start", "No files to replay");
+        return SS_FILE_ERROR;
+    }
+    stop(); // Reap a replay that finished on its own
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    stopping = false;
+    sink = &eventSink;
+    worker = std::thread(&FileReplaySource::run, this);
+    return SUCCESS;
+}
+
+void FileReplaySource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+        worker.join();
+    }
+}
+
+std::string FileReplaySource::describe() const {
+    if (config.files.empty()) {
+        return "replay";
+    }
+    if (config.files.size() == 1) {
+        return config.files.front();
+    }
+    return config.files.front() + " (+" + std::to_string(config.files.size() - 1) + " more)";
+}
+
+// Replay thread
+void FileReplaySource::run() {
+    lastIdle = std::chrono::steady_clock::now();
+    sink->sourceIdle(SUCCESS);
+
+    INT result = SUCCESS;
+    do {
+        for (const auto& path : config.files) {
+            result = replayFile(path);
+            if (result != SUCCESS || stopping) {
+                break;
+            }
+        }
+        if (result == SUCCESS && !stopping) {
+            passes.fetch_add(1, std::memory_order_relaxed);
+        }
+    } while (config.loop && result == SUCCESS && !stopping);
+
+    sink->sourceStopped(result);
+}
+
+// SUCCESS at the end of the file or when stopped, otherwise the read error
+INT FileReplaySource::replayFile(const std::string& path) {
+    std::unique_ptr<TMReaderInterface> reader(TMNewReader(path.c_str()));
+    if (!reader || reader->fError) {
+        cm_msg(MERROR, "FileReplaySource::replayFile", "Cannot open %s: %s", path.c_str(),
+               reader ? reader->fErrorString.c_str() : "no reader");
+        return SS_FILE_ERROR;
+    }
+
+    INT result = SUCCESS;
+    bool firstEvent = true;
+    DWORD recordedStart = 0;
+    std::chrono::steady_clock::time_point replayStart;
+    uint64_t count = 0;
+
+    while (!stopping) {
+        EVENT_HEADER header;
+        int got = reader->Read(&header, sizeof(header));
+        if (got == 0) {
+            break;
+        }
+        if (got != static_cast<int>(sizeof(header)) || header.data_size > MAX_EVENT_SIZE) {
+            cm_msg(MERROR, "FileReplaySource::replayFile", "%s: truncated or corrupt event after %llu events",
+                   path.c_str(), static_cast<unsigned long long>(count));
+            result = SS_FILE_ERROR;
+            break;
+        }
+
+        size_t bytes = sizeof(header) + header.data_size;
+        if (buffer.size() * sizeof(uint64_t) < bytes) {
+            buffer.resize((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        }
+        char* data = reinterpret_cast<char*>(buffer.data());
+        std::memcpy(data, &header, sizeof(header));
+        if (header.data_size > 0 &&
+            reader->Read(data + sizeof(header), static_cast<int>(header.data_size)) !=
+                static_cast<int>(header.data_size)) {
+            cm_msg(MERROR, "FileReplaySource::replayFile", "%s: truncated event after %llu events", path.c_str(),
+                   static_cast<unsigned long long>(count));
+            result = SS_FILE_ERROR;
+            break;
+        }
+        ++count;
+
+        if (config.pacing != ReplayPacing::MaxSpeed) {
+            if (firstEvent) {
+                recordedStart = header.time_stamp;
+                replayStart = std::chrono::steady_clock::now();
+                firstEvent = false;
+            }
+            // Time stamps are unsigned seconds; anything before the first one
+            // (clock steps, unordered files) goes out immediately
+            if (header.time_stamp > recordedStart) {
+                auto offset = std::chrono::duration<double>((header.time_stamp - recordedStart) / config.speed);
+                auto target = replayStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+                if (!waitUntil(target)) {
+                    break;
+                }
+            }
+        }
+        if (count % kIdleCheckInterval == 0) {
+            idleIfDue(std::chrono::steady_clock::now());
+        }
+
+        const auto* event = reinterpret_cast<const EVENT_HEADER*>(data);
+        if (event->event_id == EVENTID_BOR || event->event_id == EVENTID_EOR) {
+            if (config.transitions) {
+                char error[256] = "";
+                sink->deliverTransition(event->event_id == EVENTID_BOR ? TR_START : TR_STOP,
+                                        static_cast<INT>(event->serial_number), error);
+            }
+        } else if (event->event_id == EVENTID_MESSAGE) {
+            sink->deliverMessage(event, reinterpret_cast<const char*>(event + 1));
+        } else {
+            sink->deliverEvent(event);
+            replayed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    reader->Close();
+    return result;
+}
+
+// Sleep until the target, running the sink's periodic work on schedule.
+// False if stopped meanwhile.
+bool FileReplaySource::waitUntil(std::chrono::steady_clock::time_point target) {
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        idleIfDue(now);
+        if (now >= target) {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (cv.wait_until(lock, std::min(target, lastIdle + config.idleInterval), [this] { return stopping.load(); })) {
+            return false;
+        }
+    }
+}
+
+void FileReplaySource::idleIfDue(std::chrono::steady_clock::time_point now) {
+    if (now - lastIdle >= config.idleInterval) {
+        sink->sourceIdle(SUCCESS);
+        lastIdle = now;
+    }
+}
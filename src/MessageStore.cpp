@@ -0,0 +1,203 @@
+#include "MessageStore.h"
+
+#include <algorithm>
+#include <cstring>
+
+static MessageSeverity severityOf(INT type) {
+    if (type & MT_ERROR) {
+        return MessageSeverity::Error;
+    }
+    if (type == MT_DEBUG) {
+        return MessageSeverity::Debug;
+    }
+    return MessageSeverity::Info;
+}
+
+static INT typeFromName(std::string_view name) {
+    static const std::pair<const char*, INT> names[] = {{"ERROR", MT_ERROR}, {"INFO", MT_INFO}, {"DEBUG", MT_DEBUG},
+                                                        {"USER", MT_USER},   {"LOG", MT_LOG},   {"TALK", MT_TALK},
+                                                        {"CALL", MT_CALL}};
+    for (const auto& [text, type] : names) {
+        if (name == text) {
+            return type;
+        }
+    }
+    return 0;
+}
+
+MessageStore::MessageStore(size_t capacity, std::shared_ptr<EventPool> pool)
+    : capacity(capacity), pool(std::move(pool)), messages(capacity) {
+    for (auto& index : typeIndex) {
+        index = std::make_unique<Index>(capacity);
+    }
+}
+
+void MessageStore::parse(const char* raw, size_t length, INT& type, std::string_view& facility,
+                         std::string_view& text) {
+    length = strnlen(raw, length);
+    std::string_view message(raw, length);
+    facility = {};
+    text = message;
+
+    // "[client,TYPE] text", or "[routine] text" for MT_USER
+    if (message.size() < 2 || message[0] != '[') {
+        return;
+    }
+    size_t close = message.find(']');
+    if (close == std::string_view::npos) {
+        return;
+    }
+    std::string_view tag = message.substr(1, close - 1);
+    size_t comma = tag.rfind(',');
+    facility = comma == std::string_view::npos ? tag : tag.substr(0, comma);
+    if (type == 0 && comma != std::string_view::npos) {
+        type = typeFromName(tag.substr(comma + 1));
+    }
+    text = message.substr(close + 1);
+    if (!text.empty() && text[0] == ' ') {
+        text.remove_prefix(1);
+    }
+}
+
+// Ingest thread
+uint64_t MessageStore::add(INT type, const char* raw, size_t length,
+                           std::chrono::system_clock::time_point timestamp) {
+    std::string_view facility, text;
+    parse(raw, length, type, facility, text);
+
+    TimedMessage message;
+    message.timestamp = timestamp;
+    message.sequence = messages.nextSequence();
+    message.type = type;
+    message.severity = severityOf(type);
+    message.facilityLength = static_cast<uint32_t>(facility.size());
+    message.textLength = static_cast<uint32_t>(text.size());
+    message.storage = store(facility, text);
+    uint64_t sequence = messages.push(std::move(message)); // Oldest message is evicted if the ring is full
+
+    const IndexEntry entry{sequence, timestamp};
+    for (size_t bit = 0; bit < kTypeCount; ++bit) {
+        if (type & (1 << bit)) {
+            typeIndex[bit]->push(entry);
+        }
+    }
+
+    if (!facility.empty()) {
+        const Facility* known = findFacility(facility);
+        size_t count = facilityCount.load(std::memory_order_relaxed);
+        if (known == nullptr && count < kMaxFacilities) {
+            Facility& added = facilities[count];
+            added.name.assign(facility.data(), facility.size());
+            added.index = std::make_unique<Index>(capacity);
+            facilityCount.store(count + 1, std::memory_order_release);
+            known = &added;
+        }
+        if (known != nullptr) {
+            known->index->push(entry);
+        }
+    }
+    return sequence;
+}
+
+// Copy facility and text back to back into the arena
+std::shared_ptr<const char> MessageStore::store(std::string_view facility, std::string_view text) {
+    size_t bytes = facility.size() + text.size();
+    if (!chunk || chunkUsed + bytes > chunk->block.size()) {
+        chunk = std::allocate_shared<Chunk>(PoolAllocator<Chunk>(pool));
+        chunk->block = pool->acquire(std::max(bytes, kChunkBytes));
+        chunkUsed = 0;
+    }
+    char* data = chunk->block.data() + chunkUsed;
+    std::memcpy(data, facility.data(), facility.size());
+    std::memcpy(data + facility.size(), text.data(), text.size());
+    chunkUsed += bytes;
+    return std::shared_ptr<const char>(chunk, data);
+}
+
+const MessageStore::Facility* MessageStore::findFacility(std::string_view name) const {
+    size_t count = facilityCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        if (facilities[i].name == name) {
+            return &facilities[i];
+        }
+    }
+    return nullptr;
+}
+
+// Append the messages an index names that pass the filter, newest maxCount
+void MessageStore::collect(const Index& index, const MessageFilter& filter, std::vector<TimedMessage>& out) const {
+    Index::ReadGuard indexGuard(index);
+    SequencedRing<TimedMessage>::ReadGuard messageGuard(messages);
+    uint64_t head = index.head();
+    uint64_t first = index.partitionPoint([&](const IndexEntry& e) { return e.timestamp > filter.since; }, head);
+
+    // Walk newest to oldest so maxCount stops the walk early
+    size_t taken = 0;
+    size_t start = out.size();
+    for (uint64_t i = head; i > first && taken < filter.maxCount; --i) {
+        index.visit(i - 1, i, [&](uint64_t, const IndexEntry& entry) {
+            messages.visit(entry.sequence, entry.sequence + 1, [&](uint64_t, const TimedMessage& message) {
+                if ((filter.types == 0 || (message.type & filter.types)) &&
+                    (filter.facility.empty() || message.facility() == filter.facility)) {
+                    out.push_back(message);
+                    ++taken;
+                }
+            });
+        });
+    }
+    std::reverse(out.begin() + start, out.end());
+}
+
+std::vector<TimedMessage> MessageStore::find(const MessageFilter& filter) const {
+    std::vector<TimedMessage> result;
+    if (filter.maxCount == 0) {
+        return result;
+    }
+
+    if (!filter.facility.empty()) {
+        if (const Facility* facility = findFacility(filter.facility)) {
+            collect(*facility->index, filter, result);
+            return result;
+        }
+        if (facilityCount.load(std::memory_order_acquire) < kMaxFacilities) {
+            return result; // Never seen
+        }
+        // Not indexed: fall through to a scan of the whole ring
+    } else if (filter.types != 0) {
+        size_t indexes = 0;
+        for (size_t bit = 0; bit < kTypeCount; ++bit) {
+            if (filter.types & (1 << bit)) {
+                collect(*typeIndex[bit], filter, result);
+                ++indexes;
+            }
+        }
+        if (indexes > 1) {
+            // Merge the per-type lists; a message of several types is listed once
+            std::sort(result.begin(), result.end(),
+                      [](const TimedMessage& a, const TimedMessage& b) { return a.sequence < b.sequence; });
+            result.erase(std::unique(result.begin(), result.end(),
+                                     [](const TimedMessage& a, const TimedMessage& b) {
+                                         return a.sequence == b.sequence;
+                                     }),
+                         result.end());
+            if (result.size() > filter.maxCount) {
+                result.erase(result.begin(), result.end() - filter.maxCount);
+            }
+        }
+        return result;
+    }
+
+    SequencedRing<TimedMessage>::ReadGuard guard(messages);
+    uint64_t head = messages.head();
+    uint64_t first = messages.partitionPoint([&](const TimedMessage& m) { return m.timestamp > filter.since; }, head);
+    messages.visit(first, head, [&](uint64_t, const TimedMessage& message) {
+        if ((filter.types == 0 || (message.type & filter.types)) &&
+            (filter.facility.empty() || message.facility() == filter.facility)) {
+            result.push_back(message);
+        }
+    });
+    if (result.size() > filter.maxCount) {
+        result.erase(result.begin(), result.end() - filter.maxCount);
+    }
+    return result;
+}
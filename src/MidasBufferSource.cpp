@@ -0,0 +1,201 @@
+#include "MidasBufferSource.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define MAX_EVENT_SIZE (10 * 1024 * 1024)
+
+// Batches per drain before going back to cm_yield, which must keep running
+// to serve transitions, messages and the watchdog
+static const int kMaxBatchesPerDrain = 8;
+
+MidasBufferSource::MidasBufferSource(const std::string& host, const std::string& experiment,
+                                     const std::string& clientName, const std::string& bufferName, int eventID,
+                                     bool getAllEvents, int yieldTimeoutMs,
+                                     const std::vector<TransitionRegistration>& transitionRegistrations,
+                                     const BufferReadOptions& readOptions)
+    : hostName(host), exptName(experiment), clientName(clientName), bufferName(bufferName), eventID(eventID),
+      getAllEvents(getAllEvents), yieldTimeout(yieldTimeoutMs), transitionRegistrations_(transitionRegistrations),
+      readOptions(readOptions) {
+    if (this->readOptions.batchEvents == 0) {
+        this->readOptions.batchEvents = 1;
+    }
+}
+
+MidasBufferSource::~MidasBufferSource() {
+    stop();
+}
+
+// The buffer is opened on the connection's thread; failures reach the sink
+// through sourceStopped()
+INT MidasBufferSource::start(EventSink& eventSink) {
+    if (connection) {
+        return SUCCESS;
+    }
+    connection = MidasConnection::acquire(hostName, exptName, clientName, yieldTimeout);
+    if (!connection) {
+        return CM_UNDEF_EXP;
+    }
+    sink = &eventSink;
+    connection->attach(this);
+    return SUCCESS;
+}
+
+void MidasBufferSource::stop() {
+    if (connection) {
+        connection->detach(this); // No callbacks reach the sink after this
+        connection.reset();       // The last source out disconnects
+    }
+}
+
+// Connection thread: open our buffer and request its events
+INT MidasBufferSource::openBuffer(EVENT_HANDLER* callback) {
+    INT result = bm_open_buffer(bufferName.c_str(), MAX_EVENT_SIZE * 2, &hBufEvent);
+    if (result != BM_SUCCESS) {
+        cm_msg(MERROR, "MidasBufferSource::openBuffer", "Failed to open buffer. Status: %d", result);
+        sink->sourceStopped(result);
+        return result;
+    }
+
+    result = bm_set_cache_size(hBufEvent, readOptions.cacheBytes, 0);
+    if (result != BM_SUCCESS) {
+        cm_msg(MERROR, "MidasBufferSource::openBuffer", "Failed to set cache size. Status: %d", result);
+        bm_close_buffer(hBufEvent);
+        sink->sourceStopped(result);
+        return result;
+    }
+
+    // Pull mode requests without a callback; bm_receive_event then returns
+    // the events matching the request
+    result = bm_request_event(hBufEvent, (WORD)eventID, TRIGGER_ALL, getAllEvents ? GET_ALL : GET_NONBLOCKING,
+                              &requestID, readOptions.pull ? nullptr : callback);
+    if (result != BM_SUCCESS) {
+        cm_msg(MERROR, "MidasBufferSource::openBuffer", "Failed to request event. Status: %d", result);
+        bm_close_buffer(hBufEvent);
+        sink->sourceStopped(result);
+        return result;
+    }
+
+    if (readOptions.pull) {
+        // Room for a full batch plus one maximum-size event past the limit
+        size_t bytes = readOptions.batchBytes + MAX_EVENT_SIZE;
+        batchStorage.assign((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+        batchHeaders.reserve(readOptions.batchEvents);
+        lastDrain = std::chrono::steady_clock::now();
+        drainRate = 0;
+    }
+
+    sink->sourceIdle(result);
+    return result;
+}
+
+// Connection thread
+void MidasBufferSource::closeBuffer() {
+    bm_delete_request(requestID);
+    bm_close_buffer(hBufEvent);
+}
+
+// Connection thread, after every cm_yield
+int MidasBufferSource::afterYield(INT yieldStatus) {
+    if (yieldStatus == RPC_SHUTDOWN || yieldStatus == SS_ABORT) {
+        sink->sourceStopped(yieldStatus);
+        return yieldTimeout;
+    }
+    int nextTimeout = readOptions.pull ? drain() : yieldTimeout;
+    sink->sourceIdle(yieldStatus);
+    return nextTimeout;
+}
+
+// Connection thread, pull mode: hand everything waiting in the buffer to the
+// sink in batches, then work out how long the next cm_yield may take
+int MidasBufferSource::drain() {
+    char* storage = reinterpret_cast<char*>(batchStorage.data());
+    const size_t storageBytes = batchStorage.size() * sizeof(uint64_t);
+    uint64_t calls = 0;
+    size_t delivered = 0;
+    bool full = false;
+
+    for (int round = 0; round < kMaxBatchesPerDrain; ++round) {
+        size_t offset = 0;
+        batchHeaders.clear();
+        full = false;
+        while (true) {
+            if (batchHeaders.size() >= readOptions.batchEvents || offset >= readOptions.batchBytes) {
+                full = true;
+                break;
+            }
+            INT size = static_cast<INT>(storageBytes - offset);
+            INT result = bm_receive_event(hBufEvent, storage + offset, &size, BM_NO_WAIT);
+            ++calls;
+            if (result == BM_ASYNC_RETURN) {
+                break; // Buffer empty
+            }
+            if (result == BM_TRUNCATED) {
+                truncatedEvents.fetch_add(1, std::memory_order_relaxed);
+                cm_msg(MERROR, "MidasBufferSource::drain", "Event larger than %d bytes dropped from buffer %s",
+                       MAX_EVENT_SIZE, bufferName.c_str());
+                continue;
+            }
+            if (result != BM_SUCCESS) {
+                cm_msg(MERROR, "MidasBufferSource::drain", "Failed to receive event. Status: %d", result);
+                break;
+            }
+            batchHeaders.push_back(reinterpret_cast<const EVENT_HEADER*>(storage + offset));
+            offset += (static_cast<size_t>(size) + 7) & ~size_t(7);
+        }
+
+        if (!batchHeaders.empty()) {
+            sink->deliverEvents(batchHeaders.data(), batchHeaders.size());
+            delivered += batchHeaders.size();
+            batches.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!full) {
+            break;
+        }
+    }
+    receiveCalls.fetch_add(calls, std::memory_order_relaxed);
+    pulledEvents.fetch_add(delivered, std::memory_order_relaxed);
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastDrain).count();
+    lastDrain = now;
+    if (elapsed > 0) {
+        drainRate = 0.7 * drainRate + 0.3 * (delivered / elapsed);
+    }
+
+    const int maxTimeout = static_cast<int>(readOptions.maxPollInterval.count());
+    if (full) {
+        return 0; // More is waiting; only service the connection
+    }
+    if (drainRate < 1) {
+        return maxTimeout;
+    }
+    double halfBatchMs = 1000.0 * (readOptions.batchEvents / 2.0) / drainRate;
+    return static_cast<int>(std::min<double>(std::floor(halfBatchMs), maxTimeout));
+}
+
+MidasBufferSource::ReadStats MidasBufferSource::readStats() const {
+    ReadStats stats;
+    stats.receiveCalls = receiveCalls.load(std::memory_order_relaxed);
+    stats.batches = batches.load(std::memory_order_relaxed);
+    stats.events = pulledEvents.load(std::memory_order_relaxed);
+    stats.truncated = truncatedEvents.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Connection thread
+void MidasBufferSource::connectionFailed(INT connectStatus) {
+    sink->sourceStopped(connectStatus);
+}
+
+void MidasBufferSource::processEvent(HNDLE, HNDLE, EVENT_HEADER* pheader, void*) {
+    sink->deliverEvent(pheader);
+}
+
+void MidasBufferSource::processMessage(HNDLE, HNDLE, EVENT_HEADER* pheader, void* message) {
+    sink->deliverMessage(pheader, static_cast<const char*>(message));
+}
+
+INT MidasBufferSource::processTransition(INT transition, INT runNumber, char* error) {
+    return sink->deliverTransition(transition, runNumber, error);
+}
@@ -0,0 +1,231 @@
+#include "MidasConnection.h"
+
+#include <algorithm>
+#include <future>
+
+#include "MidasBufferSource.h"
+
+MidasConnection* MidasConnection::active = nullptr;
+std::mutex MidasConnection::instanceMutex;
+std::weak_ptr<MidasConnection> MidasConnection::instance;
+
+std::shared_ptr<MidasConnection> MidasConnection::acquire(const std::string& host, const std::string& experiment,
+                                                          const std::string& clientName, int yieldTimeoutMs) {
+    std::lock_guard<std::mutex> lock(instanceMutex);
+
+    if (auto existing = instance.lock()) {
+        if (existing->hostName != host || existing->exptName != experiment) {
+            cm_msg(MERROR, "MidasConnection::acquire",
+                   "Already connected to experiment \"%s\" on \"%s\"; cannot also connect to \"%s\" on \"%s\"",
+                   existing->exptName.c_str(), existing->hostName.c_str(), experiment.c_str(), host.c_str());
+            return nullptr;
+        }
+        return existing;
+    }
+
+    // Not make_shared: the constructor is private
+    std::shared_ptr<MidasConnection> connection(new MidasConnection(host, experiment, clientName, yieldTimeoutMs));
+    instance = connection;
+    return connection;
+}
+
+MidasConnection::MidasConnection(const std::string& host, const std::string& experiment,
+                                 const std::string& clientName, int yieldTimeoutMs)
+    : hostName(host), exptName(experiment), clientName(clientName), yieldTimeout(yieldTimeoutMs) {
+    yieldThread = std::thread(&MidasConnection::run, this);
+}
+
+MidasConnection::~MidasConnection() {
+    running = false;
+    taskCV.notify_all();
+    if (yieldThread.joinable()) {
+        yieldThread.join();
+    }
+}
+
+void MidasConnection::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        tasks.push_back(std::move(task));
+    }
+    taskCV.notify_all();
+}
+
+// Run everything queued so far; returns false if there was nothing to do
+bool MidasConnection::runPendingTasks() {
+    std::deque<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        pending.swap(tasks);
+    }
+    for (auto& task : pending) {
+        task();
+    }
+    return !pending.empty();
+}
+
+void MidasConnection::attach(MidasBufferSource* source) {
+    post([this, source] {
+        if (!connected) {
+            source->connectionFailed(status);
+            return;
+        }
+        if (source->openBuffer(&MidasConnection::processEventCallback) != BM_SUCCESS) {
+            return;
+        }
+        sources.push_back(source);
+        sourcesByRequest[source->requestID] = source;
+        registerTransitions(source);
+    });
+}
+
+void MidasConnection::detach(MidasBufferSource* source) {
+    auto task = [this, source] {
+        for (auto it = sources.begin(); it != sources.end(); ++it) {
+            if (*it == source) {
+                sources.erase(it);
+                sourcesByRequest.erase(source->requestID);
+                source->closeBuffer();
+                break;
+            }
+        }
+    };
+
+    // Called from inside a callback: already on the yield thread
+    if (std::this_thread::get_id() == yieldThread.get_id()) {
+        task();
+        return;
+    }
+
+    std::promise<void> done;
+    post([&] {
+        task();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+// Register the source's transitions that no earlier source asked for. MIDAS
+// takes one callback per transition, so the first sequence number wins.
+void MidasConnection::registerTransitions(MidasBufferSource* source) {
+    for (const auto& reg : source->transitionRegistrations_) {
+        if (registeredTransitions.count(reg.transition) != 0) {
+            continue;
+        }
+        auto callback = transitionCallbackFor(reg.transition);
+        INT result = callback != nullptr ? cm_register_transition(reg.transition, callback, reg.sequence)
+                                         : CM_INVALID_TRANSITION;
+        if (result != CM_SUCCESS) {
+            cm_msg(MERROR, "MidasConnection::registerTransitions",
+                   "Failed to register transition callback for %s. Status: %d",
+                   cm_transition_name(reg.transition).c_str(),
+                   result);
+            continue;
+        }
+        registeredTransitions.insert(reg.transition);
+    }
+}
+
+// Yield thread: connect, then alternate between queued work and cm_yield
+void MidasConnection::run() {
+    INT result = cm_connect_experiment(hostName.c_str(), exptName.c_str(), clientName.c_str(), nullptr);
+    if (result != CM_SUCCESS) {
+        cm_msg(MERROR, "MidasConnection::run", "Failed to connect to experiment. Status: %d", result);
+    } else {
+        active = this;
+        result = cm_msg_register(&MidasConnection::processMessageCallback);
+        if (result != CM_SUCCESS) {
+            cm_msg(MERROR, "MidasConnection::run", "Failed to register message callback. Status: %d", result);
+        } else {
+            connected = true;
+        }
+    }
+    status = result;
+
+    bool shutdown = !connected;
+    int timeout = yieldTimeout;
+    while (running) {
+        runPendingTasks();
+
+        if (shutdown) {
+            // Nothing to yield to; just serve attach/detach until released
+            std::unique_lock<std::mutex> lock(taskMutex);
+            taskCV.wait(lock, [this] { return !tasks.empty() || !running; });
+            continue;
+        }
+
+        // Pull-mode sources shorten the next yield while events are flowing
+        result = cm_yield(timeout);
+        timeout = yieldTimeout;
+        for (MidasBufferSource* source : sources) {
+            timeout = std::min(timeout, source->afterYield(result));
+        }
+        if (result == RPC_SHUTDOWN || result == SS_ABORT) {
+            shutdown = true;
+        }
+    }
+    runPendingTasks();
+
+    // Sources detach before releasing the connection; close anything left
+    for (MidasBufferSource* source : sources) {
+        source->closeBuffer();
+    }
+    sources.clear();
+    sourcesByRequest.clear();
+
+    if (active == this) {
+        cm_disconnect_experiment();
+        active = nullptr;
+    }
+}
+
+// Static callback: route the event to the source that requested it
+void MidasConnection::processEventCallback(HNDLE hBuf, HNDLE requestId, EVENT_HEADER* pheader, void* pevent) {
+    auto it = active->sourcesByRequest.find(requestId);
+    if (it != active->sourcesByRequest.end()) {
+        it->second->processEvent(hBuf, requestId, pheader, pevent);
+    }
+}
+
+// Static callback: every source keeps its own message history
+void MidasConnection::processMessageCallback(HNDLE hBuf, HNDLE id, EVENT_HEADER* pheader, void* message) {
+    for (MidasBufferSource* source : active->sources) {
+        source->processMessage(hBuf, id, pheader, message);
+    }
+}
+
+// Static callback, one instantiation per transition so sources only see
+// the transitions they registered for
+template <INT Transition>
+INT MidasConnection::processTransitionCallback(INT runNumber, char* error) {
+    INT result = SUCCESS;
+    for (MidasBufferSource* source : active->sources) {
+        for (const auto& reg : source->transitionRegistrations_) {
+            if (reg.transition == Transition) {
+                INT status = source->processTransition(Transition, runNumber, error);
+                if (result == SUCCESS) {
+                    result = status;
+                }
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+INT (*MidasConnection::transitionCallbackFor(INT transition))(INT, char*) {
+    switch (transition) {
+    case TR_START:
+        return &processTransitionCallback<TR_START>;
+    case TR_STOP:
+        return &processTransitionCallback<TR_STOP>;
+    case TR_PAUSE:
+        return &processTransitionCallback<TR_PAUSE>;
+    case TR_RESUME:
+        return &processTransitionCallback<TR_RESUME>;
+    case TR_STARTABORT:
+        return &processTransitionCallback<TR_STARTABORT>;
+    default:
+        return nullptr;
+    }
+}
@@ -1,5 +1,6 @@
 #include "MidasReceiver.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
@@ -21,6 +22,14 @@ MidasReceiver::MidasReceiver() :
     init(defaultConfig, /*fromDefault=*/true); // special flag for default init
 }
 
+MidasReceiver::MidasReceiver(const MidasReceiverConfig& config) :
+    running(false),
+    listeningForEvents(false),
+    isInitialized(false)
+{
+    init(config);
+}
+
 // Destructor
 MidasReceiver::~MidasReceiver() {
     stop();
@@ -56,9 +65,76 @@ void MidasReceiver::init(const MidasReceiverConfig& config, bool fromDefault) {
     this->getAllEvents = config.getAllEvents;
     this->maxBufferSize = config.maxBufferSize;
     this->cmYieldTimeout = config.cmYieldTimeout;
+    this->odbCacheEntries = config.odbCacheEntries;
+    this->bufferRead = config.bufferRead;
+    this->eventPoolCacheBytes = config.eventPoolCacheBytes;
+    this->eventRetention = config.eventRetention;
+    this->runRetention = config.runRetention;
+    this->decodeWorkers = config.decodeWorkers;
+    this->stagingCapacity = config.stagingCapacity;
+    this->serialReportInterval = config.serialReportInterval;
+    this->samplingRules = config.sampling;
+    this->coldTier = config.coldTier;
+    this->journalDirectory = config.journalDirectory;
+    this->journalSegmentBytes = config.journalSegmentBytes;
+    this->journalMaxBytes = config.journalMaxBytes;
+    this->shmRingName = config.shmRingName;
+    this->shmRingBytes = config.shmRingBytes;
+    if (this->eventRetention.maxEvents == 0) {
+        this->eventRetention.maxEvents = this->maxBufferSize;
+    }
+
+    // Rings are sized once here; re-initialising while running is not supported
+    if (!running) {
+        eventPool = std::make_shared<EventPool>(MAX_EVENT_SIZE, eventPoolCacheBytes);
+        eventBuffer = std::make_unique<SequencedRing<std::shared_ptr<TimedEvent>>>(eventRetention.maxEvents);
+        // An evicted event's memory is only released when its ring node is
+        // reclaimed, so it stays resident until then
+        residentBytes.store(0, std::memory_order_relaxed);
+        eventBuffer->setReclaimHandler([this](const std::shared_ptr<TimedEvent>& event) {
+            residentBytes.store(residentBytes.load(std::memory_order_relaxed) - event->footprint(),
+                                std::memory_order_relaxed);
+        });
+        messageStore = std::make_unique<MessageStore>(maxBufferSize, eventPool);
+        transitionBuffer = std::make_unique<SequencedRing<TimedTransition>>(maxBufferSize);
+        runSegments = std::make_unique<RunSegments>(runRetention);
+        {
+            std::lock_guard<std::mutex> lock(runBoundaryMutex);
+            runBoundaries.clear();
+            runBoundaryPending.store(false, std::memory_order_relaxed);
+        }
+        sampler.reset();
+        if (!samplingRules.empty()) {
+            sampler = std::make_unique<EventSampler>(samplingRules);
+        }
+        cold.reset();
+        journal.reset();
+        if (!journalDirectory.empty()) {
+            journal = std::make_unique<EventJournal>(journalDirectory, journalSegmentBytes, journalMaxBytes,
+                                                     eventPool);
+        }
+        if (coldTier.after.count() > 0) {
+            cold = std::make_unique<ColdStore>(coldTier, eventRetention.maxAge, eventPool, journal.get());
+        }
+        aggregates = std::make_unique<AggregateEngine>(config.aggregates);
+        aggregateQueueCapacity = config.aggregates.queueCapacity;
+        fileWriter.reset();
+        fileWriterQueueCapacity = config.fileWriter.queueCapacity;
+        if (!config.fileWriter.directory.empty()) {
+            fileWriter = std::make_unique<EventFileWriter>(config.fileWriter);
+            if (!fileWriter->isValid()) {
+                fileWriter.reset(); // Reported; don't queue events nobody writes
+            }
+        }
+        shmRing.reset();
+        if (!shmRingName.empty()) {
+            shmRing = std::make_unique<ShmRingWriter>(shmRingName, shmRingBytes);
+        }
+    }
 
     // Save the transition registrations for later use when setting up transitions
     this->transitionRegistrations_ = config.transitionRegistrations;
+    this->configuredSource = config.eventSource;
 
     // Only mark fully initialized if not from default
     if (!fromDefault) {
@@ -66,12 +142,60 @@ void MidasReceiver::init(const MidasReceiverConfig& config, bool fromDefault) {
     }
 }
 
-// Start receiving events
+// Start receiving events. A live buffer is opened on the connection's
+// thread; failures show up in getStatus() and isListeningForEvents().
 void MidasReceiver::start() {
     if (!running) {
+        source = configuredSource;
+        if (!source) {
+            source = std::make_shared<MidasBufferSource>(hostName, exptName, clientName, bufferName, eventID,
+                                                         getAllEvents, cmYieldTimeout, transitionRegistrations_,
+                                                         bufferRead);
+        }
+
         running = true;
         listeningForEvents = true;
-        workerThread = std::thread(&MidasReceiver::run, this);
+        eventNotifier.start();
+        messageNotifier.start();
+        transitionNotifier.start();
+        startTime = rateWindowStart = lastSerialReport = std::chrono::steady_clock::now();
+        rateWindowEvents = receivedEvents.load(std::memory_order_relaxed);
+        rateWindowBytes = receivedBytes.load(std::memory_order_relaxed);
+        if (decodeWorkers > 0) {
+            pipeline = std::make_unique<EventPipeline>(
+                decodeWorkers, stagingCapacity, eventHandlers,
+                [this](std::shared_ptr<TimedEvent>&& event) { publishEvent(std::move(event)); });
+            pipeline->start();
+        }
+
+        if (fileWriter) {
+            // Subscribed before the source starts, so the files miss nothing
+            fileWriterSubscription = subscribe(SubscriptionFilter(), BackpressurePolicy::DropOldest,
+                                               fileWriterQueueCapacity);
+            fileWriter->start(fileWriterSubscription);
+        }
+
+        INT result = source->start(*this);
+        if (result != SUCCESS) {
+            cm_msg(MERROR, "MidasReceiver::start", "Failed to start event source %s. Status: %d",
+                   source->describe().c_str(), result);
+            source.reset();
+            if (pipeline) {
+                pipeline->stop();
+                pipeline.reset();
+            }
+            stopFileWriter();
+            running = false;
+            listeningForEvents = false;
+            wakeWaiters();
+            setStatus(result);
+        } else {
+            startAggregates();
+            if (odbCacheEntries > 0 && dynamic_cast<MidasBufferSource*>(source.get())) {
+                std::lock_guard<std::mutex> lock(odbCacheMutex);
+                odbCache = std::make_shared<OdbCache>(odbCacheEntries);
+            }
+        }
     }
 }
 
@@ -79,348 +203,1095 @@ void MidasReceiver::start() {
 void MidasReceiver::stop() {
     if (running) {
         running = false;
-        if (workerThread.joinable()) {
-            workerThread.join();
+        wakeWaiters();
+        {
+            // Let an ingest blocked on a full Block-policy subscriber notice
+            std::lock_guard<std::mutex> lock(subscribersMutex);
+            for (auto& subscription : subscribers) {
+                subscription->interrupt();
+            }
+        }
+        std::shared_ptr<OdbCache> cache;
+        {
+            std::lock_guard<std::mutex> lock(odbCacheMutex);
+            cache.swap(odbCache);
+        }
+        if (cache) {
+            cache->clear(); // Remove the watches while still connected
+        }
+        source->stop(); // No callbacks reach us after this
+        source.reset(); // The last live buffer out disconnects
+        if (pipeline) {
+            pipeline->stop(); // Publishes whatever was still staged
+            pipeline.reset();
         }
-        cm_disconnect_experiment();
+        applyRunBoundaries(); // Everything before them is published now
+        stopAggregates();
+        stopFileWriter();
+        reportSerialLoss();
+        listeningForEvents = false;
     }
 }
 
-// Main worker thread
-void MidasReceiver::run() {
-    status = cm_connect_experiment(hostName.c_str(), exptName.c_str(), clientName.c_str(), nullptr); // Set status during connection
+// Ingest thread, between deliveries
+void MidasReceiver::sourceIdle(INT sourceStatus) {
+    setStatus(sourceStatus);
 
-    if (status != CM_SUCCESS) {
-        cm_msg(MERROR, "MidasReceiver::run", "Failed to connect to experiment. Status: %d", status);
-        listeningForEvents = false;
+    if (sampler) {
+        releaseSampled(); // Reservoir windows close even when their event ID goes quiet
+    }
+
+    // Age limits apply even when no events arrive
+    if (pipeline) {
+        pipeline->runExclusive([this] {
+            enforceRetention(0);
+            applyRunBoundaries();
+            releaseRuns();
+        });
+    } else {
+        enforceRetention(0);
+        releaseRuns();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastSerialReport >= serialReportInterval) {
+        reportSerialLoss();
+        lastSerialReport = now;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - rateWindowStart).count();
+    if (elapsed >= 1.0) {
+        uint64_t events = receivedEvents.load(std::memory_order_relaxed);
+        uint64_t bytes = receivedBytes.load(std::memory_order_relaxed);
+        eventRate.store((events - rateWindowEvents) / elapsed, std::memory_order_relaxed);
+        byteRate.store((bytes - rateWindowBytes) / elapsed, std::memory_order_relaxed);
+        rateWindowStart = now;
+        rateWindowEvents = events;
+        rateWindowBytes = bytes;
+    }
+}
+
+// Ingest thread: the source is done; stop() still has to be called
+void MidasReceiver::sourceStopped(INT sourceStatus) {
+    if (sampler) {
+        releaseSampled(/*all=*/true);
+    }
+    setStatus(sourceStatus);
+    listeningForEvents = false;
+    // Nothing more is coming; waitFor*() calls return now rather than at
+    // their timeout
+    wakeWaiters();
+}
+
+// Release blocked waitFor*() callers and keep new ones from blocking until
+// the next start()
+void MidasReceiver::wakeWaiters() {
+    eventNotifier.wakeAll();
+    messageNotifier.wakeAll();
+    transitionNotifier.wakeAll();
+}
+
+void MidasReceiver::setStatus(INT newStatus) {
+    std::lock_guard<std::mutex> lock(statusMutex);
+    status = newStatus;
+}
+
+void MidasReceiver::deliverEvent(const EVENT_HEADER* pheader) {
+    // Time a fixed fraction of callbacks; two clock reads per event would
+    // cost more than everything else the instrumentation does
+    uint64_t callback = callbacks.load(std::memory_order_relaxed) + 1;
+    callbacks.store(callback, std::memory_order_relaxed);
+    if (callback % kCallbackTimingInterval != 0) {
+        storeEvent(pheader);
         return;
     }
+    auto start = std::chrono::steady_clock::now();
+    storeEvent(pheader);
+    callbackTime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start).count());
+}
 
-    status = bm_open_buffer(bufferName.c_str(), MAX_EVENT_SIZE * 2, &hBufEvent); // Set status for buffer opening
-    if (status != BM_SUCCESS) {
-        cm_msg(MERROR, "MidasReceiver::run", "Failed to open buffer. Status: %d", status);
-        listeningForEvents = false;
+// A batch from a pull-mode source is published with one ring commit and one
+// wakeup for waiters, instead of one per event
+void MidasReceiver::deliverEvents(const EVENT_HEADER* const* headers, size_t count) {
+    // Timed like single deliveries, one batch in kCallbackTimingInterval
+    uint64_t callback = callbacks.load(std::memory_order_relaxed) + 1;
+    callbacks.store(callback, std::memory_order_relaxed);
+    bool timed = callback % kCallbackTimingInterval == 0;
+    auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+    for (size_t i = 0; i < count; ++i) {
+        auto event = acceptEvent(headers[i]);
+        if (!event) {
+            continue;
+        }
+        if (pipeline) {
+            pipeline->submit(std::move(event));
+            continue;
+        }
+        for (const auto& handler : eventHandlers) {
+            handler(*event);
+        }
+        stageEvent(std::move(event));
+    }
+    if (!pipeline) {
+        commitStaged(); // Otherwise the pipeline's committer publishes
+    }
+
+    if (timed) {
+        callbackTime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+// Serial check and sampling, before anything is copied. Returns the event to
+// publish, or null if sampling dropped it or held it in a reservoir.
+std::shared_ptr<TimedEvent> MidasReceiver::acceptEvent(const EVENT_HEADER* pheader) {
+    // GET_NONBLOCKING skips events by design, so only GET_ALL can detect loss
+    if (getAllEvents) {
+        serialGaps.observe(pheader->event_id, pheader->serial_number);
+    }
+    if (!sampler) {
+        return copyEvent(pheader);
+    }
+
+    std::shared_ptr<TimedEvent>* slot = nullptr;
+    switch (sampler->admit(static_cast<uint16_t>(pheader->event_id), slot)) {
+    case EventSampler::Decision::Keep:
+        return copyEvent(pheader);
+    case EventSampler::Decision::Hold:
+        *slot = copyEvent(pheader); // The event it replaces goes back to the pool
+        break;
+    case EventSampler::Decision::Drop:
+        break;
+    }
+    if (sampler->hasReady()) {
+        releaseSampled();
+    }
+    return nullptr;
+}
+
+std::shared_ptr<TimedEvent> MidasReceiver::copyEvent(const EVENT_HEADER* pheader) {
+    int size = pheader->data_size;
+
+    // Event, control block and payload all come from the pool; the only copy
+    // is out of the buffer manager's memory, which is reused after we return
+    auto newTimedEvent = std::allocate_shared<TimedEvent>(PoolAllocator<TimedEvent>(eventPool));
+    newTimedEvent->timestamp = nextTimestamp();
+    newTimedEvent->raw = eventPool->acquire(size + sizeof(EVENT_HEADER));
+    std::memcpy(newTimedEvent->raw.data(), pheader, size + sizeof(EVENT_HEADER));
+    return newTimedEvent;
+}
+
+void MidasReceiver::storeEvent(const EVENT_HEADER* pheader) {
+    auto newTimedEvent = acceptEvent(pheader);
+    if (!newTimedEvent) {
+        return;
+    }
+    if (pipeline) {
+        pipeline->submit(std::move(newTimedEvent)); // Decoded and published by the workers
         return;
     }
+    for (const auto& handler : eventHandlers) {
+        handler(*newTimedEvent);
+    }
+    publishEvent(std::move(newTimedEvent));
+}
 
-    status = bm_set_cache_size(hBufEvent, 100000, 0); // Update status if cache size fails
-    if (status != BM_SUCCESS) {
-        cm_msg(MERROR, "MidasReceiver::run", "Failed to set cache size. Status: %d", status);
-        listeningForEvents = false;
+// Ingest thread: publish the samples of closed reservoir windows. They are
+// stamped on release, as they would otherwise be older than what the rings
+// already hold.
+void MidasReceiver::releaseSampled(bool all) {
+    sampler->closeWindows(std::chrono::steady_clock::now(), all);
+    if (!sampler->hasReady()) {
         return;
     }
+    sampledReady.clear();
+    sampler->takeReady(sampledReady);
+    for (auto& event : sampledReady) {
+        event->timestamp = nextTimestamp();
+        if (pipeline) {
+            pipeline->submit(std::move(event));
+            continue;
+        }
+        for (const auto& handler : eventHandlers) {
+            handler(*event);
+        }
+        stageEvent(std::move(event));
+    }
+    sampledReady.clear();
+    if (!pipeline) {
+        commitStaged();
+    }
+}
 
-    status = bm_request_event(hBufEvent, (WORD)eventID, TRIGGER_ALL, getAllEvents ? GET_ALL : GET_NONBLOCKING,
-                              &requestID, MidasReceiver::processEventCallback);
-    if (status != BM_SUCCESS) {
-        cm_msg(MERROR, "MidasReceiver::run", "Failed to request event. Status: %d", status);
-        listeningForEvents = false;
+// Make an event readable: ring, counters, waiters, subscribers. Called in
+// arrival order by one thread at a time (see the eventBuffer comment).
+void MidasReceiver::publishEvent(std::shared_ptr<TimedEvent>&& event) {
+    stageEvent(std::move(event));
+    commitStaged();
+}
+
+// Store an event without making it readable; commitStaged() releases it
+void MidasReceiver::stageEvent(std::shared_ptr<TimedEvent>&& event) {
+    event->sequence = eventBuffer->nextSequence();
+    if (runBoundaryPending.load(std::memory_order_acquire)) {
+        applyRunBoundaries(); // Before this event, if it came after the transition
+    }
+
+    // Make room first so resident bytes never exceed the budget, even briefly.
+    // Evicted storage returns to the pool once the last reader lets go.
+    size_t footprint = event->footprint();
+    enforceRetention(footprint);
+
+    eventBuffer->stage(event);
+    residentBytes.store(residentBytes.load(std::memory_order_relaxed) + footprint, std::memory_order_relaxed);
+    receivedEvents.store(receivedEvents.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    receivedBytes.store(receivedBytes.load(std::memory_order_relaxed) + event->size(), std::memory_order_relaxed);
+    runSegments->add(*event);
+    stagedEvents.push_back(std::move(event));
+}
+
+void MidasReceiver::commitStaged() {
+    if (stagedEvents.empty()) {
         return;
     }
+    eventBuffer->publish();
+    eventNotifier.published(eventBuffer->head());
+    if (shmRing) {
+        for (const auto& event : stagedEvents) {
+            shmRing->write(event->sequence, event->timestamp, event->raw.data(), event->size());
+        }
+        shmRing->publish();
+    }
+    for (const auto& event : stagedEvents) {
+        dispatchToSubscribers(event);
+    }
+    stagedEvents.clear();
+}
 
-    status = cm_msg_register(MidasReceiver::processMessageCallback);
-    if (status != CM_SUCCESS) {
-        cm_msg(MERROR, "MidasReceiver::run", "Failed to register message callback. Status: %d", status);
-        listeningForEvents = false;
+void MidasReceiver::addEventHandler(EventHandler handler) {
+    eventHandlers.push_back(std::move(handler));
+}
+
+// Hand an event to every subscriber whose filter matches. Producer thread only.
+void MidasReceiver::dispatchToSubscribers(const std::shared_ptr<TimedEvent>& event) {
+    uint64_t version = subscribersVersion.load(std::memory_order_acquire);
+    if (version != activeSubscribersVersion) {
+        std::lock_guard<std::mutex> lock(subscribersMutex);
+        activeSubscribers = subscribers;
+        activeSubscribersVersion = subscribersVersion.load(std::memory_order_relaxed);
+    }
+    if (activeSubscribers.empty()) {
         return;
     }
 
-    for (const auto& reg : transitionRegistrations_) {
-        status = cm_register_transition(reg.transition, MidasReceiver::processTransitionCallback, reg.sequence);
-        if (status != CM_SUCCESS) {
-            cm_msg(MERROR, "MidasReceiver::run",
-                   "Failed to register transition callback for %s. Status: %d",
-                   cm_transition_name(reg.transition).c_str(),
-                   status);
-            listeningForEvents = false;
-            return;
+    EventView view = event->view();
+    bool anyClosed = false;
+    for (const auto& subscription : activeSubscribers) {
+        if (subscription->isClosed()) {
+            anyClosed = true;
+        } else if (subscription->matches(view)) {
+            subscription->offer(event, [this] { return running.load(std::memory_order_relaxed); });
         }
     }
 
-    while (running && (status != RPC_SHUTDOWN && status != SS_ABORT)) {
-        status = cm_yield(cmYieldTimeout);
+    if (anyClosed) {
+        std::lock_guard<std::mutex> lock(subscribersMutex);
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                         [](const auto& s) { return s->isClosed(); }),
+                          subscribers.end());
+        subscribersVersion.fetch_add(1, std::memory_order_release);
+    }
+}
+
+std::shared_ptr<Subscription> MidasReceiver::subscribe(const SubscriptionFilter& filter,
+                                                       BackpressurePolicy policy, size_t capacity) {
+    auto subscription = std::make_shared<Subscription>(filter, policy, capacity);
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    subscribers.push_back(subscription);
+    subscribersVersion.fetch_add(1, std::memory_order_release);
+    return subscription;
+}
+
+void MidasReceiver::unsubscribe(const std::shared_ptr<Subscription>& subscription) {
+    subscription->close();
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscription), subscribers.end());
+    subscribersVersion.fetch_add(1, std::memory_order_release);
+}
+
+// Run the aggregate worker if there is anything to aggregate
+void MidasReceiver::startAggregates() {
+    std::lock_guard<std::mutex> lock(aggregatesMutex);
+    if (running && !aggregates->isRunning() && aggregates->hasAggregates()) {
+        aggregateSubscription = subscribe(SubscriptionFilter(), BackpressurePolicy::DropOldest, aggregateQueueCapacity);
+        aggregates->start(aggregateSubscription);
     }
+}
 
-    bm_close_buffer(hBufEvent);
-    listeningForEvents = false;
+void MidasReceiver::stopAggregates() {
+    std::lock_guard<std::mutex> lock(aggregatesMutex);
+    if (aggregateSubscription) {
+        aggregates->stop();
+        unsubscribe(aggregateSubscription);
+        aggregateSubscription.reset();
+    }
+}
+
+bool MidasReceiver::addHistogram(const HistogramSpec& spec) {
+    if (!aggregates->addHistogram(spec)) {
+        return false;
+    }
+    startAggregates();
+    return true;
 }
 
+bool MidasReceiver::addWindow(const WindowSpec& spec) {
+    if (!aggregates->addWindow(spec)) {
+        return false;
+    }
+    startAggregates();
+    return true;
+}
 
-// Static callback: process event
-void MidasReceiver::processEventCallback(HNDLE hBuf, HNDLE request_id, EVENT_HEADER* pheader, void* pevent) {
-    MidasReceiver& receiver = MidasReceiver::getInstance();
-    receiver.processEvent(hBuf, request_id, pheader, pevent);
+void MidasReceiver::enableEventRates(std::chrono::milliseconds window) {
+    aggregates->enableEventRates(window);
+    startAggregates();
 }
 
-// Static callback: process message
-void MidasReceiver::processMessageCallback(HNDLE hBuf, HNDLE id, EVENT_HEADER* pheader, void* message) {
-    MidasReceiver& receiver = MidasReceiver::getInstance();
-    receiver.processMessage(hBuf, id, pheader, message);
+bool MidasReceiver::getHistogram(const std::string& name, HistogramSnapshot& out) const {
+    return aggregates->histogram(name, out);
 }
 
-// Static callback: process transition
-INT MidasReceiver::processTransitionCallback(INT run_number, char* error) {
-    MidasReceiver& receiver = MidasReceiver::getInstance();
-    return receiver.processTransition(run_number, error);
+bool MidasReceiver::getWindow(const std::string& name, WindowSnapshot& out) const {
+    return aggregates->window(name, out);
 }
 
-void MidasReceiver::processEvent(HNDLE hBuf, HNDLE request_id, EVENT_HEADER* pheader, void* pevent) {
-    int size = pheader->data_size;
-    int id = pheader->event_id;
-    if (id > 9) id = 9;
-    eventByteCount += size + sizeof(EVENT_HEADER);
+std::vector<EventRate> MidasReceiver::getEventRates() const {
+    return aggregates->eventRates();
+}
 
-    if (getAllEvents) {
-        if (!firstEvent && pheader->serial_number != 0 &&
-            static_cast<INT>(pheader->serial_number) != serialNumbers[id] + 1) {
-            cm_msg(MERROR, "processEvent",
-                   "Serial number mismatch: Expected Serial: %d, Actual Serial: %d, Event ID: %d, Size: %d",
-                   serialNumbers[id] + 1, pheader->serial_number, id, size);
-            cm_msg(MERROR, "processEvent", "Event Header: [Event ID: %d, Serial: %d, Data Size: %d]",
-                   pheader->event_id, pheader->serial_number, pheader->data_size);
-            countMismatches++;
-        }
-        serialNumbers[id] = pheader->serial_number;
+AggregateStats MidasReceiver::getAggregateStats() const {
+    return aggregates->stats();
+}
+
+void MidasReceiver::resetAggregates() {
+    aggregates->reset();
+}
+
+void MidasReceiver::stopFileWriter() {
+    if (fileWriterSubscription) {
+        fileWriter->stop(); // Writes what is queued and closes the file
+        unsubscribe(fileWriterSubscription);
+        fileWriterSubscription.reset();
     }
-    firstEvent = false;
+}
 
-    // Create shared_ptr<TimedEvent>
-    auto newTimedEvent = std::make_shared<TimedEvent>();
-    newTimedEvent->timestamp = std::chrono::system_clock::now();
-    newTimedEvent->event = std::make_shared<TMEvent>(pheader, size + sizeof(EVENT_HEADER));
+EventFileStats MidasReceiver::getFileWriterStats() const {
+    return fileWriter ? fileWriter->stats() : EventFileStats();
+}
 
-    {
-        std::lock_guard<std::mutex> lock(eventBufferMutex);
-        if (eventBuffer.size() >= maxBufferSize) {
-            eventBuffer.pop_front();
+// Evict the oldest events until the store, plus `incomingBytes` about to be
+// added, is within every retention limit. Evicted storage a reader still
+// guards counts until it is released, so a long-lived snapshot can cost
+// newer events their place. Producer thread only.
+void MidasReceiver::enforceRetention(size_t incomingBytes) {
+    const auto maxBytes = eventRetention.maxBytes;
+    const auto maxAge = eventRetention.maxAge;
+    const auto now = std::chrono::system_clock::now();
+    // Room for the incoming event counts towards the limit; the ring's own
+    // capacity already enforces maxEvents
+    const size_t incomingEvents = incomingBytes > 0 ? 1 : 0;
+
+    while (true) {
+        size_t resident = residentBytes.load(std::memory_order_relaxed);
+        bool overBytes = maxBytes > 0 && resident + incomingBytes > maxBytes;
+        // Staged events count as resident
+        bool overCount = eventBuffer->nextSequence() - eventBuffer->tail() + incomingEvents > eventRetention.maxEvents;
+        const auto* oldest = eventBuffer->oldest();
+        if (oldest == nullptr) {
+            // Only staged events are left; publish them so they can be evicted
+            if ((overBytes || overCount) && !stagedEvents.empty()) {
+                commitStaged();
+                continue;
+            }
+            break;
         }
-        eventBuffer.push_back(std::move(newTimedEvent));
-        bufferCV.notify_all();
+        bool overAge = maxAge.count() > 0 && now - (*oldest)->timestamp > maxAge;
+        bool overHot = cold && now - (*oldest)->timestamp > coldTier.after;
+        if (!overBytes && !overCount && !overAge && !overHot) {
+            break;
+        }
+
+        evictOldest(/*handOver=*/true);
     }
 }
 
+// Evict the oldest published event, first handing it to the cold tier or
+// journal if asked to. Producer thread only; the ring must not be empty.
+void MidasReceiver::evictOldest(bool handOver) {
+    const auto& oldest = *eventBuffer->oldest();
+    size_t footprint = oldest->footprint();
+    // Hand over before eviction, so readers always find it in one tier
+    if (handOver && cold) {
+        cold->add(oldest);
+    } else if (handOver && journal) {
+        journal->append(*oldest);
+    }
+    eventBuffer->evictOldest();
+    eventBuffer->reclaim(); // residentBytes drops when the storage is released
+    evictedEvents.store(evictedEvents.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    evictedBytes.store(evictedBytes.load(std::memory_order_relaxed) + footprint, std::memory_order_relaxed);
+}
 
-// Process message (add to buffer with timestamp)
-void MidasReceiver::processMessage(HNDLE hBuf, HNDLE id, EVENT_HEADER* pheader, void* message) {
-    TimedMessage timedMessage;
-    timedMessage.timestamp = std::chrono::system_clock::now();
-    timedMessage.message = message; // Store the message data
+// Ingest thread: a run starts or ends here in the event stream. Without
+// decode workers every earlier event is already staged; with them, the
+// boundary waits until the pipeline has published what was submitted before it.
+void MidasReceiver::markRunBoundary(INT transition, INT runNumber, std::chrono::system_clock::time_point at) {
+    {
+        std::lock_guard<std::mutex> lock(runBoundaryMutex);
+        runBoundaries.push_back({transition, runNumber, at, pipeline ? pipeline->submittedCount() : 0});
+        runBoundaryPending.store(true, std::memory_order_release);
+    }
+    if (pipeline) {
+        pipeline->runExclusive([this] { applyRunBoundaries(); });
+    } else {
+        applyRunBoundaries();
+    }
+}
 
-    // Lock buffer for thread safety
+// Publisher: apply the run boundaries that every earlier event has reached,
+// then release the runs that sealed
+void MidasReceiver::applyRunBoundaries() {
+    if (!runBoundaryPending.load(std::memory_order_acquire)) {
+        return;
+    }
+    uint64_t published = pipeline ? pipeline->publishedCount() : UINT64_MAX;
     {
-        std::lock_guard<std::mutex> lock(messageBufferMutex);
-        if (messageBuffer.size() >= maxBufferSize) {
-            messageBuffer.pop_front(); // Remove oldest message if buffer is full
+        std::lock_guard<std::mutex> lock(runBoundaryMutex);
+        while (!runBoundaries.empty() && runBoundaries.front().submitted <= published) {
+            const RunBoundary& boundary = runBoundaries.front();
+            uint64_t sequence = eventBuffer->nextSequence();
+            if (boundary.transition == TR_START) {
+                runSegments->begin(boundary.runNumber, sequence, boundary.at);
+            } else {
+                runSegments->end(sequence, boundary.at, boundary.transition == TR_STARTABORT);
+            }
+            runBoundaries.pop_front();
         }
-        messageBuffer.push_back(timedMessage);
+        runBoundaryPending.store(!runBoundaries.empty(), std::memory_order_relaxed);
+    }
+    releaseRuns();
+}
+
+// Publisher: take the sealed runs RunRetentionPolicy no longer keeps out of
+// the event buffer, in one go
+void MidasReceiver::releaseRuns() {
+    uint64_t end = runSegments->takeExpired(std::chrono::system_clock::now());
+    while (eventBuffer->tail() < end) {
+        if (eventBuffer->oldest() == nullptr) {
+            if (stagedEvents.empty()) {
+                break;
+            }
+            commitStaged(); // Staged events of the run are released too
+            continue;
+        }
+        evictOldest(runSegments->spills());
+    }
+}
+
+
+// Parse and store a message; the buffer manager's copy is gone after we return
+void MidasReceiver::deliverMessage(const EVENT_HEADER* header, const char* message) {
+    messageStore->add(static_cast<INT>(header->trigger_mask), message, header->data_size, nextTimestamp());
+    messageNotifier.published(messageStore->ring().head());
+}
+
+// One summary for all loss since the last report, instead of a message per gap
+void MidasReceiver::reportSerialLoss() {
+    SerialLossReport report = serialGaps.takeReport();
+    if (report.gaps > 0) {
+        cm_msg(MERROR, "MidasReceiver::reportSerialLoss",
+               "Buffer %s, run %d: %llu events missing in %llu serial gaps (first: event ID %u, serials %u-%u)",
+               bufferName.c_str(), serialGaps.currentRun(), static_cast<unsigned long long>(report.missingEvents),
+               static_cast<unsigned long long>(report.gaps), report.firstGap.eventId, report.firstGap.firstMissing,
+               report.firstGap.lastMissing);
+    }
+    if (report.outOfOrder > 0) {
+        cm_msg(MERROR, "MidasReceiver::reportSerialLoss", "Buffer %s, run %d: %llu events arrived out of order",
+               bufferName.c_str(), serialGaps.currentRun(), static_cast<unsigned long long>(report.outOfOrder));
     }
 }
 
 // Process transition (add to buffer with timestamp)
-INT MidasReceiver::processTransition(INT run_number, char* error) {
+INT MidasReceiver::deliverTransition(INT transition, INT run_number, char* error) {
+    if (transition == TR_START) {
+        reportSerialLoss(); // Attribute what we have to the run that just ended
+        serialGaps.beginRun(run_number);
+    }
+
     TimedTransition timedTransition;
-    timedTransition.timestamp = std::chrono::system_clock::now();
+    timedTransition.timestamp = nextTimestamp();
+    if (transition == TR_START) {
+        aggregates->beginRun(run_number, timedTransition.timestamp);
+    }
+    if (fileWriter) {
+        if (transition == TR_START) {
+            fileWriter->beginRun(run_number, timedTransition.timestamp);
+        } else if (transition == TR_STOP || transition == TR_STARTABORT) {
+            fileWriter->endRun(timedTransition.timestamp);
+        }
+    }
+    if (transition == TR_START || transition == TR_STOP || transition == TR_STARTABORT) {
+        markRunBoundary(transition, run_number, timedTransition.timestamp);
+    }
+    timedTransition.sequence = transitionBuffer->head();
+    timedTransition.transition = transition;
     timedTransition.run_number = run_number;
     std::strncpy(timedTransition.error, error, sizeof(timedTransition.error) - 1);
 
-    // Lock buffer for thread safety
-    {
-        std::lock_guard<std::mutex> lock(transitionBufferMutex);
-        if (transitionBuffer.size() >= maxBufferSize) {
-            transitionBuffer.pop_front(); // Remove oldest transition if buffer is full
-        }
-        transitionBuffer.push_back(timedTransition);
-    }
+    transitionBuffer->push(timedTransition); // Oldest transition is evicted if the ring is full
+    transitionNotifier.published(transitionBuffer->head());
 
     return SUCCESS;
 }
 
 
-std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getLatestEvents(size_t n) {
-    std::vector<std::shared_ptr<TimedEvent>> events;
-    std::lock_guard<std::mutex> lock(eventBufferMutex);
+// Wall-clock time for a new record, never earlier than the previous one
+// (system_clock may step backwards), so every ring stays time-ordered
+std::chrono::system_clock::time_point MidasReceiver::nextTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    if (now < lastTimestamp) {
+        now = lastTimestamp;
+    }
+    lastTimestamp = now;
+    return now;
+}
+
+// Copy the newest n records of a ring
+template <typename T>
+static std::vector<T> latestFromRing(const SequencedRing<T>& ring, size_t n) {
+    uint64_t head = ring.head();
+    uint64_t from = head > n ? head - n : 0;
+    return ring.copyRange(from, head);
+}
 
-    size_t start = eventBuffer.size() > n ? eventBuffer.size() - n : 0;
-    for (size_t i = start; i < eventBuffer.size(); ++i) {
-        events.push_back(eventBuffer[i]);
+// Copy every record newer than `since`, keeping at most the newest n.
+// The ring is time-ordered, so the first match is found by binary search.
+template <typename T, typename TimeOf>
+static std::vector<T> latestFromRingSince(const SequencedRing<T>& ring, size_t n,
+                                          std::chrono::system_clock::time_point since, TimeOf timeOf) {
+    std::vector<T> records;
+    typename SequencedRing<T>::ReadGuard guard(ring);
+    uint64_t head = ring.head();
+
+    uint64_t first = ring.partitionPoint([&](const T& record) { return timeOf(record) > since; }, head);
+    if (head - first > n) {
+        first = head - n;
     }
-    return events;
+
+    records.reserve(static_cast<size_t>(head - first));
+    ring.visit(first, head, [&records](uint64_t, const T& record) { records.push_back(record); });
+    return records;
 }
 
-std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getLatestEvents(size_t n, std::chrono::system_clock::time_point since) {
-    std::vector<std::shared_ptr<TimedEvent>> events;
-    std::lock_guard<std::mutex> lock(eventBufferMutex);
+// First record newer than `since`, by binary search over the time-ordered ring
+template <typename T, typename TimeOf>
+static uint64_t firstAfter(const SequencedRing<T>& ring, std::chrono::system_clock::time_point since, TimeOf timeOf) {
+    typename SequencedRing<T>::ReadGuard guard(ring);
+    return ring.partitionPoint([&](const T& record) { return timeOf(record) > since; });
+}
 
-    std::vector<std::shared_ptr<TimedEvent>> filteredEvents;
-    for (auto const& e : eventBuffer) {
-        if (e->timestamp > since) {
-            filteredEvents.push_back(e);
-        }
+// Read up to maxCount records starting at cursor, in O(maxCount)
+template <typename T>
+static MidasReceiver::Batch<T> readFromRing(const SequencedRing<T>& ring, uint64_t cursor, size_t maxCount) {
+    MidasReceiver::Batch<T> batch;
+    typename SequencedRing<T>::ReadGuard guard(ring);
+    uint64_t tail = ring.tail();
+    uint64_t head = ring.head();
+
+    if (cursor < tail) {
+        batch.missed = tail - cursor;
+        cursor = tail;
+    }
+    if (cursor >= head) {
+        batch.nextCursor = cursor; // Nothing new yet
+        return batch;
     }
+    uint64_t end = (head - cursor > maxCount) ? cursor + maxCount : head;
 
-    size_t start = filteredEvents.size() > n ? filteredEvents.size() - n : 0;
-    for (size_t i = start; i < filteredEvents.size(); ++i) {
-        events.push_back(filteredEvents[i]);
+    batch.records.reserve(static_cast<size_t>(end - cursor));
+    uint64_t next = ring.visit(cursor, end, [&batch](uint64_t, const T& record) { batch.records.push_back(record); });
+
+    // Anything evicted between the tail check and the walk also counts as missed
+    batch.missed += (next - cursor) - batch.records.size();
+    batch.nextCursor = next;
+    return batch;
+}
+
+static std::chrono::system_clock::time_point timeOfEvent(const std::shared_ptr<MidasReceiver::TimedEvent>& e) {
+    return e->timestamp;
+}
+
+static std::chrono::system_clock::time_point timeOfMessage(const MidasReceiver::TimedMessage& m) {
+    return m.timestamp;
+}
+
+static std::chrono::system_clock::time_point timeOfTransition(const MidasReceiver::TimedTransition& t) {
+    return t.timestamp;
+}
+
+std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getLatestEvents(size_t n) {
+    if (!journal && !cold) {
+        return latestFromRing(*eventBuffer, n);
     }
-    return events;
+    uint64_t head = eventBuffer->head();
+    uint64_t from = head > n ? head - n : 0;
+    return readEventsAcrossTiers(from, static_cast<size_t>(head - from)).records;
 }
 
-std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getLatestEvents(std::chrono::system_clock::time_point since) {
-    std::vector<std::shared_ptr<TimedEvent>> events;
-    std::lock_guard<std::mutex> lock(eventBufferMutex);
+std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getLatestEvents(size_t n, std::chrono::system_clock::time_point since) {
+    if (!journal && !cold) {
+        return latestFromRingSince(*eventBuffer, n, since, timeOfEvent);
+    }
 
-    for (auto it = eventBuffer.begin(); it != eventBuffer.end(); ++it) {
-        if ((*it)->timestamp > since) {
-            for (; it != eventBuffer.end(); ++it) {
-                events.push_back(*it);
-            }
-            break;
-        }
+    uint64_t head, first;
+    {
+        SequencedRing<std::shared_ptr<TimedEvent>>::ReadGuard guard(*eventBuffer);
+        head = eventBuffer->head();
+        first = eventBuffer->partitionPoint(
+            [since](const std::shared_ptr<TimedEvent>& e) { return e->timestamp > since; }, head);
+    }
+    // Everything in the ring qualifies, so older matches may be in a lower tier
+    if (first <= eventBuffer->tail() && cold && cold->endSequence() > cold->firstSequence()) {
+        first = std::min(first, cold->sequenceAfter(since));
+    }
+    if (first <= (cold ? cold->firstSequence() : eventBuffer->tail()) && journal &&
+        journal->endSequence() > journal->firstSequence()) {
+        first = std::min(first, journal->sequenceAfter(since));
+    }
+    if (head - first > n) {
+        first = head - n;
     }
-    return events;
+    return readEventsAcrossTiers(first, static_cast<size_t>(head - first)).records;
+}
+
+std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getLatestEvents(std::chrono::system_clock::time_point since) {
+    return getLatestEvents(journal || cold ? SIZE_MAX : eventBuffer->capacity(), since);
 }
 
 std::vector<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::getWholeBuffer() {
-    std::vector<std::shared_ptr<TimedEvent>> events;
-    std::lock_guard<std::mutex> lock(eventBufferMutex);
-    events.insert(events.end(), eventBuffer.begin(), eventBuffer.end());
-    return events;
+    return eventBuffer->copyRange(0, eventBuffer->head());
 }
 
 
 // Retrieve all messages (including timestamps)
 std::vector<MidasReceiver::TimedMessage> MidasReceiver::getMessageBuffer() {
-    std::vector<TimedMessage> messages;
-    std::lock_guard<std::mutex> lock(messageBufferMutex); // Ensure thread safety
-    messages.insert(messages.end(), messageBuffer.begin(), messageBuffer.end()); // Directly use TimedMessage from the buffer
-    return messages;
+    return messageStore->ring().copyRange(0, messageStore->ring().head());
 }
 
 // Retrieve the latest N messages (including timestamps)
 std::vector<MidasReceiver::TimedMessage> MidasReceiver::getLatestMessages(size_t n) {
-    std::vector<TimedMessage> messages;
-    std::lock_guard<std::mutex> lock(messageBufferMutex);
-
-    size_t start = messageBuffer.size() > n ? messageBuffer.size() - n : 0;
-    for (size_t i = start; i < messageBuffer.size(); ++i) {
-        messages.push_back(messageBuffer[i]); // Directly use the entire TimedMessage from the buffer
-    }
-    return messages;
+    return latestFromRing(messageStore->ring(), n);
 }
 
 // Retrieve the latest N messages since a specific timestamp (including timestamps)
 std::vector<MidasReceiver::TimedMessage> MidasReceiver::getLatestMessages(size_t n, std::chrono::system_clock::time_point since) {
-    std::vector<TimedMessage> messages;
-    std::lock_guard<std::mutex> lock(messageBufferMutex);
-
-    // Create a temporary list to store messages that are after the 'since' timestamp
-    std::vector<TimedMessage> filteredMessages;
-
-    // Filter messages based on the 'since' timestamp
-    for (const auto& timedMessage : messageBuffer) {
-        if (timedMessage.timestamp > since) {
-            filteredMessages.push_back(timedMessage); // Store the entire TimedMessage (including timestamp)
-        }
-    }
-
-    // Now return the most recent 'n' messages from the filtered list
-    size_t start = filteredMessages.size() > n ? filteredMessages.size() - n : 0;
-    for (size_t i = start; i < filteredMessages.size(); ++i) {
-        messages.push_back(filteredMessages[i]);
-    }
-
-    return messages;
+    return latestFromRingSince(messageStore->ring(), n, since, timeOfMessage);
 }
 
 // Retrieve messages since a specific timestamp (including timestamps)
 std::vector<MidasReceiver::TimedMessage> MidasReceiver::getLatestMessages(std::chrono::system_clock::time_point since) {
-    std::vector<TimedMessage> messages;
-    std::lock_guard<std::mutex> lock(messageBufferMutex);
-
-    // Iterate through the message buffer starting from the earliest message
-    for (auto it = messageBuffer.begin(); it != messageBuffer.end(); ++it) {
-        if (it->timestamp > since) {
-            // Add all subsequent messages (already in time order) to the result
-            for (; it != messageBuffer.end(); ++it) {
-                messages.push_back(*it); // Directly use the entire TimedMessage from the buffer
-            }
-            break; // Exit the loop once we find the first message after the given timestamp
-        }
-    }
-    return messages;
+    return latestFromRingSince(messageStore->ring(), messageStore->ring().capacity(), since, timeOfMessage);
 }
 
 // Retrieve all transitions (including timestamps)
 std::vector<MidasReceiver::TimedTransition> MidasReceiver::getTransitionBuffer() {
-    std::vector<TimedTransition> transitions;
-    std::lock_guard<std::mutex> lock(transitionBufferMutex); // Ensure thread safety
-    transitions.insert(transitions.end(), transitionBuffer.begin(), transitionBuffer.end()); // Directly use TimedTransition from the buffer
-    return transitions;
+    return transitionBuffer->copyRange(0, transitionBuffer->head());
 }
 
 // Retrieve the latest N transitions (including timestamps)
 std::vector<MidasReceiver::TimedTransition> MidasReceiver::getLatestTransitions(size_t n) {
-    std::vector<TimedTransition> transitions;
-    std::lock_guard<std::mutex> lock(transitionBufferMutex);
-
-    size_t start = transitionBuffer.size() > n ? transitionBuffer.size() - n : 0;
-    for (size_t i = start; i < transitionBuffer.size(); ++i) {
-        transitions.push_back(transitionBuffer[i]); // Directly use the entire TimedTransition from the buffer
-    }
-    return transitions;
+    return latestFromRing(*transitionBuffer, n);
 }
 
 // Retrieve the latest N transitions since a specific timestamp (including timestamps)
 std::vector<MidasReceiver::TimedTransition> MidasReceiver::getLatestTransitions(size_t n, std::chrono::system_clock::time_point since) {
-    std::vector<TimedTransition> transitions;
-    std::lock_guard<std::mutex> lock(transitionBufferMutex);
+    return latestFromRingSince(*transitionBuffer, n, since, timeOfTransition);
+}
+
+// Retrieve transitions since a specific timestamp (including timestamps)
+std::vector<MidasReceiver::TimedTransition> MidasReceiver::getLatestTransitions(std::chrono::system_clock::time_point since) {
+    return latestFromRingSince(*transitionBuffer, transitionBuffer->capacity(), since, timeOfTransition);
+}
+
+
+MidasReceiver::EventSnapshot MidasReceiver::snapshotEvents(uint64_t cursor) const {
+    return EventSnapshot(*eventBuffer, cursor, UINT64_MAX);
+}
+
+MidasReceiver::EventSnapshot MidasReceiver::snapshotLatestEvents(size_t n) const {
+    uint64_t head = eventBuffer->head();
+    return EventSnapshot(*eventBuffer, head > n ? head - n : 0, head);
+}
+
+MidasReceiver::EventSnapshot MidasReceiver::snapshotEventsSince(std::chrono::system_clock::time_point since) const {
+    return EventSnapshot(*eventBuffer, firstAfter(*eventBuffer, since, timeOfEvent), UINT64_MAX);
+}
+
+MidasReceiver::MessageSnapshot MidasReceiver::snapshotMessages(uint64_t cursor) const {
+    return MessageSnapshot(messageStore->ring(), cursor, UINT64_MAX);
+}
+
+MidasReceiver::MessageSnapshot MidasReceiver::snapshotMessagesSince(std::chrono::system_clock::time_point since) const {
+    return MessageSnapshot(messageStore->ring(), firstAfter(messageStore->ring(), since, timeOfMessage), UINT64_MAX);
+}
+
+MidasReceiver::TransitionSnapshot MidasReceiver::snapshotTransitions(uint64_t cursor) const {
+    return TransitionSnapshot(*transitionBuffer, cursor, UINT64_MAX);
+}
+
+MidasReceiver::TransitionSnapshot MidasReceiver::snapshotTransitionsSince(
+    std::chrono::system_clock::time_point since) const {
+    return TransitionSnapshot(*transitionBuffer, firstAfter(*transitionBuffer, since, timeOfTransition), UINT64_MAX);
+}
+
+MidasReceiver::Batch<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::readEventsFrom(uint64_t cursor, size_t maxCount) {
+    auto batch = readEventsAcrossTiers(cursor, maxCount);
+    recordReadLatency(batch.records);
+    return batch;
+}
+
+// Cursor read over the journal, the cold tier and then the ring. Each tier
+// receives an event before the one above lets go of it, so together they
+// are contiguous apart from what was dropped off the bottom.
+MidasReceiver::Batch<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::readEventsAcrossTiers(uint64_t cursor, size_t maxCount) {
+    if (!journal && !cold) {
+        return readFromRing(*eventBuffer, cursor, maxCount);
+    }
 
-    // Create a temporary list to store transitions that are after the 'since' timestamp
-    std::vector<TimedTransition> filteredTransitions;
+    Batch<std::shared_ptr<TimedEvent>> batch;
+    for (int attempt = 0; attempt < 4 && batch.records.size() < maxCount; ++attempt) {
+        size_t room = maxCount - batch.records.size();
+        uint64_t tail = eventBuffer->tail();
+        if (cursor < tail) {
+            uint64_t coldFirst = cold ? cold->firstSequence() : tail;
+            bool fromCold = cursor >= coldFirst;
+            uint64_t end = fromCold ? tail : coldFirst;
+            std::vector<std::shared_ptr<TimedEvent>> events;
+            if (fromCold) {
+                events = cold->read(cursor, end, room);
+            } else if (journal) {
+                events = journal->read(cursor, end, room);
+            }
+            uint64_t next = events.empty() ? end : events.front()->sequence;
+            if (fromCold && next > cursor && attempt < 3 && cold->firstSequence() > cursor) {
+                continue; // Dropped while we looked; it is in the journal now
+            }
+            for (auto& event : events) {
+                batch.missed += event->sequence - cursor;
+                cursor = event->sequence + 1;
+                batch.records.push_back(std::move(event));
+            }
+            if (batch.records.size() < maxCount && cursor < end) {
+                batch.missed += end - cursor; // Dropped from every tier
+                cursor = end;
+            }
+            continue;
+        }
 
-    // Filter transitions based on the 'since' timestamp
-    for (const auto& timedTransition : transitionBuffer) {
-        if (timedTransition.timestamp > since) {
-            filteredTransitions.push_back(timedTransition); // Store the entire TimedTransition (including timestamp)
+        auto recent = readFromRing(*eventBuffer, cursor, room);
+        if (recent.missed > 0 && attempt < 3) {
+            continue; // Evicted while we looked; it is in a lower tier now
+        }
+        batch.missed += recent.missed;
+        for (auto& event : recent.records) {
+            batch.records.push_back(std::move(event));
         }
+        cursor = recent.nextCursor;
+        break;
     }
+    batch.nextCursor = cursor;
+    return batch;
+}
+
+std::vector<MidasReceiver::TimedMessage> MidasReceiver::findMessages(const MessageFilter& filter) const {
+    return messageStore->find(filter);
+}
 
-    // Now return the most recent 'n' transitions from the filtered list
-    size_t start = filteredTransitions.size() > n ? filteredTransitions.size() - n : 0;
-    for (size_t i = start; i < filteredTransitions.size(); ++i) {
-        transitions.push_back(filteredTransitions[i]);
+MidasReceiver::Batch<MidasReceiver::TimedMessage> MidasReceiver::readMessagesFrom(uint64_t cursor, size_t maxCount) {
+    return readFromRing(messageStore->ring(), cursor, maxCount);
+}
+
+MidasReceiver::Batch<MidasReceiver::TimedTransition> MidasReceiver::readTransitionsFrom(uint64_t cursor, size_t maxCount) {
+    return readFromRing(*transitionBuffer, cursor, maxCount);
+}
+
+// Block on the ring's notifier until cursor + minCount is reached, then read
+template <typename T>
+static MidasReceiver::Batch<T> waitOnRing(const SequencedRing<T>& ring, RingNotifier& notifier,
+                                          uint64_t cursor, size_t minCount,
+                                          std::chrono::milliseconds timeout, size_t maxCount) {
+    uint64_t target = cursor + (minCount > 0 ? minCount : 1);
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    notifier.waitUntil(target, deadline, [&ring] { return ring.head(); });
+    return readFromRing(ring, cursor, maxCount);
+}
+
+MidasReceiver::Batch<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::waitForEvents(
+    uint64_t cursor, size_t minCount, std::chrono::milliseconds timeout, size_t maxCount) {
+    uint64_t target = cursor + (minCount > 0 ? minCount : 1);
+    eventNotifier.waitUntil(target, std::chrono::steady_clock::now() + timeout,
+                            [this] { return eventBuffer->head(); });
+    auto batch = readEventsAcrossTiers(cursor, maxCount);
+    recordReadLatency(batch.records);
+    return batch;
+}
+
+// One clock read per batch; every event in it counts as read at that moment
+void MidasReceiver::recordReadLatency(const std::vector<std::shared_ptr<TimedEvent>>& events) {
+    if (events.empty()) {
+        return;
+    }
+    auto now = std::chrono::system_clock::now();
+    for (const auto& event : events) {
+        auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(now - event->timestamp).count();
+        ingestToRead.record(waited > 0 ? static_cast<uint64_t>(waited) : 0);
     }
+}
 
-    return transitions;
+MidasReceiver::Batch<MidasReceiver::TimedMessage> MidasReceiver::waitForMessages(
+    uint64_t cursor, size_t minCount, std::chrono::milliseconds timeout, size_t maxCount) {
+    return waitOnRing(messageStore->ring(), messageNotifier, cursor, minCount, timeout, maxCount);
 }
 
-// Retrieve transitions since a specific timestamp (including timestamps)
-std::vector<MidasReceiver::TimedTransition> MidasReceiver::getLatestTransitions(std::chrono::system_clock::time_point since) {
-    std::vector<TimedTransition> transitions;
-    std::lock_guard<std::mutex> lock(transitionBufferMutex);
-
-    // Iterate through the transition buffer starting from the earliest transition
-    for (auto it = transitionBuffer.begin(); it != transitionBuffer.end(); ++it) {
-        if (it->timestamp > since) {
-            // Add all subsequent transitions (already in time order) to the result
-            for (; it != transitionBuffer.end(); ++it) {
-                transitions.push_back(*it); // Directly use the entire TimedTransition from the buffer
-            }
-            break; // Exit the loop once we find the first transition after the given timestamp
+MidasReceiver::Batch<MidasReceiver::TimedTransition> MidasReceiver::waitForTransitions(
+    uint64_t cursor, size_t minCount, std::chrono::milliseconds timeout, size_t maxCount) {
+    return waitOnRing(*transitionBuffer, transitionNotifier, cursor, minCount, timeout, maxCount);
+}
+
+int MidasReceiver::getEventNotifyFd() {
+    return eventNotifier.fd();
+}
+
+void MidasReceiver::acknowledgeEventNotifyFd() {
+    eventNotifier.acknowledgeFd();
+}
+
+MidasReceiver::BufferUsage MidasReceiver::getBufferUsage() const {
+    BufferUsage usage;
+    usage.residentEvents = eventBuffer->size();
+    usage.residentBytes = residentBytes.load(std::memory_order_relaxed);
+    usage.receivedEvents = receivedEvents.load(std::memory_order_relaxed);
+    usage.receivedBytes = receivedBytes.load(std::memory_order_relaxed);
+    usage.evictedEvents = evictedEvents.load(std::memory_order_relaxed);
+    usage.evictedBytes = evictedBytes.load(std::memory_order_relaxed);
+    if (cold) {
+        auto coldUsage = cold->usage();
+        usage.coldEvents = coldUsage.events;
+        usage.coldCompressedBytes = coldUsage.compressedBytes;
+        usage.coldRawBytes = coldUsage.rawBytes + coldUsage.pendingBytes;
+        usage.coldDroppedEvents = coldUsage.droppedEvents;
+    }
+    if (journal) {
+        usage.journalEvents = journal->endSequence() - journal->firstSequence();
+        usage.journalBytes = journal->sizeBytes();
+    }
+    return usage;
+}
+
+ReceiverStats MidasReceiver::getStats() const {
+    ReceiverStats stats;
+    stats.bufferName = bufferName;
+    if (running) {
+        stats.uptimeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+    stats.eventsPerSecond = eventRate.load(std::memory_order_relaxed);
+    stats.bytesPerSecond = byteRate.load(std::memory_order_relaxed);
+
+    BufferUsage usage = getBufferUsage();
+    stats.callbacks = callbacks.load(std::memory_order_relaxed);
+    stats.receivedEvents = usage.receivedEvents;
+    stats.receivedBytes = usage.receivedBytes;
+    stats.evictedEvents = usage.evictedEvents;
+    stats.evictedBytes = usage.evictedBytes;
+    stats.residentEvents = usage.residentEvents;
+    stats.residentBytes = usage.residentBytes;
+    stats.capacityEvents = eventRetention.maxEvents;
+    stats.capacityBytes = eventRetention.maxBytes;
+
+    stats.serialGaps = serialGaps.totalGaps();
+    {
+        std::lock_guard<std::mutex> lock(odbCacheMutex);
+        if (odbCache) {
+            OdbCache::Stats odb = odbCache->stats();
+            stats.odbCacheHits = odb.hits;
+            stats.odbCacheMisses = odb.misses;
+        }
+    }
+    if (const EventSampler* s = sampler.get()) {
+        stats.seenEvents = s->totalSeen();
+        stats.sampledEvents = s->totalSampled();
+    } else {
+        stats.seenEvents = stats.sampledEvents = stats.receivedEvents;
+    }
+    if (const EventPipeline* p = pipeline.get()) {
+        stats.stagingStalls = p->stagingStalls();
+    }
+    if (const ShmRingWriter* ring = shmRing.get()) {
+        stats.shmRingEvents = ring->written();
+        stats.shmRingDrops = ring->dropped();
+    }
+    if (const EventFileWriter* writer = fileWriter.get()) {
+        EventFileStats files = writer->stats();
+        stats.fileWriterEvents = files.writtenEvents;
+        stats.fileWriterDrops = files.droppedEvents;
+    }
+    {
+        std::lock_guard<std::mutex> lock(subscribersMutex);
+        for (const auto& subscription : subscribers) {
+            SubscriptionStats s = subscription->stats();
+            stats.subscriberDrops += s.droppedOldest + s.droppedNewest;
         }
     }
-    return transitions;
+
+    stats.callbackTime = callbackTime.summary();
+    stats.ingestToRead = ingestToRead.summary();
+    return stats;
+}
+
+bool MidasReceiver::exportStats(const std::string& target, StatsFormat format) const {
+    ReceiverStats stats = getStats();
+    return exportStatsText(format == StatsFormat::Json ? stats.toJson() : stats.toPrometheus(), target);
+}
+
+// Fill in what RunSegments leaves to the receiver
+void MidasReceiver::completeRun(RunSummary& run) const {
+    uint64_t from = std::max(run.firstSequence, eventBuffer->tail());
+    uint64_t to = std::min(run.endSequence, eventBuffer->head());
+    run.residentEvents = to > from ? to - from : 0;
+    SerialLoss loss = serialGaps.loss(run.runNumber);
+    run.serialGaps = loss.gaps;
+    run.missingEvents = loss.missingEvents;
+}
+
+bool MidasReceiver::getRun(int runNumber, RunSummary& out) const {
+    if (!runSegments->find(runNumber, out)) {
+        return false;
+    }
+    completeRun(out);
+    return true;
+}
+
+std::vector<RunSummary> MidasReceiver::getRuns() const {
+    std::vector<RunSummary> runs = runSegments->runs();
+    for (auto& run : runs) {
+        completeRun(run);
+    }
+    return runs;
+}
+
+MidasReceiver::Batch<std::shared_ptr<MidasReceiver::TimedEvent>> MidasReceiver::readRunEvents(
+    int runNumber, uint64_t cursor, size_t maxCount) {
+    RunSummary run;
+    if (!runSegments->find(runNumber, run)) {
+        Batch<std::shared_ptr<TimedEvent>> none;
+        none.nextCursor = cursor;
+        return none;
+    }
+    if (cursor < run.firstSequence) {
+        cursor = run.firstSequence;
+    }
+    if (cursor >= run.endSequence) {
+        Batch<std::shared_ptr<TimedEvent>> none;
+        none.nextCursor = cursor; // The end of a sealed run, or nothing new in an open one
+        return none;
+    }
+    auto batch = readEventsAcrossTiers(cursor, static_cast<size_t>(std::min<uint64_t>(maxCount, run.endSequence - cursor)));
+
+    // Past evicted events the read skips ahead, possibly beyond the run
+    while (!batch.records.empty() && batch.records.back()->sequence >= run.endSequence) {
+        batch.records.pop_back();
+    }
+    batch.nextCursor = std::min(batch.nextCursor, run.endSequence);
+    batch.missed = batch.nextCursor - cursor - batch.records.size();
+    recordReadLatency(batch.records);
+    return batch;
+}
+
+// An open run's view ends at its newest event when the view is taken
+MidasReceiver::EventSnapshot MidasReceiver::snapshotRun(int runNumber) const {
+    RunSummary run;
+    if (!runSegments->find(runNumber, run)) {
+        return EventSnapshot(*eventBuffer, 0, 0);
+    }
+    return EventSnapshot(*eventBuffer, run.firstSequence, run.endSequence);
+}
+
+std::vector<SamplingCount> MidasReceiver::getSamplingCounts() const {
+    return sampler ? sampler->counts() : std::vector<SamplingCount>();
+}
+
+int MidasReceiver::getCurrentRun() const {
+    return serialGaps.currentRun();
+}
+
+SerialLoss MidasReceiver::getSerialLoss(int runNumber) const {
+    return serialGaps.loss(runNumber);
+}
+
+std::vector<SerialGap> MidasReceiver::getSerialGaps(int runNumber) const {
+    return serialGaps.gaps(runNumber);
+}
+
+uint64_t MidasReceiver::getEventCursor() const {
+    return eventBuffer->head();
+}
+
+uint64_t MidasReceiver::getMessageCursor() const {
+    return messageStore->ring().head();
+}
+
+uint64_t MidasReceiver::getTransitionCursor() const {
+    return transitionBuffer->head();
 }
 
 
-std::string MidasReceiver::getOdb(const std::string& path) {
+std::string MidasReceiver::getOdb(const std::string& path, uint64_t* version) {
+    std::shared_ptr<OdbCache> cache;
+    {
+        std::lock_guard<std::mutex> lock(odbCacheMutex);
+        cache = odbCache;
+    }
+    if (cache) {
+        return cache->get(path, version);
+    }
+
     // Connect to the requested ODB path
     midas::odb o(path);
+    if (version) {
+        *version = 0;
+    }
 
     // Return the JSON representation as a string
     return o.dump();
 }
 
+OdbCache::Changes MidasReceiver::getOdbChanges(uint64_t sinceVersion) const {
+    std::shared_ptr<OdbCache> cache;
+    {
+        std::lock_guard<std::mutex> lock(odbCacheMutex);
+        cache = odbCache;
+    }
+    if (cache) {
+        return cache->changedSince(sinceVersion);
+    }
+    OdbCache::Changes changes;
+    changes.complete = false;
+    return changes;
+}
+
 
 
 // Getter for listening state (thread-safe)
@@ -0,0 +1,197 @@
+#include "OdbCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+
+#include "odbxx.h"
+
+OdbCache::OdbCache(size_t maxEntries, size_t maxLoggedChanges)
+    : maxEntries(std::max<size_t>(maxEntries, 1)), maxLoggedChanges(std::max<size_t>(maxLoggedChanges, 1)) {}
+
+OdbCache::~OdbCache() {
+    clear();
+}
+
+// "/" for the root, otherwise a leading and no trailing slash. ODB names are
+// case-insensitive, so the cache key is lower case.
+std::string OdbCache::normalize(const std::string& path) {
+    std::string result = path.empty() || path[0] != '/' ? "/" + path : path;
+    while (result.size() > 1 && result.back() == '/') {
+        result.pop_back();
+    }
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return result;
+}
+
+// True if one path is the other or lies below it
+bool OdbCache::related(const std::string& a, const std::string& b) {
+    auto within = [](const std::string& path, const std::string& root) {
+        if (root == "/" || path == root) {
+            return true;
+        }
+        return path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/';
+    };
+    return within(a, b) || within(b, a);
+}
+
+std::string OdbCache::get(const std::string& path, uint64_t* version) {
+    const std::string key = normalize(path);
+    std::vector<std::unique_ptr<midas::odb>> unwatch;
+    uint64_t start;
+    bool needWatch = false;
+    bool open;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = !closed;
+        auto it = entries.find(key);
+        if (open && it != entries.end() && it->second.filled && it->second.changedAt <= it->second.fetchedAt) {
+            ++hits;
+            it->second.lastUsed = ++useClock;
+            if (version) {
+                *version = currentVersion;
+            }
+            return it->second.json;
+        }
+        if (open) {
+            ++misses;
+            if (it == entries.end()) {
+                evictIfFull(unwatch);
+                it = entries.emplace(key, Entry()).first;
+            }
+            it->second.lastUsed = ++useClock;
+            needWatch = !it->second.watcher;
+        }
+        start = currentVersion;
+    }
+    if (!open) {
+        // After clear(): a plain dump, caching and watching nothing
+        midas::odb subtree(path.empty() ? std::string("/") : path);
+        if (version) {
+            *version = 0;
+        }
+        return subtree.dump();
+    }
+    // No MIDAS call under the lock: watch callbacks take it on the yield thread
+    for (auto& watcher : unwatch) {
+        watcher->unwatch();
+    }
+
+    // Watch first, so a change during the dump below is not missed
+    if (needWatch) {
+        auto watcher = std::make_unique<midas::odb>(path.empty() ? std::string("/") : path);
+        watcher->watch([this](midas::odb& changedKey) { changed(changedKey.get_full_path()); });
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (!closed && it != entries.end() && !it->second.watcher) {
+                it->second.watcher = std::move(watcher);
+            }
+        }
+        if (watcher) {
+            // Another caller's watch won, the entry was evicted meanwhile, or
+            // clear() ran and nothing would ever remove this watch
+            watcher->unwatch();
+        }
+    }
+
+    midas::odb subtree(path.empty() ? std::string("/") : path);
+    std::string json = subtree.dump();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.watcher && start >= it->second.fetchedAt) {
+        it->second.json = json;
+        it->second.filled = true;
+        it->second.fetchedAt = start;
+    }
+    if (version) {
+        *version = start;
+    }
+    return json;
+}
+
+// Yield thread, from a watch callback
+void OdbCache::changed(const std::string& path) {
+    const std::string key = normalize(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    ++currentVersion;
+    changeLog.emplace_back(currentVersion, path);
+    while (changeLog.size() > maxLoggedChanges) {
+        changeLog.pop_front();
+    }
+    for (auto& [entryPath, entry] : entries) {
+        if (related(entryPath, key)) {
+            if (entry.filled && entry.changedAt <= entry.fetchedAt) {
+                ++invalidations;
+            }
+            entry.changedAt = currentVersion;
+        }
+    }
+}
+
+// Called with the lock held; the evicted watch is handed back to be removed
+// outside it
+void OdbCache::evictIfFull(std::vector<std::unique_ptr<midas::odb>>& unwatch) {
+    while (entries.size() >= maxEntries) {
+        auto victim = std::min_element(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        if (victim->second.watcher) {
+            unwatch.push_back(std::move(victim->second.watcher));
+        }
+        entries.erase(victim);
+    }
+}
+
+OdbCache::Changes OdbCache::changedSince(uint64_t since) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Changes changes;
+    changes.version = currentVersion;
+    if (since >= currentVersion) {
+        return changes;
+    }
+    // The log holds versions (front, currentVersion]; anything older is gone
+    changes.complete = !changeLog.empty() && changeLog.front().first <= since + 1;
+
+    std::set<std::string> seen;
+    for (const auto& [changeVersion, path] : changeLog) {
+        if (changeVersion > since && seen.insert(normalize(path)).second) {
+            changes.paths.push_back(path);
+        }
+    }
+    return changes;
+}
+
+uint64_t OdbCache::version() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return currentVersion;
+}
+
+OdbCache::Stats OdbCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.invalidations = invalidations;
+    result.entries = entries.size();
+    return result;
+}
+
+void OdbCache::clear() {
+    std::vector<std::unique_ptr<midas::odb>> unwatch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        for (auto& [path, entry] : entries) {
+            if (entry.watcher) {
+                unwatch.push_back(std::move(entry.watcher));
+            }
+        }
+        entries.clear();
+    }
+    for (auto& watcher : unwatch) {
+        watcher->unwatch();
+    }
+}
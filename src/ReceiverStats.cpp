@@ -0,0 +1,216 @@
+#include "ReceiverStats.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "midas.h"
+
+LatencyHistogram::LatencyHistogram() : counts(kBuckets) {
+}
+
+uint64_t LatencyHistogram::valueOf(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+    uint64_t lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    LatencySummary s;
+    std::vector<uint64_t> snapshot(kBuckets);
+    for (size_t i = 0; i < kBuckets; ++i) {
+        snapshot[i] = counts[i].load(std::memory_order_relaxed);
+        s.count += snapshot[i];
+    }
+    if (s.count == 0) {
+        return s;
+    }
+    s.meanNs = static_cast<double>(total.load(std::memory_order_relaxed)) / s.count;
+    s.maxNs = max.load(std::memory_order_relaxed);
+
+    // One pass over the buckets, filling the percentiles in increasing order
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    uint64_t* targets[] = {&s.p50Ns, &s.p90Ns, &s.p99Ns, &s.p999Ns};
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets && next < 4; ++i) {
+        seen += snapshot[i];
+        while (next < 4 && seen > 0 && seen >= static_cast<uint64_t>(std::ceil(quantiles[next] * s.count))) {
+            uint64_t value = valueOf(i);
+            *targets[next++] = value < s.maxNs ? value : s.maxNs;
+        }
+    }
+    return s;
+}
+
+static void jsonLatency(std::ostringstream& out, const char* name, const LatencySummary& l) {
+    out << "\"" << name << "\":{\"count\":" << l.count << ",\"mean_ns\":" << l.meanNs << ",\"p50_ns\":" << l.p50Ns
+        << ",\"p90_ns\":" << l.p90Ns << ",\"p99_ns\":" << l.p99Ns << ",\"p999_ns\":" << l.p999Ns
+        << ",\"max_ns\":" << l.maxNs << "}";
+}
+
+std::string ReceiverStats::toJson() const {
+    std::ostringstream out;
+    out << "{\"buffer\":\"" << bufferName << "\""
+        << ",\"uptime_s\":" << uptimeSeconds
+        << ",\"events_per_s\":" << eventsPerSecond
+        << ",\"bytes_per_s\":" << bytesPerSecond
+        << ",\"callbacks\":" << callbacks
+        << ",\"seen_events\":" << seenEvents
+        << ",\"sampled_events\":" << sampledEvents
+        << ",\"received_events\":" << receivedEvents
+        << ",\"received_bytes\":" << receivedBytes
+        << ",\"evicted_events\":" << evictedEvents
+        << ",\"evicted_bytes\":" << evictedBytes
+        << ",\"resident_events\":" << residentEvents
+        << ",\"resident_bytes\":" << residentBytes
+        << ",\"capacity_events\":" << capacityEvents
+        << ",\"capacity_bytes\":" << capacityBytes
+        << ",\"serial_gaps\":" << serialGaps
+        << ",\"staging_stalls\":" << stagingStalls
+        << ",\"subscriber_drops\":" << subscriberDrops
+        << ",\"odb_cache_hits\":" << odbCacheHits
+        << ",\"odb_cache_misses\":" << odbCacheMisses
+        << ",\"shm_ring_events\":" << shmRingEvents
+        << ",\"shm_ring_drops\":" << shmRingDrops
+        << ",\"file_writer_events\":" << fileWriterEvents
+        << ",\"file_writer_drops\":" << fileWriterDrops << ",";
+    jsonLatency(out, "callback_time", callbackTime);
+    out << ",";
+    jsonLatency(out, "ingest_to_read", ingestToRead);
+    out << "}\n";
+    return out.str();
+}
+
+static void promMetric(std::ostringstream& out, const std::string& labels, const char* name, const char* type,
+                       const char* help, uint64_t value) {
+    out << "# HELP midas_receiver_" << name << " " << help << "\n"
+        << "# TYPE midas_receiver_" << name << " " << type << "\n"
+        << "midas_receiver_" << name << labels << " " << value << "\n";
+}
+
+// Full precision: at the stream's default of 6 digits large values round,
+// and a series that should only grow can appear to step backwards
+static void promMetric(std::ostringstream& out, const std::string& labels, const char* name, const char* type,
+                       const char* help, double value) {
+    out << "# HELP midas_receiver_" << name << " " << help << "\n"
+        << "# TYPE midas_receiver_" << name << " " << type << "\n"
+        << "midas_receiver_" << name << labels << " " << std::setprecision(17) << value << "\n";
+}
+
+static void promLatency(std::ostringstream& out, const std::string& buffer, const char* name, const char* help,
+                        const LatencySummary& l) {
+    out << "# HELP midas_receiver_" << name << "_seconds " << help << "\n"
+        << "# TYPE midas_receiver_" << name << "_seconds summary\n";
+    const std::pair<const char*, uint64_t> quantiles[] = {
+        {"0.5", l.p50Ns}, {"0.9", l.p90Ns}, {"0.99", l.p99Ns}, {"0.999", l.p999Ns}, {"1", l.maxNs}};
+    for (const auto& q : quantiles) {
+        out << "midas_receiver_" << name << "_seconds{buffer=\"" << buffer << "\",quantile=\"" << q.first << "\"} "
+            << std::setprecision(17) << q.second * 1e-9 << "\n";
+    }
+    out << "midas_receiver_" << name << "_seconds_sum{buffer=\"" << buffer << "\"} " << std::setprecision(17)
+        << l.meanNs * l.count * 1e-9 << "\n"
+        << "midas_receiver_" << name << "_seconds_count{buffer=\"" << buffer << "\"} " << l.count << "\n";
+}
+
+std::string ReceiverStats::toPrometheus() const {
+    std::ostringstream out;
+    const std::string labels = "{buffer=\"" + bufferName + "\"}";
+    promMetric(out, labels, "uptime_seconds", "gauge", "Seconds since the receiver started", uptimeSeconds);
+    promMetric(out, labels, "events_per_second", "gauge", "Stored event rate", eventsPerSecond);
+    promMetric(out, labels, "bytes_per_second", "gauge", "Stored byte rate", bytesPerSecond);
+    promMetric(out, labels, "callbacks_total", "counter", "Deliveries from the event source", callbacks);
+    promMetric(out, labels, "seen_events_total", "counter", "Events arriving, before sampling", seenEvents);
+    promMetric(out, labels, "sampled_events_total", "counter", "Events kept by sampling", sampledEvents);
+    promMetric(out, labels, "received_events_total", "counter", "Events stored", receivedEvents);
+    promMetric(out, labels, "received_bytes_total", "counter", "Event bytes stored", receivedBytes);
+    promMetric(out, labels, "evicted_events_total", "counter", "Events evicted by retention", evictedEvents);
+    promMetric(out, labels, "evicted_bytes_total", "counter", "Bytes evicted by retention", evictedBytes);
+    promMetric(out, labels, "resident_events", "gauge", "Events currently stored", residentEvents);
+    promMetric(out, labels, "resident_bytes", "gauge", "Bytes currently stored", residentBytes);
+    promMetric(out, labels, "capacity_events", "gauge", "Event count limit", capacityEvents);
+    promMetric(out, labels, "capacity_bytes", "gauge", "Byte limit, 0 if unlimited", capacityBytes);
+    promMetric(out, labels, "serial_gaps_total", "counter", "Serial number mismatches", serialGaps);
+    promMetric(out, labels, "staging_stalls_total", "counter", "Ingest waits on decode workers", stagingStalls);
+    promMetric(out, labels, "subscriber_drops_total", "counter", "Events dropped by subscribers", subscriberDrops);
+    promMetric(out, labels, "odb_cache_hits_total", "counter", "getOdb calls served from memory", odbCacheHits);
+    promMetric(out, labels, "odb_cache_misses_total", "counter", "getOdb calls that read the ODB", odbCacheMisses);
+    promMetric(out, labels, "shm_ring_events_total", "counter", "Events written to shared memory", shmRingEvents);
+    promMetric(out, labels, "shm_ring_drops_total", "counter", "Events too large for shared memory", shmRingDrops);
+    promMetric(out, labels, "file_writer_events_total", "counter", "Events written to MIDAS files", fileWriterEvents);
+    promMetric(out, labels, "file_writer_drops_total", "counter", "Events missing from MIDAS files", fileWriterDrops);
+    promLatency(out, bufferName, "callback_time", "Sampled event callback duration", callbackTime);
+    promLatency(out, bufferName, "ingest_to_read", "Delay from buffer delivery to cursor read", ingestToRead);
+    return out.str();
+}
+
+static bool sendToUnixSocket(const std::string& text, const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cm_msg(MERROR, "exportStatsText", "Socket path too long: %s", path.c_str());
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        cm_msg(MERROR, "exportStatsText", "Cannot connect to %s: %s", path.c_str(), std::strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            cm_msg(MERROR, "exportStatsText", "Write to %s failed: %s", path.c_str(), std::strerror(errno));
+            close(fd);
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    close(fd);
+    return true;
+}
+
+// Write next to the target and rename, so readers never see a partial file
+static bool writeFileAtomically(const std::string& text, const std::string& path) {
+    std::string temporary = path + ".tmp";
+    FILE* f = std::fopen(temporary.c_str(), "w");
+    if (f == nullptr) {
+        cm_msg(MERROR, "exportStatsText", "Cannot open %s: %s", temporary.c_str(), std::strerror(errno));
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        cm_msg(MERROR, "exportStatsText", "Cannot write %s: %s", path.c_str(), std::strerror(errno));
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool exportStatsText(const std::string& text, const std::string& target) {
+    static const std::string unixPrefix = "unix:";
+    if (target.compare(0, unixPrefix.size(), unixPrefix) == 0) {
+        return sendToUnixSocket(text, target.substr(unixPrefix.size()));
+    }
+    return writeFileAtomically(text, target);
+}
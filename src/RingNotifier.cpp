@@ -0,0 +1,69 @@
+#include "RingNotifier.h"
+
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+RingNotifier::~RingNotifier() {
+    int fd = eventFd.load();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void RingNotifier::wake() {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Sleepers whose target is still ahead put it back before waiting again
+    wakeTarget.store(kNoTarget, std::memory_order_relaxed);
+    cv.notify_all();
+}
+
+void RingNotifier::wakeAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++interruptGeneration;
+    stopped = true;
+    cv.notify_all();
+}
+
+void RingNotifier::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopped = false;
+}
+
+int RingNotifier::fd() {
+    int existing = eventFd.load(std::memory_order_acquire);
+    if (existing >= 0) {
+        return existing;
+    }
+
+    std::lock_guard<std::mutex> lock(fdMutex);
+    existing = eventFd.load(std::memory_order_relaxed);
+    if (existing < 0) {
+        existing = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (existing >= 0) {
+            eventFd.store(existing, std::memory_order_release);
+            fdArmed.store(true, std::memory_order_release);
+        }
+    }
+    return existing;
+}
+
+void RingNotifier::acknowledgeFd() {
+    int fd = eventFd.load(std::memory_order_acquire);
+    if (fd < 0) {
+        return;
+    }
+    uint64_t count;
+    while (read(fd, &count, sizeof(count)) == sizeof(count)) {
+    }
+    fdArmed.store(true, std::memory_order_release);
+}
+
+void RingNotifier::signalFd() {
+    int fd = eventFd.load(std::memory_order_acquire);
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(fd, &one, sizeof(one));
+        (void)written; // Counter overflow is the only failure; the fd is readable either way
+    }
+}
@@ -0,0 +1,127 @@
+#include "RunSegments.h"
+
+RunSegments::RunSegments(const RunRetentionPolicy& policy) : policy(policy) {
+    if (this->policy.maxRuns == 0) {
+        this->policy.maxRuns = 1;
+    }
+    history.emplace_back(); // Run 0, open at sequence 0
+    byNumber[0] = 0;
+}
+
+void RunSegments::begin(int runNumber, uint64_t sequence, std::chrono::system_clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (isOpen) {
+        sealLocked(sequence, at);
+    }
+
+    RunSummary run;
+    run.runNumber = runNumber;
+    run.startTime = at;
+    run.firstSequence = run.endSequence = sequence;
+    history.push_back(run);
+    byNumber[runNumber] = droppedRuns + history.size() - 1; // A reused run number finds the newest run
+    openEvents.store(0, std::memory_order_relaxed);
+    openBytes.store(0, std::memory_order_relaxed);
+    openFirstNs.store(0, std::memory_order_relaxed);
+    openLastNs.store(0, std::memory_order_relaxed);
+    isOpen = true;
+
+    while (history.size() > policy.maxRuns) {
+        auto it = byNumber.find(history.front().runNumber);
+        if (it != byNumber.end() && it->second == droppedRuns) {
+            byNumber.erase(it);
+        }
+        history.pop_front();
+        ++droppedRuns;
+    }
+}
+
+void RunSegments::end(uint64_t sequence, std::chrono::system_clock::time_point at, bool aborted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isOpen) {
+        return; // A second stop, or a stop without a start we saw
+    }
+    sealLocked(sequence, at);
+    history.back().stopped = !aborted;
+    history.back().aborted = aborted;
+}
+
+// Fold the running totals into the open run and close it
+void RunSegments::sealLocked(uint64_t sequence, std::chrono::system_clock::time_point at) {
+    RunSummary& run = history.back();
+    run = summaryLocked(run);
+    run.endSequence = sequence;
+    run.stopTime = at;
+    run.sealed = true;
+    isOpen = false;
+}
+
+uint64_t RunSegments::takeExpired(std::chrono::system_clock::time_point now) {
+    if (policy.keepRuns == 0 && policy.keepFor.count() == 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t kept = 0;
+    for (const auto& run : history) {
+        kept += run.sealed && !run.released ? 1 : 0;
+    }
+
+    // Oldest first; younger runs were sealed later, so the first run kept ends the scan
+    uint64_t end = 0;
+    for (auto& run : history) {
+        if (!run.sealed) {
+            break;
+        }
+        if (run.released) {
+            continue;
+        }
+        bool overCount = policy.keepRuns > 0 && kept > policy.keepRuns;
+        bool overAge = policy.keepFor.count() > 0 && now - run.stopTime >= policy.keepFor;
+        if (!overCount && !overAge) {
+            break;
+        }
+        run.released = true;
+        --kept;
+        end = run.endSequence;
+    }
+    return end;
+}
+
+RunSummary RunSegments::summaryLocked(const RunSummary& run) const {
+    RunSummary out = run;
+    if (!run.sealed) {
+        uint64_t events = openEvents.load(std::memory_order_acquire);
+        out.events = events;
+        out.endSequence = run.firstSequence + events;
+        out.bytes = openBytes.load(std::memory_order_relaxed);
+        if (events > 0) {
+            out.firstEventTime = std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(openFirstNs.load(std::memory_order_relaxed))));
+            out.lastEventTime = std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(openLastNs.load(std::memory_order_relaxed))));
+        }
+    }
+    return out;
+}
+
+bool RunSegments::find(int runNumber, RunSummary& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = byNumber.find(runNumber);
+    if (it == byNumber.end()) {
+        return false;
+    }
+    out = summaryLocked(history[static_cast<size_t>(it->second - droppedRuns)]);
+    return true;
+}
+
+std::vector<RunSummary> RunSegments::runs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<RunSummary> out;
+    out.reserve(history.size());
+    for (const auto& run : history) {
+        out.push_back(summaryLocked(run));
+    }
+    return out;
+}
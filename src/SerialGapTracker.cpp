@@ -0,0 +1,101 @@
+#include "SerialGapTracker.h"
+
+#include <algorithm>
+
+SerialGapTracker::SerialGapTracker(size_t maxGapsPerRun, size_t maxRuns)
+    : table(65536), maxGapsPerRun(maxGapsPerRun), maxRuns(maxRuns > 0 ? maxRuns : 1) {
+    history[current].loss.runNumber = current;
+    order.push_back(current);
+}
+
+void SerialGapTracker::recordGap(uint16_t eventId, uint32_t expected, uint32_t serial) {
+    std::lock_guard<std::mutex> lock(mutex);
+    RunRecord& run = history[current];
+
+    // Serials wrap at 2^32; anything more than half the range ahead is
+    // really behind us
+    uint32_t ahead = serial - expected;
+    if (ahead >= 0x80000000u) {
+        run.loss.outOfOrder++;
+        pending.outOfOrder++;
+        return;
+    }
+
+    SerialGap gap{eventId, expected, serial - 1};
+    run.loss.gaps++;
+    run.loss.missingEvents += gap.count();
+    if (run.gaps.size() < maxGapsPerRun) {
+        run.gaps.push_back(gap);
+    } else {
+        run.loss.truncated = true;
+    }
+
+    if (pending.gaps == 0) {
+        pending.firstGap = gap;
+    }
+    pending.gaps++;
+    pending.missingEvents += gap.count();
+    total++;
+}
+
+void SerialGapTracker::beginRun(int runNumber) {
+    for (auto& entry : table) {
+        entry.seen = false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    current = runNumber;
+    history[current].loss.runNumber = current;
+    // Run numbers can go down (a new experiment, a reset counter), so the
+    // oldest run is the one begun first, not the lowest. The current run is
+    // always last in the order and is never evicted.
+    order.erase(std::remove(order.begin(), order.end(), current), order.end());
+    order.push_back(current);
+    while (history.size() > maxRuns) {
+        history.erase(order.front());
+        order.pop_front();
+    }
+}
+
+int SerialGapTracker::currentRun() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+std::vector<int> SerialGapTracker::runs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<int> numbers;
+    for (const auto& run : history) {
+        numbers.push_back(run.first);
+    }
+    return numbers;
+}
+
+std::vector<SerialGap> SerialGapTracker::gaps(int runNumber) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = history.find(runNumber);
+    return it != history.end() ? it->second.gaps : std::vector<SerialGap>{};
+}
+
+SerialLoss SerialGapTracker::loss(int runNumber) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = history.find(runNumber);
+    if (it == history.end()) {
+        SerialLoss none;
+        none.runNumber = runNumber;
+        return none;
+    }
+    return it->second.loss;
+}
+
+uint64_t SerialGapTracker::totalGaps() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+}
+
+SerialLossReport SerialGapTracker::takeReport() {
+    std::lock_guard<std::mutex> lock(mutex);
+    SerialLossReport report = pending;
+    pending = SerialLossReport{};
+    return report;
+}
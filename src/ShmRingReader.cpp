@@ -0,0 +1,129 @@
+#include "ShmRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ShmRingReader::~ShmRingReader() {
+    close();
+}
+
+bool ShmRingReader::open(const std::string& name, bool fromOldest) {
+    close();
+    error_.clear();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error_ = "shm_open(" + name + "): " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+        error_ = name + " is not a shared-memory event ring";
+        ::close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        error_ = "mmap(" + name + "): " + strerror(errno);
+        return false;
+    }
+
+    auto* header = static_cast<ShmRingHeader*>(base);
+    const uint64_t dataBytes = header->dataBytes;
+    if (header->magic.load(std::memory_order_acquire) != ShmRingHeader::kMagic ||
+        header->version != ShmRingHeader::kVersion || dataBytes == 0 || (dataBytes & (dataBytes - 1)) != 0 ||
+        header->headerBytes + dataBytes != static_cast<uint64_t>(st.st_size)) {
+        error_ = name + " is not a version " + std::to_string(ShmRingHeader::kVersion) + " event ring";
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    header_ = header;
+    data_ = static_cast<const char*>(base) + header->headerBytes;
+    mappedBytes_ = st.st_size;
+    dataBytes_ = dataBytes;
+    missed_ = 0;
+
+    Status now = status();
+    position_ = fromOldest ? now.tailPos : now.writePos;
+    sequence_ = fromOldest ? now.tailSequence : now.head;
+    return true;
+}
+
+void ShmRingReader::close() {
+    if (header_ != nullptr) {
+        munmap(header_, mappedBytes_);
+        header_ = nullptr;
+        data_ = nullptr;
+        mappedBytes_ = 0;
+    }
+}
+
+bool ShmRingReader::writerClosed() const {
+    return header_ == nullptr || header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+ShmRingReader::Status ShmRingReader::status() const {
+    Status result;
+    if (header_ == nullptr) {
+        return result;
+    }
+    for (;;) {
+        uint64_t before = header_->lock.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        result.head = header_->head.load(std::memory_order_relaxed);
+        result.tailSequence = header_->tailSequence.load(std::memory_order_relaxed);
+        result.writePos = header_->writePos.load(std::memory_order_relaxed);
+        result.tailPos = header_->tailPos.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->lock.load(std::memory_order_relaxed) == before) {
+            return result;
+        }
+    }
+}
+
+// The writer moves tailPos past a record before touching its bytes, with a
+// release fence in between; the acquire fence here pairs with it, so if any
+// byte we read was new, we see the moved tail.
+bool ShmRingReader::intact(uint64_t position) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header_->tailPos.load(std::memory_order_relaxed) <= position;
+}
+
+// Lapped by the writer: skip to the oldest intact record and count the loss
+// there, from its sequence
+void ShmRingReader::resync() {
+    Status now = status();
+    if (now.tailPos > position_) {
+        position_ = now.tailPos;
+    }
+}
+
+bool ShmRingReader::wait(std::chrono::milliseconds timeout) const {
+    if (header_ == nullptr) {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto pause = std::chrono::microseconds(20);
+    for (;;) {
+        if (header_->writePos.load(std::memory_order_acquire) > position_) {
+            return true;
+        }
+        if (writerClosed() || std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(pause);
+        pause = std::min(pause * 2, std::chrono::microseconds(1000));
+    }
+}
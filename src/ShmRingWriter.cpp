@@ -0,0 +1,182 @@
+#include "ShmRingWriter.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "midas.h"
+
+static constexpr size_t kMinDataBytes = 64 * 1024;
+static constexpr size_t kHeaderBytes = 4096; // Keeps the data area page aligned
+
+static uint64_t alignRecord(uint64_t bytes) {
+    return (bytes + 7) & ~uint64_t(7);
+}
+
+static int64_t toNs(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+static_assert(sizeof(ShmRingHeader) <= kHeaderBytes, "ring header outgrew its page");
+
+ShmRingWriter::ShmRingWriter(const std::string& name, size_t requestedBytes) : segmentName(name) {
+    dataBytes = kMinDataBytes;
+    while (dataBytes < requestedBytes) {
+        dataBytes <<= 1;
+    }
+
+    shm_unlink(name.c_str()); // A ring left behind by a writer that died
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        cm_msg(MERROR, "ShmRingWriter::ShmRingWriter", "Cannot create shared memory %s: %s", name.c_str(),
+               strerror(errno));
+        return;
+    }
+    size_t total = kHeaderBytes + dataBytes;
+    if (ftruncate(fd, total) != 0) {
+        cm_msg(MERROR, "ShmRingWriter::ShmRingWriter", "Cannot size shared memory %s to %zu bytes: %s",
+               name.c_str(), total, strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return;
+    }
+    void* base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        cm_msg(MERROR, "ShmRingWriter::ShmRingWriter", "Cannot map shared memory %s: %s", name.c_str(),
+               strerror(errno));
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    header = new (base) ShmRingHeader();
+    header->version = ShmRingHeader::kVersion;
+    header->headerBytes = kHeaderBytes;
+    header->dataBytes = dataBytes;
+    header->createdNs = toNs(std::chrono::system_clock::now());
+    header->lock.store(0, std::memory_order_relaxed);
+    header->head.store(0, std::memory_order_relaxed);
+    header->writePos.store(0, std::memory_order_relaxed);
+    header->tailPos.store(0, std::memory_order_relaxed);
+    header->tailSequence.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->magic.store(ShmRingHeader::kMagic, std::memory_order_release);
+    data = static_cast<char*>(base) + kHeaderBytes;
+    mappedBytes = total;
+}
+
+ShmRingWriter::~ShmRingWriter() {
+    if (header != nullptr) {
+        publish();
+        header->closed.store(1, std::memory_order_release);
+        munmap(header, mappedBytes);
+        shm_unlink(segmentName.c_str());
+    }
+}
+
+// Position after the record (or padding) at position, which must be below nextPos
+uint64_t ShmRingWriter::recordEnd(uint64_t position) const {
+    uint64_t offset = position & (dataBytes - 1);
+    uint64_t toWrap = dataBytes - offset;
+    if (toWrap < sizeof(ShmRecordHeader)) {
+        return position + toWrap;
+    }
+    const auto* record = reinterpret_cast<const ShmRecordHeader*>(data + offset);
+    if (record->size == ShmRecordHeader::kPadding) {
+        return position + toWrap;
+    }
+    return position + alignRecord(sizeof(ShmRecordHeader) + record->size);
+}
+
+// First real record at or after position, stopping at limit
+uint64_t ShmRingWriter::skipPadding(uint64_t position, uint64_t limit) const {
+    while (position < limit) {
+        uint64_t offset = position & (dataBytes - 1);
+        uint64_t toWrap = dataBytes - offset;
+        if (toWrap >= sizeof(ShmRecordHeader) &&
+            reinterpret_cast<const ShmRecordHeader*>(data + offset)->size != ShmRecordHeader::kPadding) {
+            break;
+        }
+        position += toWrap;
+    }
+    return position;
+}
+
+void ShmRingWriter::write(uint64_t sequence, std::chrono::system_clock::time_point timestamp, const void* bytes,
+                          size_t size) {
+    if (header == nullptr) {
+        return;
+    }
+    const uint64_t length = alignRecord(sizeof(ShmRecordHeader) + size);
+    if (length > dataBytes / 2) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Records do not wrap: pad out the end of the data area if needed
+    uint64_t start = nextPos;
+    const uint64_t toWrap = dataBytes - (start & (dataBytes - 1));
+    if (toWrap < length) {
+        start += toWrap;
+    }
+    const uint64_t end = start + length;
+
+    // Retire every record the new bytes land on before writing them
+    uint64_t tail = header->tailPos.load(std::memory_order_relaxed);
+    if (end > dataBytes && tail < end - dataBytes) {
+        while (tail < end - dataBytes && tail < nextPos) {
+            tail = recordEnd(tail);
+        }
+        tail = skipPadding(tail, nextPos);
+        if (tail < end - dataBytes) {
+            tail = start;
+        }
+        uint64_t tailSequence = tail < nextPos
+            ? reinterpret_cast<const ShmRecordHeader*>(data + (tail & (dataBytes - 1)))->sequence
+            : sequence;
+
+        uint64_t lock = header->lock.load(std::memory_order_relaxed);
+        header->lock.store(lock + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->tailPos.store(tail, std::memory_order_relaxed);
+        header->tailSequence.store(tailSequence, std::memory_order_relaxed);
+        header->lock.store(lock + 2, std::memory_order_release);
+        // Pairs with the reader's acquire fence in intact(): a reader that
+        // sees any byte written below also sees the tail moved past it
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    if (start != nextPos && toWrap >= sizeof(ShmRecordHeader)) {
+        auto* padding = reinterpret_cast<ShmRecordHeader*>(data + (nextPos & (dataBytes - 1)));
+        padding->size = ShmRecordHeader::kPadding;
+    }
+    auto* record = reinterpret_cast<ShmRecordHeader*>(data + (start & (dataBytes - 1)));
+    record->size = static_cast<uint32_t>(size);
+    record->reserved = 0;
+    record->sequence = sequence;
+    record->timestampNs = toNs(timestamp);
+    memcpy(record + 1, bytes, size);
+
+    nextPos = end;
+    nextSequence = sequence + 1;
+    unpublished = true;
+    writtenCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ShmRingWriter::publish() {
+    if (header == nullptr || !unpublished) {
+        return;
+    }
+    uint64_t lock = header->lock.load(std::memory_order_relaxed);
+    header->lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->head.store(nextSequence, std::memory_order_relaxed);
+    header->writePos.store(nextPos, std::memory_order_release);
+    header->lock.store(lock + 2, std::memory_order_release);
+    unpublished = false;
+}
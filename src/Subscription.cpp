@@ -0,0 +1,106 @@
+#include "Subscription.h"
+
+#include <cstring>
+
+Subscription::Subscription(const SubscriptionFilter& filter, BackpressurePolicy policy, size_t capacity)
+    : triggerMask(filter.triggerMask),
+      policy_(policy),
+      queue(capacity > 0 ? capacity : 1) {
+    if (!filter.eventIds.empty()) {
+        eventIdBits.assign(65536 / 64, 0);
+        for (uint16_t id : filter.eventIds) {
+            eventIdBits[id / 64] |= uint64_t(1) << (id % 64);
+        }
+    }
+    for (const auto& name : filter.bankNames) {
+        uint32_t packed = 0;
+        std::memcpy(&packed, name.data(), name.size() < 4 ? name.size() : 4);
+        banks.push_back(packed);
+    }
+}
+
+bool Subscription::matches(const EventView& event) const {
+    if (!eventIdBits.empty()) {
+        uint16_t id = event.eventId();
+        if ((eventIdBits[id / 64] & (uint64_t(1) << (id % 64))) == 0) {
+            return false;
+        }
+    }
+    if (triggerMask != 0xFFFF && (event.triggerMask() & triggerMask) == 0) {
+        return false;
+    }
+    if (banks.empty()) {
+        return true;
+    }
+    // banks() is built once per event and shared by every subscriber
+    for (const auto& bank : event.banks()) {
+        for (uint32_t name : banks) {
+            if (bank.name == name) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Subscription::pushLocked(const std::shared_ptr<TimedEvent>& event) {
+    queue[(queueHead + queueSize) % queue.size()] = event;
+    ++queueSize;
+}
+
+std::vector<std::shared_ptr<TimedEvent>> Subscription::poll(size_t maxCount) {
+    std::vector<std::shared_ptr<TimedEvent>> events;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = queueSize < maxCount ? queueSize : maxCount;
+        events.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            events.push_back(std::move(queue[queueHead]));
+            queueHead = (queueHead + 1) % queue.size();
+        }
+        queueSize -= n;
+    }
+    delivered.fetch_add(events.size(), std::memory_order_relaxed);
+    if (!events.empty() && policy_ == BackpressurePolicy::Block) {
+        spaceCV.notify_one();
+    }
+    return events;
+}
+
+std::vector<std::shared_ptr<TimedEvent>> Subscription::wait(size_t minCount, std::chrono::milliseconds timeout,
+                                                            size_t maxCount) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t needed = minCount > 0 ? minCount : 1;
+        if (needed > queue.size()) {
+            needed = queue.size(); // Never wait for more than the queue can hold
+        }
+        dataCV.wait_for(lock, timeout, [&] { return queueSize >= needed || isClosed(); });
+    }
+    return poll(maxCount);
+}
+
+SubscriptionStats Subscription::stats() const {
+    SubscriptionStats s;
+    s.matched = matched.load(std::memory_order_relaxed);
+    s.delivered = delivered.load(std::memory_order_relaxed);
+    s.droppedOldest = droppedOldest.load(std::memory_order_relaxed);
+    s.droppedNewest = droppedNewest.load(std::memory_order_relaxed);
+    s.blockedNs = blockedNs.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    s.queued = queueSize;
+    return s;
+}
+
+void Subscription::close() {
+    closed.store(true, std::memory_order_release);
+    interrupt();
+}
+
+void Subscription::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    spaceCV.notify_all();
+    dataCV.notify_all();
+}